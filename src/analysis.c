@@ -0,0 +1,755 @@
+/* -*- c-basic-offset: 8 -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Decoding of the registers an encoded instruction reads and writes, for
+ * the passes in optimize.c and the program reports.
+ *
+ * Registers are tracked as byte ranges within a register file.  ARF
+ * registers use their encoded number, so acc0 is bytes 0x400 to 0x420 of
+ * the ARF.  Regions are widened to the smallest range holding every
+ * element, which is exact for the common contiguous and scalar ones.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gen4asm.h"
+
+#define REG_SIZE	32
+
+static const int hstride_table[4] = { 0, 1, 2, 4 };
+
+int instruction_exec_size(struct brw_instruction *inst)
+{
+	return 1 << inst->header.execution_size;
+}
+
+int instruction_is_three_src(struct brw_instruction *inst)
+{
+	const struct opcode_desc *desc = opcode_desc(inst->header.opcode);
+
+	return desc && desc->format == OPCODE_THREE_SRC;
+}
+
+/* Whether the instruction may transfer control somewhere other than the
+ * next instruction, or join control flow from elsewhere.
+ */
+int instruction_is_control_flow(struct brw_instruction *inst)
+{
+	const struct opcode_desc *desc = opcode_desc(inst->header.opcode);
+
+	return desc && (desc->flags & OPCODE_FLOW);
+}
+
+int instruction_ends_thread(struct brw_instruction *inst)
+{
+	if (inst->header.opcode != BRW_OPCODE_SEND &&
+	    inst->header.opcode != BRW_OPCODE_SENDC)
+		return 0;
+	if (IS_GENp(5))
+		return inst->bits3.generic_gen5.end_of_thread;
+	return inst->bits3.generic.end_of_thread;
+}
+
+/* The shared function a send is addressed to, BRW_MESSAGE_TARGET_*. */
+int send_target(struct brw_instruction *inst)
+{
+	if (IS_GENp(6))
+		return inst->header.sfid_destreg__conditionalmod;
+	if (IS_GENx(5))
+		return inst->bits2.send_gen5.sfid;
+	return inst->bits3.generic.msg_target;
+}
+
+/* Branch distances are counted in 16-byte units on Gen4 and in 8-byte
+ * units from Gen5 on.
+ */
+static int branch_units(int distance)
+{
+	return IS_GENp(5) ? distance / 2 : distance;
+}
+
+/**
+ * Reads the jump distances of a branch, in instructions, mirroring how
+ * main.c encodes them.  A distance the instruction doesn't carry reads
+ * as 0.  JMPI's is relative to the incremented IP, the others' to the
+ * branch itself.
+ */
+void instruction_branch_offsets(struct brw_instruction *inst, int *jip,
+				int *uip)
+{
+	int opcode = inst->header.opcode;
+
+	*jip = *uip = 0;
+	if (opcode == BRW_OPCODE_JMPI) {
+		*jip = inst->bits3.JIP;
+		if (gen_level == 75)
+			*jip /= 8;
+	} else if (!IS_GENp(6)) {
+		/* The high word is the pop count of ELSE, BREAK and
+		 * CONTINUE.
+		 */
+		*jip = (int16_t)(inst->bits3.ud & 0xffff);
+	} else if (opcode == BRW_OPCODE_BREAK ||
+		   opcode == BRW_OPCODE_CONTINUE ||
+		   opcode == BRW_OPCODE_HALT || IS_GENp(7)) {
+		*jip = inst->bits3.branch_2_offset.JIP;
+		if (opcode != BRW_OPCODE_CALL)
+			*uip = inst->bits3.branch_2_offset.UIP;
+	} else if (opcode == BRW_OPCODE_CALL) {
+		*jip = inst->bits3.JIP;
+	} else {
+		*jip = inst->bits1.branch.JIP;
+	}
+	*jip = branch_units(*jip);
+	*uip = branch_units(*uip);
+}
+
+/**
+ * Zeroes the jump distances instruction_branch_offsets() reads, so that
+ * the same branch compares equal wherever it is in a program.
+ */
+void instruction_clear_branch_offsets(struct brw_instruction *inst)
+{
+	int opcode = inst->header.opcode;
+
+	if (opcode == BRW_OPCODE_JMPI) {
+		inst->bits3.JIP = 0;
+	} else if (!IS_GENp(6)) {
+		inst->bits3.ud &= 0xffff0000;
+	} else if (opcode == BRW_OPCODE_BREAK ||
+		   opcode == BRW_OPCODE_CONTINUE ||
+		   opcode == BRW_OPCODE_HALT || IS_GENp(7)) {
+		inst->bits3.branch_2_offset.JIP = 0;
+		if (opcode != BRW_OPCODE_CALL)
+			inst->bits3.branch_2_offset.UIP = 0;
+	} else if (opcode == BRW_OPCODE_CALL) {
+		inst->bits3.JIP = 0;
+	} else {
+		inst->bits1.branch.JIP = 0;
+	}
+}
+
+static int add_target(int *targets, int n, int ip, int distance)
+{
+	if (distance)
+		targets[n++] = ip + distance;
+	return n;
+}
+
+/**
+ * Decodes the JIP and UIP of a branch at instruction index ip into the
+ * instruction indices it may jump to.  Falling through to ip + 1 is not
+ * included.
+ *
+ * Returns the number of targets stored, or -1 if they can't be known
+ * statically, as for a JMPI through a register.
+ */
+int instruction_branch_targets(struct brw_instruction *inst, int ip,
+			       int *targets)
+{
+	int opcode = inst->header.opcode;
+	int jip, uip;
+
+	if (opcode == BRW_OPCODE_JMPI) {
+		if (inst->bits1.da1.src1_reg_file != BRW_IMMEDIATE_VALUE)
+			return -1;
+		instruction_branch_offsets(inst, &jip, &uip);
+		targets[0] = ip + 1 + jip;
+		return 1;
+	}
+
+	switch (opcode) {
+	case BRW_OPCODE_IF:
+	case BRW_OPCODE_IFF:
+	case BRW_OPCODE_ELSE:
+	case BRW_OPCODE_ENDIF:
+	case BRW_OPCODE_WHILE:
+	case BRW_OPCODE_CALL:
+	case BRW_OPCODE_BREAK:
+	case BRW_OPCODE_CONTINUE:
+	case BRW_OPCODE_HALT:
+		break;
+	default:
+		return 0;
+	}
+
+	/* Gen4/5 have no CALL, and a pre-Gen6 ENDIF doesn't jump. */
+	if (!IS_GENp(6) &&
+	    (opcode == BRW_OPCODE_ENDIF || opcode == BRW_OPCODE_CALL))
+		return 0;
+
+	instruction_branch_offsets(inst, &jip, &uip);
+	return add_target(targets, add_target(targets, 0, ip, jip), ip, uip);
+}
+
+static int add_successor(int *succ, int *kinds, int ns, int target,
+			 int kind)
+{
+	int j;
+
+	/* A branch to the next instruction is still one edge. */
+	for (j = 0; j < ns; j++)
+		if (succ[j] == target)
+			return ns;
+	if (kinds)
+		kinds[ns] = kind;
+	succ[ns++] = target;
+	return ns;
+}
+
+/**
+ * Finds the instructions control may reach after instruction i of the n
+ * in insts, storing them in succ and, if kinds isn't NULL, whether each is
+ * reached by falling through, by a branch or by a ret in kinds.  succ and
+ * kinds need room for n + 1 entries.
+ *
+ * Falling through is assumed possible unless the thread ends or an
+ * unpredicated jmpi always jumps, as SIMD branches are only taken when no
+ * channel goes the other way.  A ret may return after any call.  A
+ * successor reached both by branching and falling through is listed
+ * once, as a branch.
+ *
+ * Returns the number of successors.
+ */
+int instruction_successors(struct brw_instruction **insts, int n, int i,
+			   int *succ, int *kinds)
+{
+	struct brw_instruction *inst = insts[i];
+	int targets[INST_MAX_TARGETS];
+	int count, j, ns = 0;
+
+	if (instruction_ends_thread(inst))
+		return 0;
+
+	if (inst->header.opcode == BRW_OPCODE_RET) {
+		for (j = 0; j + 1 < n; j++) {
+			if (insts[j]->header.opcode != BRW_OPCODE_CALL)
+				continue;
+			if (kinds)
+				kinds[ns] = CFG_EDGE_RETURN;
+			succ[ns++] = j + 1;
+		}
+		return ns;
+	}
+
+	count = instruction_branch_targets(inst, i, targets);
+	for (j = 0; j < count; j++) {
+		if (targets[j] < 0 || targets[j] >= n)
+			continue;
+		ns = add_successor(succ, kinds, ns, targets[j],
+				   CFG_EDGE_BRANCH);
+	}
+
+	if (inst->header.opcode == BRW_OPCODE_JMPI &&
+	    inst->header.predicate_control == BRW_PREDICATE_NONE && count > 0)
+		return ns;
+
+	if (i + 1 < n)
+		ns = add_successor(succ, kinds, ns, i + 1,
+				   CFG_EDGE_FALLTHROUGH);
+	return ns;
+}
+
+/**
+ * Splits a program of n instructions into basic blocks.  A block starts
+ * at the first instruction, at every branch target and after every
+ * control flow instruction or EOT send.
+ *
+ * Returns the number of blocks, stored in a newly allocated array.
+ */
+int program_basic_blocks(struct brw_instruction **insts, int n,
+			 struct basic_block **blocks)
+{
+	char *leader = calloc(n + 1, 1);
+	int targets[INST_MAX_TARGETS];
+	int i, j, count, nblocks = 0;
+
+	leader[0] = 1;
+	for (i = 0; i < n; i++) {
+		if (instruction_is_control_flow(insts[i]) ||
+		    instruction_ends_thread(insts[i]))
+			leader[i + 1] = 1;
+		count = instruction_branch_targets(insts[i], i, targets);
+		for (j = 0; j < count; j++)
+			if (targets[j] >= 0 && targets[j] < n)
+				leader[targets[j]] = 1;
+	}
+
+	for (i = 0; i < n; i++)
+		nblocks += leader[i];
+	*blocks = calloc(nblocks + 1, sizeof(**blocks));
+
+	for (i = 0, j = -1; i < n; i++) {
+		if (leader[i]) {
+			j++;
+			(*blocks)[j].start = i;
+		}
+		(*blocks)[j].end = i + 1;
+	}
+
+	free(leader);
+	return n ? nblocks : 0;
+}
+
+/**
+ * Builds the control flow graph of a program of n instructions: its basic
+ * blocks, the edges between them and how deeply each block is nested in
+ * loops, a loop being the blocks spanned by a backward edge.
+ */
+void program_cfg(struct brw_instruction **insts, int n, struct cfg *cfg)
+{
+	int *block_of = calloc(n + 1, sizeof(*block_of));
+	int *succ = calloc(n + 2, sizeof(*succ));
+	int *kinds = calloc(n + 2, sizeof(*kinds));
+	int b, i, j, ns, size = 0;
+
+	cfg->nblocks = program_basic_blocks(insts, n, &cfg->blocks);
+	cfg->nedges = 0;
+	cfg->edges = NULL;
+
+	for (b = 0; b < cfg->nblocks; b++)
+		for (i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++)
+			block_of[i] = b;
+
+	for (b = 0; b < cfg->nblocks; b++) {
+		ns = instruction_successors(insts, n, cfg->blocks[b].end - 1,
+					    succ, kinds);
+		for (j = 0; j < ns; j++) {
+			if (cfg->nedges == size) {
+				size = size ? size * 2 : 16;
+				cfg->edges = realloc(cfg->edges,
+						     size * sizeof(*cfg->edges));
+			}
+			cfg->edges[cfg->nedges].from = b;
+			cfg->edges[cfg->nedges].to = block_of[succ[j]];
+			cfg->edges[cfg->nedges].kind = kinds[j];
+			cfg->nedges++;
+		}
+	}
+
+	for (j = 0; j < cfg->nedges; j++) {
+		struct cfg_edge *e = &cfg->edges[j];
+
+		if (e->kind != CFG_EDGE_RETURN && e->to <= e->from)
+			for (b = e->to; b <= e->from; b++)
+				cfg->blocks[b].loop_depth++;
+	}
+
+	free(kinds);
+	free(succ);
+	free(block_of);
+}
+
+void free_cfg(struct cfg *cfg)
+{
+	free(cfg->edges);
+	free(cfg->blocks);
+}
+
+int reg_type_size(int reg_type)
+{
+	switch (reg_type) {
+	case BRW_REGISTER_TYPE_UD:
+	case BRW_REGISTER_TYPE_D:
+	case BRW_REGISTER_TYPE_F:
+		return 4;
+	case BRW_REGISTER_TYPE_UW:
+	case BRW_REGISTER_TYPE_W:
+	case BRW_REGISTER_TYPE_HF:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+/* Gen7 reads the GRF from two banks, even and odd registers, each split
+ * in two halves of 64 registers.
+ */
+int grf_bank(int reg_nr)
+{
+	return (reg_nr & 1) | ((reg_nr & 0x40) >> 5);
+}
+
+/**
+ * Whether a Gen7 three-source instruction reads src1 and src2 from
+ * different registers of the same bank, which costs an extra cycle to
+ * read its operands.
+ */
+int three_src_bank_conflict(struct brw_instruction *inst)
+{
+	int src1, src2;
+
+	if (!IS_GENp(7) || !instruction_is_three_src(inst))
+		return 0;
+
+	src1 = inst->bits3.three_src_gen6.src1_reg_nr;
+	src2 = inst->bits3.three_src_gen6.src2_reg_nr;
+	return src1 != src2 && grf_bank(src1) == grf_bank(src2);
+}
+
+int reg_ranges_overlap(struct reg_range *a, struct reg_range *b)
+{
+	return a->file == b->file && a->start < b->end && b->start < a->end;
+}
+
+int reg_range_covers(struct reg_range *a, struct reg_range *b)
+{
+	return a->file == b->file && a->start <= b->start && b->end <= a->end;
+}
+
+static void add_range(struct reg_range *r, int *n, int file, int start,
+		      int size)
+{
+	/* The null register is neither read nor written. */
+	if (file == BRW_ARCHITECTURE_REGISTER_FILE &&
+	    start / REG_SIZE == BRW_ARF_NULL)
+		return;
+
+	r[*n].file = file;
+	r[*n].start = start;
+	r[*n].end = start + size;
+	(*n)++;
+}
+
+static void add_def(struct inst_regs *regs, int file, int start, int size)
+{
+	add_range(regs->defs, &regs->ndefs, file, start, size);
+}
+
+static void add_use(struct inst_regs *regs, int file, int start, int size)
+{
+	add_range(regs->uses, &regs->nuses, file, start, size);
+}
+
+/* Bytes spanned by an align1 region starting at its first element. */
+static int region_size(int exec_size, int vert_stride, int width,
+		       int horiz_stride, int type_size)
+{
+	int vs = vert_stride ? 1 << (vert_stride - 1) : 0;
+	int w = 1 << width;
+	int hs = hstride_table[horiz_stride];
+	int rows;
+
+	if (w > exec_size)
+		w = exec_size;
+	rows = exec_size / w;
+	return ((rows - 1) * vs + (w - 1) * hs + 1) * type_size;
+}
+
+/* Align16 operands are treated as touching every component of each
+ * vec4 the execution size spans.
+ */
+static int align16_size(int exec_size, int type_size, int scalar)
+{
+	int size = scalar ? 16 : exec_size * type_size;
+
+	return size < 16 ? 16 : size;
+}
+
+static void flag_range(struct brw_instruction *inst, int *start)
+{
+	int nr, subnr;
+
+	if (instruction_is_three_src(inst)) {
+		nr = inst->bits1.three_src_gen6.flag_reg_nr;
+		subnr = inst->bits1.three_src_gen6.flag_subreg_nr;
+	} else {
+		nr = inst->bits2.da1.flag_reg_nr;
+		subnr = inst->bits2.da1.flag_subreg_nr;
+	}
+	*start = (BRW_ARF_FLAG + nr) * REG_SIZE + subnr * 2;
+}
+
+static void three_src_regs(struct brw_instruction *inst,
+			   struct inst_regs *regs, int exec_size)
+{
+	int file = BRW_GENERAL_REGISTER_FILE;
+	int src1_subreg;
+
+	if (IS_GENx(6) && inst->bits1.three_src_gen6.dest_reg_file)
+		file = BRW_MESSAGE_REGISTER_FILE;
+	add_def(regs, file,
+		inst->bits1.three_src_gen6.dest_reg_nr * REG_SIZE +
+		inst->bits1.three_src_gen6.dest_subreg_nr * 4,
+		align16_size(exec_size, 4, 0));
+
+	add_use(regs, BRW_GENERAL_REGISTER_FILE,
+		inst->bits2.three_src_gen6.src0_reg_nr * REG_SIZE +
+		inst->bits2.three_src_gen6.src0_subreg_nr * 4,
+		align16_size(exec_size, 4,
+			     inst->bits2.three_src_gen6.src0_rep_ctrl));
+
+	src1_subreg = inst->bits2.three_src_gen6.src1_subreg_nr_low |
+		(inst->bits3.three_src_gen6.src1_subreg_nr_high << 2);
+	add_use(regs, BRW_GENERAL_REGISTER_FILE,
+		inst->bits3.three_src_gen6.src1_reg_nr * REG_SIZE +
+		src1_subreg * 4,
+		align16_size(exec_size, 4,
+			     inst->bits2.three_src_gen6.src1_rep_ctrl));
+
+	add_use(regs, BRW_GENERAL_REGISTER_FILE,
+		inst->bits3.three_src_gen6.src2_reg_nr * REG_SIZE +
+		inst->bits3.three_src_gen6.src2_subreg_nr * 4,
+		align16_size(exec_size, 4,
+			     inst->bits3.three_src_gen6.src2_rep_ctrl));
+}
+
+static void dest_regs(struct brw_instruction *inst, struct inst_regs *regs,
+		      int exec_size)
+{
+	int type_size = reg_type_size(inst->bits1.da1.dest_reg_type);
+	int file = inst->bits1.da1.dest_reg_file;
+
+	if (inst->bits1.da1.dest_address_mode != BRW_ADDRESS_DIRECT) {
+		regs->indirect = 1;
+		return;
+	}
+
+	if (inst->header.access_mode == BRW_ALIGN_1) {
+		int hs = hstride_table[inst->bits1.da1.dest_horiz_stride];
+
+		if (hs == 0)
+			hs = 1;
+		add_def(regs, file,
+			inst->bits1.da1.dest_reg_nr * REG_SIZE +
+			inst->bits1.da1.dest_subreg_nr,
+			((exec_size - 1) * hs + 1) * type_size);
+	} else {
+		add_def(regs, file,
+			inst->bits1.da16.dest_reg_nr * REG_SIZE +
+			inst->bits1.da16.dest_subreg_nr * 16,
+			align16_size(exec_size, type_size, 0));
+	}
+}
+
+static void src0_regs(struct brw_instruction *inst, struct inst_regs *regs,
+		      int exec_size)
+{
+	int type_size = reg_type_size(inst->bits1.da1.src0_reg_type);
+	int file = inst->bits1.da1.src0_reg_file;
+
+	if (file == BRW_IMMEDIATE_VALUE)
+		return;
+	if (inst->bits2.da1.src0_address_mode != BRW_ADDRESS_DIRECT) {
+		regs->indirect = 1;
+		return;
+	}
+
+	if (inst->header.access_mode == BRW_ALIGN_1) {
+		add_use(regs, file,
+			inst->bits2.da1.src0_reg_nr * REG_SIZE +
+			inst->bits2.da1.src0_subreg_nr,
+			region_size(exec_size, inst->bits2.da1.src0_vert_stride,
+				    inst->bits2.da1.src0_width,
+				    inst->bits2.da1.src0_horiz_stride,
+				    type_size));
+	} else {
+		add_use(regs, file,
+			inst->bits2.da16.src0_reg_nr * REG_SIZE +
+			inst->bits2.da16.src0_subreg_nr * 16,
+			align16_size(exec_size, type_size,
+				     inst->bits2.da16.src0_vert_stride == 0));
+	}
+}
+
+static void src1_regs(struct brw_instruction *inst, struct inst_regs *regs,
+		      int exec_size)
+{
+	int type_size = reg_type_size(inst->bits1.da1.src1_reg_type);
+	int file = inst->bits1.da1.src1_reg_file;
+
+	if (file == BRW_IMMEDIATE_VALUE ||
+	    inst->bits1.da1.src0_reg_file == BRW_IMMEDIATE_VALUE)
+		return;
+	if (inst->bits3.da1.src1_address_mode != BRW_ADDRESS_DIRECT) {
+		regs->indirect = 1;
+		return;
+	}
+
+	if (inst->header.access_mode == BRW_ALIGN_1) {
+		add_use(regs, file,
+			inst->bits3.da1.src1_reg_nr * REG_SIZE +
+			inst->bits3.da1.src1_subreg_nr,
+			region_size(exec_size, inst->bits3.da1.src1_vert_stride,
+				    inst->bits3.da1.src1_width,
+				    inst->bits3.da1.src1_horiz_stride,
+				    type_size));
+	} else {
+		add_use(regs, file,
+			inst->bits3.da16.src1_reg_nr * REG_SIZE +
+			inst->bits3.da16.src1_subreg_nr * 16,
+			align16_size(exec_size, type_size,
+				     inst->bits3.da16.src1_vert_stride == 0));
+	}
+}
+
+static void send_regs(struct brw_instruction *inst, struct inst_regs *regs)
+{
+	int mlen, rlen;
+
+	if (IS_GENp(5)) {
+		mlen = inst->bits3.generic_gen5.msg_length;
+		rlen = inst->bits3.generic_gen5.response_length;
+	} else {
+		mlen = inst->bits3.generic.msg_length;
+		rlen = inst->bits3.generic.response_length;
+	}
+
+	if (rlen && inst->bits1.da1.dest_address_mode == BRW_ADDRESS_DIRECT)
+		add_def(regs, inst->bits1.da1.dest_reg_file,
+			inst->bits1.da1.dest_reg_nr * REG_SIZE,
+			rlen * REG_SIZE);
+
+	if (IS_GENp(6)) {
+		/* The message starts at src0, an MRF on Gen6 and a GRF
+		 * after that.
+		 */
+		if (mlen)
+			add_use(regs, inst->bits1.da1.src0_reg_file,
+				inst->bits2.da1.src0_reg_nr * REG_SIZE,
+				mlen * REG_SIZE);
+	} else {
+		int mrf = inst->header.sfid_destreg__conditionalmod;
+
+		/* A non-null src0 is copied to the first message register
+		 * on the way out.
+		 */
+		if (inst->bits1.da1.src0_reg_file != BRW_ARCHITECTURE_REGISTER_FILE ||
+		    inst->bits2.da1.src0_reg_nr != BRW_ARF_NULL) {
+			add_use(regs, inst->bits1.da1.src0_reg_file,
+				inst->bits2.da1.src0_reg_nr * REG_SIZE,
+				REG_SIZE);
+			add_def(regs, BRW_MESSAGE_REGISTER_FILE,
+				mrf * REG_SIZE, REG_SIZE);
+		}
+		if (mlen)
+			add_use(regs, BRW_MESSAGE_REGISTER_FILE,
+				mrf * REG_SIZE, mlen * REG_SIZE);
+	}
+}
+
+/**
+ * Fills in the register ranges inst reads and writes, implicit accesses
+ * to the flag and accumulator included.
+ */
+void instruction_regs(struct brw_instruction *inst, struct inst_regs *regs)
+{
+	int exec_size = instruction_exec_size(inst);
+	int opcode = inst->header.opcode;
+	int flag;
+
+	memset(regs, 0, sizeof(*regs));
+
+	if (inst->header.predicate_control != BRW_PREDICATE_NONE) {
+		flag_range(inst, &flag);
+		add_use(regs, BRW_ARCHITECTURE_REGISTER_FILE, flag, 2);
+	}
+
+	if (opcode == BRW_OPCODE_SEND || opcode == BRW_OPCODE_SENDC) {
+		send_regs(inst, regs);
+		return;
+	}
+
+	if (inst->header.sfid_destreg__conditionalmod != BRW_CONDITIONAL_NONE &&
+	    !(opcode == BRW_OPCODE_MATH && IS_GENp(6))) {
+		flag_range(inst, &flag);
+		add_def(regs, BRW_ARCHITECTURE_REGISTER_FILE, flag, 2);
+	}
+
+	switch (opcode) {
+	case BRW_OPCODE_MAC:
+	case BRW_OPCODE_MACH:
+	case BRW_OPCODE_SADA2:
+		add_use(regs, BRW_ARCHITECTURE_REGISTER_FILE,
+			BRW_ARF_ACCUMULATOR * REG_SIZE, 2 * REG_SIZE);
+		break;
+	}
+	switch (opcode) {
+	case BRW_OPCODE_MACH:
+	case BRW_OPCODE_ADDC:
+	case BRW_OPCODE_SUBB:
+		add_def(regs, BRW_ARCHITECTURE_REGISTER_FILE,
+			BRW_ARF_ACCUMULATOR * REG_SIZE, 2 * REG_SIZE);
+		break;
+	default:
+		if (inst->header.acc_wr_control)
+			add_def(regs, BRW_ARCHITECTURE_REGISTER_FILE,
+				BRW_ARF_ACCUMULATOR * REG_SIZE, 2 * REG_SIZE);
+		break;
+	}
+
+	if (instruction_is_three_src(inst)) {
+		three_src_regs(inst, regs, exec_size);
+		return;
+	}
+
+	dest_regs(inst, regs, exec_size);
+	src0_regs(inst, regs, exec_size);
+	src1_regs(inst, regs, exec_size);
+}
+
+/**
+ * Collects the instructions of a program, skipping labels, into a newly
+ * allocated array.  Returns their number.
+ */
+int program_instructions(struct brw_program *p, struct brw_instruction ***insts)
+{
+	struct brw_program_instruction *entry;
+	int n = 0;
+
+	for (entry = p->first; entry; entry = entry->next)
+		if (!entry->islabel)
+			n++;
+	*insts = calloc(n + 1, sizeof(**insts));
+	n = 0;
+	for (entry = p->first; entry; entry = entry->next)
+		if (!entry->islabel)
+			(*insts)[n++] = &entry->instruction;
+	return n;
+}
+
+/* Opens a report file given on the command line, "-" being stdout. */
+FILE *open_report(const char *filename)
+{
+	FILE *f;
+
+	if (strcmp(filename, "-") == 0)
+		return stdout;
+	f = fopen(filename, "w");
+	if (f == NULL) {
+		perror("Couldn't open report file");
+		exit(1);
+	}
+	return f;
+}
+
+void close_report(FILE *f)
+{
+	if (f != stdout)
+		fclose(f);
+}
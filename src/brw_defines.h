@@ -508,6 +508,13 @@
 #define BRW_CHANNEL_Z     2
 #define BRW_CHANNEL_W     3
 
+#define BRW_SWIZZLE_NOOP  (BRW_CHANNEL_X | BRW_CHANNEL_Y << 2 | \
+			   BRW_CHANNEL_Z << 4 | BRW_CHANNEL_W << 6)
+#define BRW_WRITEMASK_XYZW 0xf
+
+#define BRW_3SRC_MODIFIER_ABS     1
+#define BRW_3SRC_MODIFIER_NEGATE  2
+
 #define BRW_COMPRESSION_NONE          0
 #define BRW_COMPRESSION_2NDHALF       1
 #define BRW_COMPRESSION_COMPRESSED    2
@@ -654,6 +661,7 @@
 #define BRW_REGISTER_TYPE_UW  2
 #define BRW_REGISTER_TYPE_W   3
 #define BRW_REGISTER_TYPE_UB  4
+#define BRW_REGISTER_TYPE_UV  4	/* packed unsigned int vector, immediates only, gen6+ */
 #define BRW_REGISTER_TYPE_B   5
 #define BRW_REGISTER_TYPE_VF  5	/* packed float vector, immediates only? */
 #define BRW_REGISTER_TYPE_HF  6
@@ -730,6 +738,7 @@
 #define BRW_MESSAGE_TARGET_VME                8
 #define BRW_MESSAGE_TARGET_DP_CC              9  /* data port constant cache */
 #define BRW_MESSAGE_TARGET_DP_DC              10 /* data port data cache */
+#define BRW_MESSAGE_TARGET_DP_DC1             12 /* data port data cache 1, gen7.5 */
 #define BRW_MESSAGE_TARGET_CRE                0x0d /* check & refinement enginee */ 
 
 #define BRW_SAMPLER_RETURN_FORMAT_FLOAT32     0
@@ -753,6 +762,11 @@
 #define BRW_SAMPLER_MESSAGE_SIMD8_LD                  3
 #define BRW_SAMPLER_MESSAGE_SIMD16_LD                 3
 
+#define BRW_SAMPLER_SIMD_MODE_SIMD4X2                 0
+#define BRW_SAMPLER_SIMD_MODE_SIMD8                   1
+#define BRW_SAMPLER_SIMD_MODE_SIMD16                  2
+#define BRW_SAMPLER_SIMD_MODE_SIMD32_64               3
+
 #define BRW_DATAPORT_OWORD_BLOCK_1_OWORDLOW   0
 #define BRW_DATAPORT_OWORD_BLOCK_1_OWORDHIGH  1
 #define BRW_DATAPORT_OWORD_BLOCK_2_OWORDS     2
@@ -788,6 +802,67 @@
 #define BRW_DATAPORT_WRITE_MESSAGE_STREAMED_VERTEX_BUFFER_WRITE     5
 #define BRW_DATAPORT_WRITE_MESSAGE_FLUSH_RENDER_CACHE               7
 
+/* Gen6 reads go to the sampler or constant cache, writes to the render cache */
+#define GEN6_DATAPORT_READ_MESSAGE_OWORD_BLOCK_READ                 0
+#define GEN6_DATAPORT_READ_MESSAGE_OWORD_DUAL_BLOCK_READ            1
+#define GEN6_DATAPORT_READ_MESSAGE_MEDIA_BLOCK_READ                 2
+#define GEN6_DATAPORT_READ_MESSAGE_OWORD_UNALIGN_BLOCK_READ         3
+#define GEN6_DATAPORT_READ_MESSAGE_DWORD_SCATTERED_READ             4
+
+#define GEN6_DATAPORT_WRITE_MESSAGE_DWORD_ATOMIC_WRITE              7
+#define GEN6_DATAPORT_WRITE_MESSAGE_OWORD_BLOCK_WRITE               8
+#define GEN6_DATAPORT_WRITE_MESSAGE_OWORD_DUAL_BLOCK_WRITE          9
+#define GEN6_DATAPORT_WRITE_MESSAGE_MEDIA_BLOCK_WRITE               10
+#define GEN6_DATAPORT_WRITE_MESSAGE_DWORD_SCATTERED_WRITE           11
+#define GEN6_DATAPORT_WRITE_MESSAGE_RENDER_TARGET_WRITE             12
+#define GEN6_DATAPORT_WRITE_MESSAGE_STREAMED_VB_WRITE               13
+#define GEN6_DATAPORT_WRITE_MESSAGE_RENDER_TARGET_UNORM_WRITE       14
+
+/* Gen7 sampler and constant caches */
+#define GEN7_DATAPORT_SC_OWORD_BLOCK_READ                           0
+#define GEN7_DATAPORT_SC_UNALIGNED_OWORD_BLOCK_READ                 1
+#define GEN7_DATAPORT_SC_OWORD_DUAL_BLOCK_READ                      2
+#define GEN7_DATAPORT_SC_DWORD_SCATTERED_READ                       3
+#define GEN7_DATAPORT_SC_MEDIA_BLOCK_READ                           4
+
+/* Gen7 render cache */
+#define GEN7_DATAPORT_RC_MEDIA_BLOCK_READ                           4
+#define GEN7_DATAPORT_RC_TYPED_SURFACE_READ                         5
+#define GEN7_DATAPORT_RC_TYPED_ATOMIC_OP                            6
+#define GEN7_DATAPORT_RC_MEMORY_FENCE                               7
+#define GEN7_DATAPORT_RC_MEDIA_BLOCK_WRITE                          10
+#define GEN7_DATAPORT_RC_RENDER_TARGET_WRITE                        12
+#define GEN7_DATAPORT_RC_TYPED_SURFACE_WRITE                        13
+
+/* Gen7 data cache */
+#define GEN7_DATAPORT_DC_OWORD_BLOCK_READ                           0
+#define GEN7_DATAPORT_DC_UNALIGNED_OWORD_BLOCK_READ                 1
+#define GEN7_DATAPORT_DC_OWORD_DUAL_BLOCK_READ                      2
+#define GEN7_DATAPORT_DC_DWORD_SCATTERED_READ                       3
+#define GEN7_DATAPORT_DC_BYTE_SCATTERED_READ                        4
+#define GEN7_DATAPORT_DC_UNTYPED_SURFACE_READ                       5
+#define GEN7_DATAPORT_DC_UNTYPED_ATOMIC_OP                          6
+#define GEN7_DATAPORT_DC_MEMORY_FENCE                               7
+#define GEN7_DATAPORT_DC_OWORD_BLOCK_WRITE                          8
+#define GEN7_DATAPORT_DC_OWORD_DUAL_BLOCK_WRITE                     10
+#define GEN7_DATAPORT_DC_DWORD_SCATTERED_WRITE                      11
+#define GEN7_DATAPORT_DC_BYTE_SCATTERED_WRITE                       12
+#define GEN7_DATAPORT_DC_UNTYPED_SURFACE_WRITE                      13
+
+/* Gen7.5 data cache 1 */
+#define HSW_DATAPORT_DC_PORT1_UNTYPED_SURFACE_READ                  1
+#define HSW_DATAPORT_DC_PORT1_UNTYPED_ATOMIC_OP                     2
+#define HSW_DATAPORT_DC_PORT1_UNTYPED_ATOMIC_OP_SIMD4X2             3
+#define HSW_DATAPORT_DC_PORT1_MEDIA_BLOCK_READ                      4
+#define HSW_DATAPORT_DC_PORT1_TYPED_SURFACE_READ                    5
+#define HSW_DATAPORT_DC_PORT1_TYPED_ATOMIC_OP                       6
+#define HSW_DATAPORT_DC_PORT1_TYPED_ATOMIC_OP_SIMD4X2               7
+#define HSW_DATAPORT_DC_PORT1_UNTYPED_SURFACE_WRITE                 9
+#define HSW_DATAPORT_DC_PORT1_MEDIA_BLOCK_WRITE                     10
+#define HSW_DATAPORT_DC_PORT1_ATOMIC_COUNTER_OP                     11
+#define HSW_DATAPORT_DC_PORT1_ATOMIC_COUNTER_OP_SIMD4X2             12
+#define HSW_DATAPORT_DC_PORT1_TYPED_SURFACE_WRITE                   13
+
 #define BRW_MATH_FUNCTION_INV                              1
 #define BRW_MATH_FUNCTION_LOG                              2
 #define BRW_MATH_FUNCTION_EXP                              3
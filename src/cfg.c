@@ -0,0 +1,179 @@
+/* -*- c-basic-offset: 8 -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+/*
+ * Export of a program's control flow graph, as Graphviz DOT or JSON, with
+ * the instruction count and estimated cycles of every basic block.  Blocks
+ * are shaded by loop depth and backward edges drawn in red so that loops
+ * stand out in large kernels.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gen4asm.h"
+
+static const char *edge_kind[] = {
+	[CFG_EDGE_FALLTHROUGH] = "fallthrough",
+	[CFG_EDGE_BRANCH] = "branch",
+	[CFG_EDGE_RETURN] = "return",
+};
+
+/* How control leaves a block, from its last instruction. */
+static const char *block_exit(struct brw_instruction *inst)
+{
+	if (instruction_ends_thread(inst))
+		return "eot";
+
+	switch (inst->header.opcode) {
+	case BRW_OPCODE_JMPI:
+		return "jmpi";
+	case BRW_OPCODE_IF:
+		return "if";
+	case BRW_OPCODE_IFF:
+		return "iff";
+	case BRW_OPCODE_ELSE:
+		return "else";
+	case BRW_OPCODE_ENDIF:
+		return "endif";
+	case BRW_OPCODE_DO:
+		return "do";
+	case BRW_OPCODE_WHILE:
+		return "while";
+	case BRW_OPCODE_BREAK:
+		return "break";
+	case BRW_OPCODE_CONTINUE:
+		return "cont";
+	case BRW_OPCODE_HALT:
+		return "halt";
+	case BRW_OPCODE_CALL:
+		return "call";
+	case BRW_OPCODE_RET:
+		return "ret";
+	default:
+		return "fallthrough";
+	}
+}
+
+static int is_back_edge(struct cfg_edge *e)
+{
+	return e->kind != CFG_EDGE_RETURN && e->to <= e->from;
+}
+
+static void write_dot(FILE *out, struct brw_instruction **insts,
+		      struct cfg *cfg, int *cycles)
+{
+	int b, j;
+
+	fprintf(out, "digraph cfg {\n");
+	fprintf(out, "\tnode [shape=box, fontname=monospace, style=filled, "
+		"colorscheme=oranges9];\n");
+
+	for (b = 0; b < cfg->nblocks; b++) {
+		struct basic_block *block = &cfg->blocks[b];
+		int depth = block->loop_depth < 8 ? block->loop_depth : 8;
+
+		fprintf(out, "\tb%d [label=\"B%d [%d-%d]\\n"
+			"%d instruction%s\\n%d cycles\\n%s\", fillcolor=%d];\n",
+			b, b, block->start, block->end - 1,
+			block->end - block->start,
+			block->end - block->start == 1 ? "" : "s", cycles[b],
+			block_exit(insts[block->end - 1]), depth + 1);
+	}
+
+	for (j = 0; j < cfg->nedges; j++) {
+		struct cfg_edge *e = &cfg->edges[j];
+
+		fprintf(out, "\tb%d -> b%d", e->from, e->to);
+		if (is_back_edge(e))
+			fprintf(out, " [color=red, penwidth=2]");
+		else if (e->kind == CFG_EDGE_BRANCH)
+			fprintf(out, " [color=blue]");
+		else if (e->kind == CFG_EDGE_RETURN)
+			fprintf(out, " [style=dashed]");
+		fprintf(out, ";\n");
+	}
+	fprintf(out, "}\n");
+}
+
+static void write_json(FILE *out, struct brw_instruction **insts, int n,
+		       struct cfg *cfg, int *cycles)
+{
+	int b, j, total = 0;
+
+	for (b = 0; b < cfg->nblocks; b++)
+		total += cycles[b];
+
+	fprintf(out, "{\n  \"gen\": %ld.%ld,\n", gen_level / 10,
+		gen_level % 10);
+	fprintf(out, "  \"instructions\": %d,\n", n);
+	fprintf(out, "  \"cycles\": %d,\n", total);
+	fprintf(out, "  \"blocks\": [");
+	for (b = 0; b < cfg->nblocks; b++) {
+		struct basic_block *block = &cfg->blocks[b];
+
+		fprintf(out, "%s\n    {\"block\": %d, \"start\": %d, "
+			"\"end\": %d, \"instructions\": %d, \"cycles\": %d, "
+			"\"loop_depth\": %d, \"exit\": \"%s\"}",
+			b ? "," : "", b, block->start, block->end - 1,
+			block->end - block->start, cycles[b],
+			block->loop_depth, block_exit(insts[block->end - 1]));
+	}
+	fprintf(out, "\n  ],\n  \"edges\": [");
+	for (j = 0; j < cfg->nedges; j++) {
+		struct cfg_edge *e = &cfg->edges[j];
+
+		fprintf(out, "%s\n    {\"from\": %d, \"to\": %d, "
+			"\"kind\": \"%s\", \"back\": %s}",
+			j ? "," : "", e->from, e->to, edge_kind[e->kind],
+			is_back_edge(e) ? "true" : "false");
+	}
+	fprintf(out, "\n  ]\n}\n");
+}
+
+/**
+ * Writes the control flow graph of the n instructions to out, as JSON if
+ * json is set and as a Graphviz digraph otherwise.
+ */
+void write_cfg(FILE *out, struct brw_instruction **insts, int n, int json)
+{
+	struct cfg cfg;
+	int *cycles;
+	int b;
+
+	program_cfg(insts, n, &cfg);
+	cycles = calloc(cfg.nblocks + 1, sizeof(*cycles));
+	for (b = 0; b < cfg.nblocks; b++)
+		cycles[b] = estimate_block_cycles(insts, &cfg.blocks[b]);
+
+	if (json)
+		write_json(out, insts, n, &cfg, cycles);
+	else
+		write_dot(out, insts, &cfg, cycles);
+
+	free(cycles);
+	free_cfg(&cfg);
+}
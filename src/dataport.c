@@ -0,0 +1,312 @@
+/* -*- c-basic-offset: 8 -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Named data port messages, shared by the assembler and the disassembler.
+ *
+ * The message type of a data port send and the shared function it goes
+ * to depend on the generation.  Gen4/5 have one read and one write
+ * function and select the cache in the read descriptor, Gen6 splits them
+ * into the sampler, render and constant caches, Gen7 adds the data cache
+ * and Gen7.5 moves the surface and atomic messages to a second data cache
+ * function.
+ */
+
+#include <stdio.h>
+
+#include "gen4asm.h"
+
+const char *dataport_cache_names[DP_CACHE_COUNT] = {
+	[DP_DATA_CACHE] = "data_cache",
+	[DP_DATA_CACHE1] = "data_cache1",
+	[DP_RENDER_CACHE] = "render_cache",
+	[DP_SAMPLER_CACHE] = "sampler_cache",
+	[DP_CONSTANT_CACHE] = "constant_cache",
+};
+
+const char *dataport_message_names[DP_MESSAGE_COUNT] = {
+	[DP_OWORD_BLOCK_READ] = "oword_block_read",
+	[DP_UNALIGNED_OWORD_BLOCK_READ] = "unaligned_oword_block_read",
+	[DP_OWORD_DUAL_BLOCK_READ] = "oword_dual_block_read",
+	[DP_DWORD_BLOCK_READ] = "dword_block_read",
+	[DP_DWORD_SCATTERED_READ] = "dword_scattered_read",
+	[DP_BYTE_SCATTERED_READ] = "byte_scattered_read",
+	[DP_MEDIA_BLOCK_READ] = "media_block_read",
+	[DP_UNTYPED_SURFACE_READ] = "untyped_surface_read",
+	[DP_TYPED_SURFACE_READ] = "typed_surface_read",
+	[DP_OWORD_BLOCK_WRITE] = "oword_block_write",
+	[DP_OWORD_DUAL_BLOCK_WRITE] = "oword_dual_block_write",
+	[DP_DWORD_BLOCK_WRITE] = "dword_block_write",
+	[DP_DWORD_SCATTERED_WRITE] = "dword_scattered_write",
+	[DP_BYTE_SCATTERED_WRITE] = "byte_scattered_write",
+	[DP_MEDIA_BLOCK_WRITE] = "media_block_write",
+	[DP_UNTYPED_SURFACE_WRITE] = "untyped_surface_write",
+	[DP_TYPED_SURFACE_WRITE] = "typed_surface_write",
+	[DP_RENDER_TARGET_WRITE] = "render_target_write",
+	[DP_RENDER_TARGET_UNORM_WRITE] = "render_target_unorm_write",
+	[DP_STREAMED_VB_WRITE] = "streamed_vb_write",
+	[DP_FLUSH_RENDER_CACHE] = "flush_render_cache",
+	[DP_DWORD_ATOMIC_WRITE] = "dword_atomic_write",
+	[DP_UNTYPED_ATOMIC_OP] = "untyped_atomic_op",
+	[DP_UNTYPED_ATOMIC_OP_SIMD4X2] = "untyped_atomic_op_simd4x2",
+	[DP_TYPED_ATOMIC_OP] = "typed_atomic_op",
+	[DP_TYPED_ATOMIC_OP_SIMD4X2] = "typed_atomic_op_simd4x2",
+	[DP_ATOMIC_COUNTER_OP] = "atomic_counter_op",
+	[DP_ATOMIC_COUNTER_OP_SIMD4X2] = "atomic_counter_op_simd4x2",
+	[DP_MEMORY_FENCE] = "memory_fence",
+};
+
+#define DC	(1 << DP_DATA_CACHE)
+#define DC1	(1 << DP_DATA_CACHE1)
+#define RC	(1 << DP_RENDER_CACHE)
+#define SC	(1 << DP_SAMPLER_CACHE)
+#define CC	(1 << DP_CONSTANT_CACHE)
+
+/* Where a message can go to more than one cache, the first one in enum
+ * dataport_cache order is the default.
+ */
+static const struct dataport_message_desc dataport_messages[] = {
+	/* Gen4/5 */
+	{ DP_OWORD_BLOCK_READ, 40, 59, DC | RC | SC,
+	  BRW_DATAPORT_READ_MESSAGE_OWORD_BLOCK_READ, 0 },
+	{ DP_OWORD_DUAL_BLOCK_READ, 40, 59, DC | RC | SC,
+	  BRW_DATAPORT_READ_MESSAGE_OWORD_DUAL_BLOCK_READ, 0 },
+	{ DP_DWORD_BLOCK_READ, 40, 59, DC | RC | SC,
+	  BRW_DATAPORT_READ_MESSAGE_DWORD_BLOCK_READ, 0 },
+	{ DP_DWORD_SCATTERED_READ, 40, 59, DC | RC | SC,
+	  BRW_DATAPORT_READ_MESSAGE_DWORD_SCATTERED_READ, 0 },
+	{ DP_OWORD_BLOCK_WRITE, 40, 59, RC,
+	  BRW_DATAPORT_WRITE_MESSAGE_OWORD_BLOCK_WRITE, 1 },
+	{ DP_OWORD_DUAL_BLOCK_WRITE, 40, 59, RC,
+	  BRW_DATAPORT_WRITE_MESSAGE_OWORD_DUAL_BLOCK_WRITE, 1 },
+	{ DP_DWORD_BLOCK_WRITE, 40, 59, RC,
+	  BRW_DATAPORT_WRITE_MESSAGE_DWORD_BLOCK_WRITE, 1 },
+	{ DP_DWORD_SCATTERED_WRITE, 40, 59, RC,
+	  BRW_DATAPORT_WRITE_MESSAGE_DWORD_SCATTERED_WRITE, 1 },
+	{ DP_RENDER_TARGET_WRITE, 40, 59, RC,
+	  BRW_DATAPORT_WRITE_MESSAGE_RENDER_TARGET_WRITE, 1 },
+	{ DP_STREAMED_VB_WRITE, 40, 59, RC,
+	  BRW_DATAPORT_WRITE_MESSAGE_STREAMED_VERTEX_BUFFER_WRITE, 1 },
+	{ DP_FLUSH_RENDER_CACHE, 40, 59, RC,
+	  BRW_DATAPORT_WRITE_MESSAGE_FLUSH_RENDER_CACHE, 1 },
+
+	/* Gen6 */
+	{ DP_OWORD_BLOCK_READ, 60, 69, SC | CC,
+	  GEN6_DATAPORT_READ_MESSAGE_OWORD_BLOCK_READ },
+	{ DP_OWORD_DUAL_BLOCK_READ, 60, 69, SC | CC,
+	  GEN6_DATAPORT_READ_MESSAGE_OWORD_DUAL_BLOCK_READ },
+	{ DP_MEDIA_BLOCK_READ, 60, 69, SC | CC,
+	  GEN6_DATAPORT_READ_MESSAGE_MEDIA_BLOCK_READ },
+	{ DP_UNALIGNED_OWORD_BLOCK_READ, 60, 69, SC | CC,
+	  GEN6_DATAPORT_READ_MESSAGE_OWORD_UNALIGN_BLOCK_READ },
+	{ DP_DWORD_SCATTERED_READ, 60, 69, SC | CC,
+	  GEN6_DATAPORT_READ_MESSAGE_DWORD_SCATTERED_READ },
+	{ DP_DWORD_ATOMIC_WRITE, 60, 69, RC,
+	  GEN6_DATAPORT_WRITE_MESSAGE_DWORD_ATOMIC_WRITE },
+	{ DP_OWORD_BLOCK_WRITE, 60, 69, RC,
+	  GEN6_DATAPORT_WRITE_MESSAGE_OWORD_BLOCK_WRITE },
+	{ DP_OWORD_DUAL_BLOCK_WRITE, 60, 69, RC,
+	  GEN6_DATAPORT_WRITE_MESSAGE_OWORD_DUAL_BLOCK_WRITE },
+	{ DP_MEDIA_BLOCK_WRITE, 60, 69, RC,
+	  GEN6_DATAPORT_WRITE_MESSAGE_MEDIA_BLOCK_WRITE },
+	{ DP_DWORD_SCATTERED_WRITE, 60, 69, RC,
+	  GEN6_DATAPORT_WRITE_MESSAGE_DWORD_SCATTERED_WRITE },
+	{ DP_RENDER_TARGET_WRITE, 60, 69, RC,
+	  GEN6_DATAPORT_WRITE_MESSAGE_RENDER_TARGET_WRITE },
+	{ DP_STREAMED_VB_WRITE, 60, 69, RC,
+	  GEN6_DATAPORT_WRITE_MESSAGE_STREAMED_VB_WRITE },
+	{ DP_RENDER_TARGET_UNORM_WRITE, 60, 69, RC,
+	  GEN6_DATAPORT_WRITE_MESSAGE_RENDER_TARGET_UNORM_WRITE },
+
+	/* Gen7: the sampler and constant caches share the data cache's
+	 * read message types.
+	 */
+	{ DP_OWORD_BLOCK_READ, 70, 75, DC | SC | CC,
+	  GEN7_DATAPORT_DC_OWORD_BLOCK_READ },
+	{ DP_UNALIGNED_OWORD_BLOCK_READ, 70, 75, DC | SC | CC,
+	  GEN7_DATAPORT_DC_UNALIGNED_OWORD_BLOCK_READ },
+	{ DP_OWORD_DUAL_BLOCK_READ, 70, 75, DC | SC | CC,
+	  GEN7_DATAPORT_DC_OWORD_DUAL_BLOCK_READ },
+	{ DP_DWORD_SCATTERED_READ, 70, 75, DC | SC | CC,
+	  GEN7_DATAPORT_DC_DWORD_SCATTERED_READ },
+	{ DP_BYTE_SCATTERED_READ, 70, 75, DC,
+	  GEN7_DATAPORT_DC_BYTE_SCATTERED_READ },
+	{ DP_MEDIA_BLOCK_READ, 70, 75, RC | SC,
+	  GEN7_DATAPORT_RC_MEDIA_BLOCK_READ },
+	{ DP_UNTYPED_SURFACE_READ, 70, 70, DC,
+	  GEN7_DATAPORT_DC_UNTYPED_SURFACE_READ },
+	{ DP_UNTYPED_ATOMIC_OP, 70, 70, DC,
+	  GEN7_DATAPORT_DC_UNTYPED_ATOMIC_OP },
+	{ DP_MEMORY_FENCE, 70, 75, DC | RC,
+	  GEN7_DATAPORT_DC_MEMORY_FENCE },
+	{ DP_OWORD_BLOCK_WRITE, 70, 75, DC,
+	  GEN7_DATAPORT_DC_OWORD_BLOCK_WRITE },
+	{ DP_OWORD_DUAL_BLOCK_WRITE, 70, 75, DC,
+	  GEN7_DATAPORT_DC_OWORD_DUAL_BLOCK_WRITE },
+	{ DP_DWORD_SCATTERED_WRITE, 70, 75, DC,
+	  GEN7_DATAPORT_DC_DWORD_SCATTERED_WRITE },
+	{ DP_BYTE_SCATTERED_WRITE, 70, 75, DC,
+	  GEN7_DATAPORT_DC_BYTE_SCATTERED_WRITE },
+	{ DP_UNTYPED_SURFACE_WRITE, 70, 70, DC,
+	  GEN7_DATAPORT_DC_UNTYPED_SURFACE_WRITE },
+	{ DP_TYPED_SURFACE_READ, 70, 70, RC,
+	  GEN7_DATAPORT_RC_TYPED_SURFACE_READ },
+	{ DP_TYPED_ATOMIC_OP, 70, 70, RC,
+	  GEN7_DATAPORT_RC_TYPED_ATOMIC_OP },
+	{ DP_MEDIA_BLOCK_WRITE, 70, 75, RC,
+	  GEN7_DATAPORT_RC_MEDIA_BLOCK_WRITE },
+	{ DP_RENDER_TARGET_WRITE, 70, 75, RC,
+	  GEN7_DATAPORT_RC_RENDER_TARGET_WRITE },
+	{ DP_TYPED_SURFACE_WRITE, 70, 70, RC,
+	  GEN7_DATAPORT_RC_TYPED_SURFACE_WRITE },
+
+	/* Gen7.5 data cache 1 */
+	{ DP_UNTYPED_SURFACE_READ, 75, 75, DC1,
+	  HSW_DATAPORT_DC_PORT1_UNTYPED_SURFACE_READ },
+	{ DP_UNTYPED_ATOMIC_OP, 75, 75, DC1,
+	  HSW_DATAPORT_DC_PORT1_UNTYPED_ATOMIC_OP },
+	{ DP_UNTYPED_ATOMIC_OP_SIMD4X2, 75, 75, DC1,
+	  HSW_DATAPORT_DC_PORT1_UNTYPED_ATOMIC_OP_SIMD4X2 },
+	{ DP_MEDIA_BLOCK_READ, 75, 75, DC1,
+	  HSW_DATAPORT_DC_PORT1_MEDIA_BLOCK_READ },
+	{ DP_TYPED_SURFACE_READ, 75, 75, DC1,
+	  HSW_DATAPORT_DC_PORT1_TYPED_SURFACE_READ },
+	{ DP_TYPED_ATOMIC_OP, 75, 75, DC1,
+	  HSW_DATAPORT_DC_PORT1_TYPED_ATOMIC_OP },
+	{ DP_TYPED_ATOMIC_OP_SIMD4X2, 75, 75, DC1,
+	  HSW_DATAPORT_DC_PORT1_TYPED_ATOMIC_OP_SIMD4X2 },
+	{ DP_UNTYPED_SURFACE_WRITE, 75, 75, DC1,
+	  HSW_DATAPORT_DC_PORT1_UNTYPED_SURFACE_WRITE },
+	{ DP_MEDIA_BLOCK_WRITE, 75, 75, DC1,
+	  HSW_DATAPORT_DC_PORT1_MEDIA_BLOCK_WRITE },
+	{ DP_ATOMIC_COUNTER_OP, 75, 75, DC1,
+	  HSW_DATAPORT_DC_PORT1_ATOMIC_COUNTER_OP },
+	{ DP_ATOMIC_COUNTER_OP_SIMD4X2, 75, 75, DC1,
+	  HSW_DATAPORT_DC_PORT1_ATOMIC_COUNTER_OP_SIMD4X2 },
+	{ DP_TYPED_SURFACE_WRITE, 75, 75, DC1,
+	  HSW_DATAPORT_DC_PORT1_TYPED_SURFACE_WRITE },
+};
+
+#define NUM_DATAPORT_MESSAGES \
+	(sizeof(dataport_messages) / sizeof(dataport_messages[0]))
+
+static int lowest_cache(int caches)
+{
+	int cache;
+
+	for (cache = 0; !(caches & (1 << cache)); cache++)
+		;
+	return cache;
+}
+
+/**
+ * Finds how the current generation encodes message.  A negative *cache
+ * asks for the message's default cache, which is stored back.
+ *
+ * Returns NULL if the generation doesn't have the message on that cache.
+ */
+const struct dataport_message_desc *dataport_message_lookup(int message,
+							    int *cache)
+{
+	unsigned int i;
+
+	for (i = 0; i < NUM_DATAPORT_MESSAGES; i++) {
+		const struct dataport_message_desc *desc = &dataport_messages[i];
+
+		if (desc->message != message ||
+		    gen_level < desc->gen_min || gen_level > desc->gen_max)
+			continue;
+		if (*cache < 0)
+			*cache = lowest_cache(desc->caches);
+		if (desc->caches & (1 << *cache))
+			return desc;
+	}
+	return NULL;
+}
+
+/**
+ * Finds the message a data port descriptor of the current generation
+ * encodes.  write tells Gen4/5 reads and writes apart.
+ *
+ * Returns NULL if no message matches.
+ */
+const struct dataport_message_desc *dataport_message_decode(int cache,
+							    int write,
+							    int msg_type)
+{
+	unsigned int i;
+
+	for (i = 0; i < NUM_DATAPORT_MESSAGES; i++) {
+		const struct dataport_message_desc *desc = &dataport_messages[i];
+
+		if (gen_level < desc->gen_min || gen_level > desc->gen_max ||
+		    !(desc->caches & (1 << cache)) ||
+		    desc->msg_type != msg_type)
+			continue;
+		if (!IS_GENp(6) && desc->write != write)
+			continue;
+		return desc;
+	}
+	return NULL;
+}
+
+/** Returns the Gen6+ shared function of a cache. */
+int dataport_cache_sfid(int cache)
+{
+	switch (cache) {
+	case DP_DATA_CACHE:
+		return BRW_MESSAGE_TARGET_DP_DC;
+	case DP_DATA_CACHE1:
+		return BRW_MESSAGE_TARGET_DP_DC1;
+	case DP_RENDER_CACHE:
+		return BRW_MESSAGE_TARGET_DP_RC;
+	case DP_SAMPLER_CACHE:
+		return BRW_MESSAGE_TARGET_DP_SC;
+	default:
+		return BRW_MESSAGE_TARGET_DP_CC;
+	}
+}
+
+/**
+ * Returns the cache behind a Gen6+ shared function, or -1 if it isn't a
+ * data port.
+ */
+int dataport_sfid_cache(int sfid)
+{
+	switch (sfid) {
+	case BRW_MESSAGE_TARGET_DP_DC:
+		return IS_GENp(7) ? DP_DATA_CACHE : -1;
+	case BRW_MESSAGE_TARGET_DP_DC1:
+		return gen_level >= 75 ? DP_DATA_CACHE1 : -1;
+	case BRW_MESSAGE_TARGET_DP_RC:
+		return DP_RENDER_CACHE;
+	case BRW_MESSAGE_TARGET_DP_SC:
+		return DP_SAMPLER_CACHE;
+	case BRW_MESSAGE_TARGET_DP_CC:
+		return DP_CONSTANT_CACHE;
+	default:
+		return -1;
+	}
+}
@@ -0,0 +1,584 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * intel-gen4diff compares two kernels instruction by instruction.
+ *
+ * Branch distances are cleared before the instructions are aligned, so
+ * that an inserted instruction doesn't make every branch across it look
+ * changed.  Instead, a branch is reported when the instruction it goes
+ * to is no longer the one it went to before.  Instructions that aren't
+ * matched but have the same opcode as one that went away at the same
+ * place are reported as changed, with the fields that differ.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "gen4asm.h"
+
+long int gen_level = 40;
+
+static const struct option longopts[] = {
+	{"gen", required_argument, 0, 'g'},
+	{"binary", no_argument, 0, 'b'},
+	{"raw", no_argument, 0, 'r'},
+	{"unified", required_argument, 0, 'U'},
+	{ NULL, 0, NULL, 0 }
+};
+
+struct kernel {
+    const char		*name;
+    uint32_t		*insts;		/* as read, for printing */
+    uint32_t		*norm;		/* with the branch distances cleared */
+    int			n;
+    int			*map;		/* matching instruction in the other */
+};
+
+enum diff_op {
+    DIFF_SAME,
+    DIFF_DELETE,
+    DIFF_INSERT,
+    DIFF_CHANGE,
+};
+
+struct diff_line {
+    enum diff_op	op;
+    int			a, b;		/* instruction numbers, or -1 */
+};
+
+/* Bits of an instruction that mean one thing, lowest first. */
+struct inst_field {
+    const char	*name;
+    int		lo, hi;
+};
+
+static const struct inst_field header_fields[] = {
+    { "opcode", 0, 6 },
+    { "reserved", 7, 7 },
+    { "access mode", 8, 8 },
+    { "mask control", 9, 9 },
+    { "dependency control", 10, 11 },
+    { "compression control", 12, 13 },
+    { "thread control", 14, 15 },
+    { "predicate control", 16, 19 },
+    { "predicate inverse", 20, 20 },
+    { "execution size", 21, 23 },
+    { "conditional modifier", 24, 27 },
+    { "accumulator write", 28, 28 },
+    { "compaction control", 29, 29 },
+    { "debug control", 30, 30 },
+    { "saturate", 31, 31 },
+    { NULL }
+};
+
+static const struct inst_field alu_fields[] = {
+    { "operand types", 32, 47 },
+    { "destination", 48, 63 },
+    { "source 0", 64, 88 },
+    { "flag register", 89, 90 },
+    { "reserved", 91, 95 },
+    { "source 1", 96, 127 },
+    { NULL }
+};
+
+static const struct inst_field three_src_fields[] = {
+    { "destination register file", 32, 32 },
+    { "flag register", 33, 34 },
+    { "reserved", 35, 35 },
+    { "source modifiers", 36, 41 },
+    { "operand types", 42, 45 },
+    { "reserved", 46, 46 },
+    { "nibble control", 47, 47 },
+    { "reserved", 48, 48 },
+    { "destination", 49, 63 },
+    { "source 0", 64, 83 },
+    { "reserved", 84, 84 },
+    { "source 1", 85, 104 },
+    { "reserved", 105, 105 },
+    { "source 2", 106, 125 },
+    { "reserved", 126, 127 },
+    { NULL }
+};
+
+static struct brw_instruction *
+inst_at (uint32_t *insts, int i)
+{
+    return (struct brw_instruction *) (insts + i * INST_SIZE / 4);
+}
+
+static void
+load_kernel (struct kernel *k, const char *name, enum input_format format)
+{
+    char	*data;
+    size_t	size;
+    int		mapped, fd = STDIN_FILENO, i;
+    uint32_t	*insts;
+
+    k->name = name;
+    if (strcmp (name, "-") != 0) {
+	fd = open (name, O_RDONLY);
+	if (fd < 0) {
+	    fprintf (stderr, "Couldn't open %s: ", name);
+	    perror (NULL);
+	    exit (2);
+	}
+    }
+    data = load_input (fd, &size, &mapped);
+    if (format == INPUT_AUTO)
+	format = detect_input_format (data, size);
+    if (format == INPUT_RAW)
+	insts = raw_instructions (data, size, &k->n);
+    else
+	insts = parse_hex_text (data, size, format == INPUT_BYTES, &k->n);
+
+    /* Raw input may be read in place, from a read-only mapping. */
+    k->insts = malloc ((k->n + 1) * INST_SIZE);
+    k->norm = malloc ((k->n + 1) * INST_SIZE);
+    k->map = malloc ((k->n + 1) * sizeof (*k->map));
+    if (k->insts == NULL || k->norm == NULL || k->map == NULL) {
+	fprintf (stderr, "Couldn't allocate %d instructions\n", k->n);
+	exit (2);
+    }
+    memcpy (k->insts, insts, k->n * INST_SIZE);
+    if ((char *) insts != data)
+	free (insts);
+    if (mapped)
+	munmap (data, size);
+    else
+	free (data);
+    if (fd != STDIN_FILENO)
+	close (fd);
+
+    memcpy (k->norm, k->insts, k->n * INST_SIZE);
+    for (i = 0; i < k->n; i++) {
+	int targets[INST_MAX_TARGETS];
+
+	if (instruction_branch_targets (inst_at (k->insts, i), i, targets) > 0)
+	    instruction_clear_branch_offsets (inst_at (k->norm, i));
+    }
+}
+
+static int
+branch_targets (struct kernel *k, int i, int *targets)
+{
+    return instruction_branch_targets (inst_at (k->insts, i), i, targets);
+}
+
+/*
+ * The instruction of b that matches target, an instruction of a, or -2
+ * when there is none.
+ */
+static int
+map_target (struct kernel *a, struct kernel *b, int target)
+{
+    if (target == a->n)
+	return b->n;
+    if (target < 0 || target > a->n)
+	return -2;
+    return a->map[target] >= 0 ? a->map[target] : -2;
+}
+
+/* Whether the branches at a[i] and b[j] go to matching instructions. */
+static int
+same_targets (struct kernel *a, int i, struct kernel *b, int j)
+{
+    int	ta[INST_MAX_TARGETS], tb[INST_MAX_TARGETS];
+    int	na, nb, t;
+
+    na = branch_targets (a, i, ta);
+    nb = branch_targets (b, j, tb);
+    if (na != nb)
+	return 0;
+    for (t = 0; t < na; t++)
+	if (map_target (a, b, ta[t]) != tb[t])
+	    return 0;
+    return 1;
+}
+
+static int
+same_opcode (struct kernel *a, int i, struct kernel *b, int j)
+{
+    return inst_at (a->insts, i)->header.opcode ==
+	inst_at (b->insts, j)->header.opcode;
+}
+
+/*
+ * Lines up the deletions a[i, iend) with the insertions b[j, jend) in
+ * between two matched instructions, pairing those with the same opcode
+ * as changes.  Changed pairs are recorded in the maps too, so branches
+ * into them still find their target.
+ */
+static int
+pair_run (struct kernel *a, int i, int iend, struct kernel *b, int j, int jend,
+	  struct diff_line *lines, int n)
+{
+    int	look;
+
+    while (i < iend || j < jend) {
+	if (i < iend && j < jend && same_opcode (a, i, b, j)) {
+	    a->map[i] = j;
+	    b->map[j] = i;
+	    lines[n].op = DIFF_CHANGE;
+	    lines[n].a = i++;
+	    lines[n++].b = j++;
+	    continue;
+	}
+	/* A few insertions may come before the next change. */
+	for (look = j; i < iend && look < jend && look < j + 8; look++)
+	    if (same_opcode (a, i, b, look))
+		break;
+	if (i < iend && (look == jend || look == j + 8)) {
+	    lines[n].op = DIFF_DELETE;
+	    lines[n].a = i++;
+	    lines[n++].b = -1;
+	} else {
+	    lines[n].op = DIFF_INSERT;
+	    lines[n].a = -1;
+	    lines[n++].b = j++;
+	}
+    }
+    return n;
+}
+
+/*
+ * Branches of matching instructions are compared once all the runs in
+ * between are paired, since they may jump forward into any of them.
+ */
+static int
+diff_lines (struct kernel *a, struct kernel *b, struct diff_line *lines)
+{
+    int	i = 0, j = 0, iend, jend, n = 0, l;
+
+    while (i < a->n || j < b->n) {
+	if (i < a->n && j < b->n && a->map[i] == j) {
+	    lines[n].op = DIFF_SAME;
+	    lines[n].a = i++;
+	    lines[n++].b = j++;
+	    continue;
+	}
+	for (iend = i; iend < a->n && a->map[iend] < 0; iend++)
+	    ;
+	for (jend = j; jend < b->n && b->map[jend] < 0; jend++)
+	    ;
+	n = pair_run (a, i, iend, b, j, jend, lines, n);
+	i = iend;
+	j = jend;
+    }
+    for (l = 0; l < n; l++)
+	if (lines[l].op == DIFF_SAME &&
+	    !same_targets (a, lines[l].a, b, lines[l].b))
+	    lines[l].op = DIFF_CHANGE;
+    return n;
+}
+
+static void
+print_number (FILE *output, int i)
+{
+    if (i >= 0)
+	fprintf (output, " %6d", i);
+    else
+	fprintf (output, "       ");
+}
+
+/* Prints the disassembly of an instruction, prefixed on every line. */
+static void
+print_inst (FILE *output, struct disasm_output *out, char mark,
+	    int i, int j, struct brw_instruction *inst, int ip)
+{
+    char	*line, *end;
+
+    out->len = 0;
+    out->column = 0;
+    disasm_at (out, inst, ip, NULL);
+    for (line = out->buf; line < out->buf + out->len; line = end + 1) {
+	end = memchr (line, '\n', out->buf + out->len - line);
+	if (end == NULL)
+	    end = out->buf + out->len;
+	fputc (mark, output);
+	print_number (output, i);
+	print_number (output, j);
+	fprintf (output, "  %.*s\n", (int) (end - line), line);
+	i = j = -1;
+    }
+}
+
+static unsigned int
+field_value (const uint32_t *inst, const struct inst_field *f)
+{
+    unsigned int	value = 0;
+    int			bit;
+
+    for (bit = f->hi; bit >= f->lo; bit--)
+	value = value << 1 | (inst[bit / 32] >> (bit % 32) & 1);
+    return value;
+}
+
+static void
+print_field_changes (FILE *output, const uint32_t *a, const uint32_t *b,
+		     const struct inst_field *fields, int send)
+{
+    const struct inst_field	*f;
+    const char			*name;
+    unsigned int		va, vb;
+
+    for (f = fields; f->name; f++) {
+	va = field_value (a, f);
+	vb = field_value (b, f);
+	if (va == vb)
+	    continue;
+	name = f->name;
+	if (send && f->lo == 24)
+	    name = IS_GENp(6) ? "message target" : "message register";
+	else if (send && f->lo == 96)
+	    name = "message descriptor";
+	fprintf (output, "!%16s    %s: 0x%x -> 0x%x\n", "", name, va, vb);
+    }
+}
+
+static void
+print_target (FILE *output, int target, int mapped)
+{
+    if (mapped == target)
+	fprintf (output, "%d", target);
+    else if (mapped == -2)
+	fprintf (output, "%d (gone)", target);
+    else
+	fprintf (output, "%d (now %d)", target, mapped);
+}
+
+static void
+print_change (FILE *output, struct disasm_output *out,
+	      struct kernel *a, int i, struct kernel *b, int j)
+{
+    struct brw_instruction	*ia = inst_at (a->insts, i);
+    struct brw_instruction	*ib = inst_at (b->insts, j);
+    const uint32_t		*na = (uint32_t *) inst_at (a->norm, i);
+    const uint32_t		*nb = (uint32_t *) inst_at (b->norm, j);
+    int				ta[INST_MAX_TARGETS], tb[INST_MAX_TARGETS];
+    int				ca, cb, t;
+
+    print_inst (output, out, '!', i, -1, ia, i);
+    print_inst (output, out, '!', -1, j, ib, j);
+
+    print_field_changes (output, na, nb, header_fields,
+			 ia->header.opcode == BRW_OPCODE_SEND ||
+			 ia->header.opcode == BRW_OPCODE_SENDC);
+    print_field_changes (output, na, nb,
+			 instruction_is_three_src (ia) ?
+			 three_src_fields : alu_fields,
+			 ia->header.opcode == BRW_OPCODE_SEND ||
+			 ia->header.opcode == BRW_OPCODE_SENDC);
+
+    ca = branch_targets (a, i, ta);
+    cb = branch_targets (b, j, tb);
+    for (t = 0; t < ca || t < cb; t++) {
+	if (t < ca && t < cb && map_target (a, b, ta[t]) == tb[t])
+	    continue;
+	fprintf (output, "!%16s    branch target: ", "");
+	if (t < ca)
+	    print_target (output, ta[t], map_target (a, b, ta[t]));
+	else
+	    fprintf (output, "none");
+	fprintf (output, " -> ");
+	if (t < cb)
+	    fprintf (output, "%d\n", tb[t]);
+	else
+	    fprintf (output, "none\n");
+    }
+}
+
+/* Instruction numbers of lines[l] onwards, for hunk headers. */
+static void
+first_numbers (struct diff_line *lines, int nlines, int l, int *a, int *b)
+{
+    *a = *b = -1;
+    for (; l < nlines && (*a < 0 || *b < 0); l++) {
+	if (*a < 0 && lines[l].a >= 0)
+	    *a = lines[l].a;
+	if (*b < 0 && lines[l].b >= 0)
+	    *b = lines[l].b;
+    }
+}
+
+static void
+print_hunk (FILE *output, struct disasm_output *out,
+	    struct kernel *a, struct kernel *b,
+	    struct diff_line *lines, int nlines, int start, int end)
+{
+    int	l, la = 0, lb = 0, fa, fb;
+
+    for (l = start; l < end; l++) {
+	la += lines[l].a >= 0;
+	lb += lines[l].b >= 0;
+    }
+    first_numbers (lines, nlines, start, &fa, &fb);
+    if (fa < 0)
+	fa = a->n;
+    if (fb < 0)
+	fb = b->n;
+    fprintf (output, "@@ -%d,%d +%d,%d @@\n", fa, la, fb, lb);
+
+    for (l = start; l < end; l++) {
+	struct diff_line *d = &lines[l];
+
+	switch (d->op) {
+	case DIFF_SAME:
+	    print_inst (output, out, ' ', d->a, d->b,
+			inst_at (b->insts, d->b), d->b);
+	    break;
+	case DIFF_DELETE:
+	    print_inst (output, out, '-', d->a, -1,
+			inst_at (a->insts, d->a), d->a);
+	    break;
+	case DIFF_INSERT:
+	    print_inst (output, out, '+', -1, d->b,
+			inst_at (b->insts, d->b), d->b);
+	    break;
+	case DIFF_CHANGE:
+	    print_change (output, out, a, d->a, b, d->b);
+	    break;
+	}
+    }
+}
+
+/*
+ * Prints the lines that differ with context lines of context around
+ * them, and returns how many instructions differ.
+ */
+static int
+print_diff (FILE *output, struct kernel *a, struct kernel *b,
+	    struct diff_line *lines, int nlines, int context)
+{
+    struct disasm_output	out;
+    int				l, start, end, last;
+    int				changed = 0, inserted = 0, deleted = 0;
+
+    disasm_output_init (&out, NULL);
+    for (l = 0; l < nlines; l++) {
+	if (lines[l].op == DIFF_SAME)
+	    continue;
+	if (changed + inserted + deleted == 0)
+	    fprintf (output, "--- %s\n+++ %s\n", a->name, b->name);
+
+	/* Extend the hunk while the gaps are short enough to show. */
+	start = l > context ? l - context : 0;
+	last = l;
+	for (end = l + 1; end < nlines && end <= last + 2 * context; end++)
+	    if (lines[end].op != DIFF_SAME)
+		last = end;
+	end = last + 1 + context < nlines ? last + 1 + context : nlines;
+
+	for (; l <= last; l++) {
+	    changed += lines[l].op == DIFF_CHANGE;
+	    inserted += lines[l].op == DIFF_INSERT;
+	    deleted += lines[l].op == DIFF_DELETE;
+	}
+	print_hunk (output, &out, a, b, lines, nlines, start, end);
+	l = last;
+    }
+    disasm_output_fini (&out);
+
+    if (changed + inserted + deleted)
+	fprintf (output, "%d changed, %d inserted, %d deleted\n",
+		 changed, inserted, deleted);
+    return changed + inserted + deleted;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: intel-gen4diff [-b | -r] [-g <4|5|6|7>] [-U n] oldfile newfile\n");
+    fprintf(stderr, "\t-b, --binary                         Read the byte arrays written by intel-gen4asm -b\n");
+    fprintf(stderr, "\t-r, --raw                            Read raw little-endian instructions\n");
+    fprintf(stderr, "\t    The input format is detected when neither is given\n");
+    fprintf(stderr, "\t-U, --unified {n}                    Show n instructions of context, 3 by default\n");
+    fprintf(stderr, "\tExits with 0 if the kernels match, 1 if they differ and 2 on trouble\n");
+}
+
+int main(int argc, char **argv)
+{
+    struct kernel	a, b;
+    struct diff_line	*lines;
+    enum input_format	format = INPUT_AUTO;
+    int			context = 3;
+    int			o, nlines, differ;
+
+    while ((o = getopt_long(argc, argv, "brg:U:", longopts, NULL)) != -1) {
+	switch (o) {
+	case 'b':
+	    format = INPUT_BYTES;
+	    break;
+	case 'r':
+	    format = INPUT_RAW;
+	    break;
+	case 'U':
+	    context = atoi(optarg);
+	    if (context < 0)
+		context = 0;
+	    break;
+	case 'g':
+	    gen_level = parse_gen_level(optarg);
+	    if (gen_level < 0) {
+		usage();
+		exit(2);
+	    }
+	    break;
+	default:
+	    usage();
+	    exit(2);
+	}
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc != 2) {
+	usage();
+	exit(2);
+    }
+
+    load_kernel (&a, argv[0], format);
+    load_kernel (&b, argv[1], format);
+
+    diff_align (a.norm, a.n, b.norm, b.n, a.map, b.map);
+
+    lines = malloc ((a.n + b.n + 1) * sizeof (*lines));
+    if (lines == NULL) {
+	fprintf (stderr, "Couldn't allocate the diff\n");
+	exit (2);
+    }
+    nlines = diff_lines (&a, &b, lines);
+    differ = print_diff (stdout, &a, &b, lines, nlines, context);
+
+    free (lines);
+    free (a.insts);
+    free (a.norm);
+    free (a.map);
+    free (b.insts);
+    free (b.norm);
+    free (b.map);
+    exit (differ ? 1 : 0);
+}
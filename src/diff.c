@@ -0,0 +1,339 @@
+/* -*- c-basic-offset: 8 -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Aligning two instruction streams.
+ *
+ * Instructions that occur exactly once in each stream are matched first,
+ * keeping the longest run of them that is in the same order in both, as
+ * patience diff does.  Kernels are mostly made of such instructions, so
+ * this pins down most of the alignment in linear time.  The gaps between
+ * them are filled in with Myers' O(ND) algorithm, in its linear space
+ * form, which gives up on an optimal alignment past a cost that grows
+ * with the square root of the gap, as GNU diff does.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gen4asm.h"
+
+#define WORDS	(INST_SIZE / 4)
+
+struct diff {
+	const uint32_t *a, *b;
+	int *a2b, *b2a;
+	int *fd, *bd;		/* furthest x on each diagonal */
+	int too_expensive;
+};
+
+static int equal(struct diff *d, int x, int y)
+{
+	return memcmp(d->a + x * WORDS, d->b + y * WORDS, INST_SIZE) == 0;
+}
+
+static void match(struct diff *d, int x, int y)
+{
+	d->a2b[x] = y;
+	d->b2a[y] = x;
+}
+
+/*
+ * Finds a point of an alignment of a[xoff, xlim) with b[yoff, ylim) that
+ * splits it in two, from the middle snake of a shortest edit script.
+ * Past d->too_expensive edits the furthest point reached so far is used
+ * instead, which keeps the time bounded but may not be optimal.
+ */
+static void split(struct diff *d, int xoff, int xlim, int yoff, int ylim,
+		  int *xmid, int *ymid)
+{
+	int *fd = d->fd, *bd = d->bd;
+	int dmin = xoff - ylim, dmax = xlim - yoff;
+	int fmid = xoff - yoff, bmid = xlim - ylim;
+	int fmin = fmid, fmax = fmid, bmin = bmid, bmax = bmid;
+	int odd = (fmid - bmid) & 1;
+	int c, k, x, y;
+
+	fd[fmid] = xoff;
+	bd[bmid] = xlim;
+	for (c = 1;; c++) {
+		if (fmin > dmin)
+			fd[--fmin - 1] = -1;
+		else
+			fmin++;
+		if (fmax < dmax)
+			fd[++fmax + 1] = -1;
+		else
+			fmax--;
+		for (k = fmax; k >= fmin; k -= 2) {
+			x = fd[k - 1] >= fd[k + 1] ? fd[k - 1] + 1 : fd[k + 1];
+			y = x - k;
+			while (x < xlim && y < ylim && equal(d, x, y)) {
+				x++;
+				y++;
+			}
+			fd[k] = x;
+			if (odd && bmin <= k && k <= bmax && bd[k] <= x) {
+				*xmid = x;
+				*ymid = y;
+				return;
+			}
+		}
+
+		if (bmin > dmin)
+			bd[--bmin - 1] = INT_MAX;
+		else
+			bmin++;
+		if (bmax < dmax)
+			bd[++bmax + 1] = INT_MAX;
+		else
+			bmax--;
+		for (k = bmax; k >= bmin; k -= 2) {
+			x = bd[k - 1] < bd[k + 1] ? bd[k - 1] : bd[k + 1] - 1;
+			y = x - k;
+			while (x > xoff && y > yoff && equal(d, x - 1, y - 1)) {
+				x--;
+				y--;
+			}
+			bd[k] = x;
+			if (!odd && fmin <= k && k <= fmax && x <= fd[k]) {
+				*xmid = x;
+				*ymid = y;
+				return;
+			}
+		}
+
+		if (c >= d->too_expensive) {
+			int fbest = -1, bbest = INT_MAX;
+			int fx = xoff, fy = yoff, bx = xlim, by = ylim;
+
+			for (k = fmax; k >= fmin; k -= 2) {
+				x = fd[k] < xlim ? fd[k] : xlim;
+				y = x - k;
+				if (y > ylim) {
+					y = ylim;
+					x = y + k;
+				}
+				if (x + y > fbest) {
+					fbest = x + y;
+					fx = x;
+					fy = y;
+				}
+			}
+			for (k = bmax; k >= bmin; k -= 2) {
+				x = bd[k] > xoff ? bd[k] : xoff;
+				y = x - k;
+				if (y < yoff) {
+					y = yoff;
+					x = y + k;
+				}
+				if (x + y < bbest) {
+					bbest = x + y;
+					bx = x;
+					by = y;
+				}
+			}
+			if (fbest - (xoff + yoff) >= (xlim + ylim) - bbest) {
+				*xmid = fx;
+				*ymid = fy;
+			} else {
+				*xmid = bx;
+				*ymid = by;
+			}
+			return;
+		}
+	}
+}
+
+static void compare(struct diff *d, int xoff, int xlim, int yoff, int ylim)
+{
+	int xmid, ymid;
+
+	while (xoff < xlim && yoff < ylim && equal(d, xoff, yoff))
+		match(d, xoff++, yoff++);
+	while (xlim > xoff && ylim > yoff && equal(d, xlim - 1, ylim - 1))
+		match(d, --xlim, --ylim);
+	if (xoff == xlim || yoff == ylim)
+		return;
+
+	split(d, xoff, xlim, yoff, ylim, &xmid, &ymid);
+	/* A split that gave up may land on a corner, which would not make
+	 * the problem any smaller.
+	 */
+	if ((xmid == xoff && ymid == yoff) || (xmid == xlim && ymid == ylim)) {
+		xmid = xoff + (xlim - xoff) / 2;
+		ymid = yoff + (ylim - yoff) / 2;
+	}
+	compare(d, xoff, xmid, yoff, ymid);
+	compare(d, xmid, xlim, ymid, ylim);
+}
+
+/* Occurrences of one instruction encoding in a and b. */
+struct slot {
+	int a, b;		/* index of the last occurrence */
+	int na, nb;
+};
+
+static unsigned int hash(const uint32_t *inst)
+{
+	unsigned int h = inst[0] * 0x9e3779b1u ^ inst[1] * 0x85ebca6bu ^
+		inst[2] * 0xc2b2ae35u ^ inst[3] * 0x27d4eb2fu;
+
+	return h ^ h >> 15;
+}
+
+static struct slot *lookup(struct slot *table, unsigned int mask,
+			   struct diff *d, const uint32_t *inst)
+{
+	unsigned int i;
+
+	for (i = hash(inst) & mask; table[i].na || table[i].nb;
+	     i = (i + 1) & mask) {
+		const uint32_t *other = table[i].na ?
+			d->a + table[i].a * WORDS : d->b + table[i].b * WORDS;
+
+		if (memcmp(other, inst, INST_SIZE) == 0)
+			break;
+	}
+	return &table[i];
+}
+
+/*
+ * Matches the instructions that are unique in both streams and in the
+ * same order in both, storing the pairs in ax and bx.  Returns how many.
+ */
+static int unique_anchors(struct diff *d, int na, int nb, int *ax, int *bx)
+{
+	unsigned int size = 64, mask;
+	struct slot *table, *s;
+	int *tails, *prev, *pa, *pb;
+	int i, n = 0, len = 0, lo, hi, mid;
+
+	while (size < 2 * (unsigned int)(na + nb))
+		size *= 2;
+	mask = size - 1;
+	table = calloc(size, sizeof(*table));
+	for (i = 0; i < na; i++) {
+		s = lookup(table, mask, d, d->a + i * WORDS);
+		s->a = i;
+		s->na++;
+	}
+	for (i = 0; i < nb; i++) {
+		s = lookup(table, mask, d, d->b + i * WORDS);
+		s->b = i;
+		s->nb++;
+	}
+
+	pa = malloc((na + 1) * sizeof(*pa));
+	pb = malloc((na + 1) * sizeof(*pb));
+	for (i = 0; i < na; i++) {
+		s = lookup(table, mask, d, d->a + i * WORDS);
+		if (s->na == 1 && s->nb == 1) {
+			pa[n] = i;
+			pb[n++] = s->b;
+		}
+	}
+	free(table);
+
+	/* Longest increasing run of b indices, by patience sorting. */
+	tails = malloc((n + 1) * sizeof(*tails));
+	prev = malloc((n + 1) * sizeof(*prev));
+	for (i = 0; i < n; i++) {
+		lo = 0;
+		hi = len;
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (pb[tails[mid]] < pb[i])
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		prev[i] = lo ? tails[lo - 1] : -1;
+		tails[lo] = i;
+		if (lo == len)
+			len++;
+	}
+	for (i = len ? tails[len - 1] : -1, n = len; i >= 0; i = prev[i]) {
+		n--;
+		ax[n] = pa[i];
+		bx[n] = pb[i];
+	}
+
+	free(tails);
+	free(prev);
+	free(pa);
+	free(pb);
+	return len;
+}
+
+/**
+ * Aligns the na instructions of a with the nb of b, each INST_SIZE bytes
+ * and compared bit for bit.  a2b and b2a receive the index each is
+ * matched with in the other stream, or -1 for one that was deleted from
+ * a or inserted in b.
+ */
+void diff_align(const uint32_t *a, int na, const uint32_t *b, int nb,
+		int *a2b, int *b2a)
+{
+	struct diff d;
+	int *ax, *bx, *diags;
+	int i, n, x = 0, y = 0;
+	unsigned int total = na + nb + 3;
+
+	d.a = a;
+	d.b = b;
+	d.a2b = a2b;
+	d.b2a = b2a;
+	for (i = 0; i < na; i++)
+		a2b[i] = -1;
+	for (i = 0; i < nb; i++)
+		b2a[i] = -1;
+
+	diags = malloc(2 * total * sizeof(*diags));
+	d.fd = diags + nb + 1;
+	d.bd = diags + total + nb + 1;
+	d.too_expensive = 1;
+	for (; total; total >>= 2)
+		d.too_expensive <<= 1;
+	if (d.too_expensive < 256)
+		d.too_expensive = 256;
+
+	ax = malloc((na + 1) * sizeof(*ax));
+	bx = malloc((na + 1) * sizeof(*bx));
+	n = unique_anchors(&d, na, nb, ax, bx);
+	for (i = 0; i < n; i++) {
+		compare(&d, x, ax[i], y, bx[i]);
+		match(&d, ax[i], bx[i]);
+		x = ax[i] + 1;
+		y = bx[i] + 1;
+	}
+	compare(&d, x, na, y, nb);
+
+	free(ax);
+	free(bx);
+	free(diags);
+}
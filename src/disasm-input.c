@@ -0,0 +1,407 @@
+/* -*- c-basic-offset: 8 -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Reading the disassembler's input: raw instruction dumps, and the word
+ * and byte arrays the assembler writes.
+ *
+ * The hex text is parsed eight bytes at a time: memchr() finds the next
+ * '0', and the digits after "0x" are classified and converted together
+ * in a 64-bit word rather than one character at a time.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gen4asm.h"
+
+#define ONES	0x0101010101010101ULL
+#define HIGHS	0x8080808080808080ULL
+
+/* Sets the high bit of every byte of x strictly between m and n, for
+ * 0 <= m <= 127 and 0 <= n <= 128.  Bytes of 0x80 and above never match.
+ */
+#define BYTES_BETWEEN(x, m, n)						\
+	((ONES * (127 + (n)) - ((x) & ONES * 127)) & ~(x) &		\
+	 (((x) & ONES * 127) + ONES * (127 - (m))) & HIGHS)
+
+/**
+ * Maps a regular input file, or reads a pipe into memory.  *mapped is set
+ * when the returned buffer has to be unmapped rather than freed.
+ */
+char *load_input(int fd, size_t *size, int *mapped)
+{
+	struct stat st;
+	char *data = NULL;
+	size_t alloc = 0, len = 0;
+	ssize_t r;
+
+	*mapped = 0;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		*size = st.st_size;
+		if (*size == 0)
+			return NULL;
+		data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			madvise(data, *size, MADV_SEQUENTIAL);
+			*mapped = 1;
+			return data;
+		}
+		data = NULL;
+	}
+
+	for (;;) {
+		if (len == alloc) {
+			alloc = alloc ? alloc * 2 : 65536;
+			data = realloc(data, alloc);
+			if (data == NULL) {
+				perror("Couldn't read input file");
+				exit(1);
+			}
+		}
+		r = read(fd, data + len, alloc - len);
+		if (r == 0)
+			break;
+		if (r < 0) {
+			perror("Couldn't read input file");
+			exit(1);
+		}
+		len += r;
+	}
+	*size = len;
+	return data;
+}
+
+/**
+ * Instruction dumps always contain NUL or high bytes, while both text
+ * formats are plain ASCII.  The text formats are told apart by the width
+ * of their first hex number.
+ */
+enum input_format detect_input_format(const char *text, size_t size)
+{
+	const unsigned char *data = (const unsigned char *)text;
+	size_t i;
+	int digits;
+
+	for (i = 0; i < size; i++)
+		if (data[i] >= 0x80 || (data[i] < ' ' && !isspace(data[i])))
+			return INPUT_RAW;
+
+	for (i = 0; i + 2 < size; i++) {
+		if (data[i] == '0' && (data[i + 1] | 0x20) == 'x') {
+			for (digits = 0; i + 2 + digits < size &&
+				     isxdigit(data[i + 2 + digits]); digits++)
+				;
+			if (digits)
+				return digits > 2 ? INPUT_WORDS : INPUT_BYTES;
+		}
+	}
+	return INPUT_WORDS;
+}
+
+static uint64_t load_le64(const char *p)
+{
+	const unsigned char *b = (const unsigned char *)p;
+
+	return (uint64_t)b[0] | (uint64_t)b[1] << 8 |
+		(uint64_t)b[2] << 16 | (uint64_t)b[3] << 24 |
+		(uint64_t)b[4] << 32 | (uint64_t)b[5] << 40 |
+		(uint64_t)b[6] << 48 | (uint64_t)b[7] << 56;
+}
+
+/* Index of the lowest set bit of v, which must not be 0. */
+int lowest_bit(uint64_t v)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(v);
+#else
+	int n = 0;
+
+	while (!(v & 1)) {
+		v >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/* Number of hex digits the eight characters in v start with. */
+static int hex_digit_run(uint64_t v)
+{
+	uint64_t digit = BYTES_BETWEEN(v, '0' - 1, '9' + 1) |
+		BYTES_BETWEEN(v | ONES * 0x20, 'a' - 1, 'f' + 1);
+	uint64_t other = ~digit & HIGHS;
+
+	if (!other)
+		return 8;
+	return lowest_bit(other) / 8;
+}
+
+/* Value of the first n hex digits in v, 1 <= n <= 8.  The digits are
+ * moved to the top so that the bytes below read as leading zeros, turned
+ * into nibbles, and then pairs of nibbles, bytes and halfwords are merged.
+ */
+static uint32_t hex_value(uint64_t v, int n)
+{
+	v <<= (8 - n) * 8;
+	v = (v & ONES * 0x0f) + ((v & ONES * 0x40) >> 6) * 9;
+	v = ((v << 4) | (v >> 8)) & 0x00ff00ff00ff00ffULL;
+	v = ((v << 8) | (v >> 16)) & 0x0000ffff0000ffffULL;
+	return (uint32_t)((v << 16) | (v >> 32));
+}
+
+static int hex_nibble(int c)
+{
+	return isdigit(c) ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+/* Reads the hex number at p, of at most max_digits digits, and returns
+ * how many digits it has.
+ */
+static int hex_number(const char *p, const char *end, int max_digits,
+		      uint32_t *value)
+{
+	int digits = 0;
+
+	*value = 0;
+	if (end - p >= 8) {
+		uint64_t v = load_le64(p);
+
+		digits = hex_digit_run(v);
+		if (digits > max_digits)
+			digits = max_digits;
+		if (digits)
+			*value = hex_value(v, digits);
+	} else {
+		while (p + digits < end && digits < max_digits &&
+		       isxdigit((unsigned char)p[digits]))
+			*value = *value << 4 | hex_nibble(p[digits++]);
+	}
+	return digits;
+}
+
+/**
+ * Collects the 0x numbers of the text formats into a contiguous array of
+ * instructions of INST_SIZE bytes, as many words or bytes at a time as
+ * each format uses.  Anything else, such as the gen_eu_bytes[] wrapper,
+ * braces and commas, is skipped.  A trailing partial instruction is
+ * dropped.
+ */
+uint32_t *parse_hex_text(const char *data, size_t size, int bytes, int *count)
+{
+	const char *p = data, *end = data + size;
+	uint32_t *insts = NULL;
+	int alloc = 0, n = 0, part = 0;
+	int max_digits = bytes ? 2 : 8;
+	int per_inst = bytes ? INST_SIZE : INST_SIZE / 4;
+
+	while (p < end && (p = memchr(p, '0', end - p)) != NULL) {
+		uint32_t value;
+		int digits;
+
+		if (end - p < 3 || (p[1] | 0x20) != 'x') {
+			p++;
+			continue;
+		}
+		p += 2;
+		digits = hex_number(p, end, max_digits, &value);
+		if (!digits)
+			continue;
+		p += digits;
+
+		if (n == alloc) {
+			alloc = alloc ? alloc * 2 : 1024;
+			insts = realloc(insts, alloc * INST_SIZE);
+			if (insts == NULL) {
+				perror("Couldn't read input file");
+				exit(1);
+			}
+		}
+		if (bytes)
+			((uint8_t *)insts)[n * INST_SIZE + part] = value;
+		else
+			insts[n * INST_SIZE / 4 + part] = value;
+		if (++part == per_inst) {
+			part = 0;
+			n++;
+		}
+	}
+	*count = n;
+	return insts;
+}
+
+/**
+ * Decodes raw instructions where they are.  Only a big-endian host needs
+ * a byte-swapped copy.
+ */
+uint32_t *raw_instructions(char *data, size_t size, int *count)
+{
+	uint32_t *insts = (uint32_t *)data;
+	int n = size / INST_SIZE;
+
+	if (size % INST_SIZE)
+		fprintf(stderr, "WARNING: ignoring %d trailing bytes\n",
+			(int)(size % INST_SIZE));
+#ifdef WORDS_BIGENDIAN
+	{
+		int i;
+
+		insts = malloc(n * INST_SIZE);
+		for (i = 0; i < n * INST_SIZE / 4; i++) {
+			const uint8_t *b = (const uint8_t *)data + i * 4;
+
+			insts[i] = b[0] | b[1] << 8 | b[2] << 16 |
+				(uint32_t)b[3] << 24;
+		}
+	}
+#endif
+	*count = n;
+	return insts;
+}
+
+/*
+ * Streaming input.  Bytes are read into a fixed buffer and instructions
+ * are handed out as soon as they are complete, so a pipe of any length
+ * is disassembled in constant memory while it is still being written.
+ */
+
+/* Enough input to tell the formats apart, as long as the first hex number
+ * comes early, which it does in everything intel-gen4asm writes.
+ */
+#define STREAM_DETECT	256
+
+/**
+ * Reads whatever is available into the buffer, after moving the unread
+ * bytes to the front.  Returns 0 once the input has ended.
+ */
+int input_stream_fill(struct input_stream *s)
+{
+	ssize_t r;
+
+	if (s->eof)
+		return 0;
+	memmove(s->buf, s->buf + s->pos, s->len - s->pos);
+	s->len -= s->pos;
+	s->pos = 0;
+	do
+		r = read(s->fd, s->buf + s->len, sizeof(s->buf) - s->len);
+	while (r < 0 && errno == EINTR);
+	if (r < 0) {
+		perror("Couldn't read input file");
+		exit(1);
+	}
+	if (r == 0) {
+		s->eof = 1;
+		if (s->format == INPUT_RAW && s->len % INST_SIZE)
+			fprintf(stderr, "WARNING: ignoring %d trailing bytes\n",
+				(int)(s->len % INST_SIZE));
+	}
+	s->len += r;
+	return 1;
+}
+
+void input_stream_init(struct input_stream *s, int fd, enum input_format format)
+{
+	s->fd = fd;
+	s->eof = 0;
+	s->pos = 0;
+	s->len = 0;
+	s->part = 0;
+	s->format = format;
+	if (format == INPUT_AUTO) {
+		while (s->len < STREAM_DETECT && input_stream_fill(s))
+			;
+		s->format = detect_input_format(s->buf, s->len);
+	}
+}
+
+/**
+ * Returns the next instruction, or NULL when the buffer doesn't hold a
+ * complete one.  A hex number at the end of the buffer is only taken once
+ * it is followed by something else, or by the end of the input, so that
+ * one split across two reads is not cut short.  The instruction stays
+ * valid until the next call.
+ */
+struct brw_instruction *input_stream_next(struct input_stream *s)
+{
+	const char *p = s->buf + s->pos, *end = s->buf + s->len;
+	int bytes = s->format == INPUT_BYTES;
+	int max_digits = bytes ? 2 : 8;
+	int per_inst = bytes ? INST_SIZE : INST_SIZE / 4;
+
+	if (s->format == INPUT_RAW) {
+		if (end - p < INST_SIZE)
+			return NULL;
+#ifdef WORDS_BIGENDIAN
+		{
+			const uint8_t *b = (const uint8_t *)p;
+			int i;
+
+			for (i = 0; i < INST_SIZE / 4; i++, b += 4)
+				s->inst[i] = b[0] | b[1] << 8 | b[2] << 16 |
+					(uint32_t)b[3] << 24;
+		}
+#else
+		memcpy(s->inst, p, INST_SIZE);
+#endif
+		s->pos += INST_SIZE;
+		return (struct brw_instruction *)s->inst;
+	}
+
+	while (p < end && (p = memchr(p, '0', end - p)) != NULL) {
+		uint32_t value;
+		int digits;
+
+		if (end - p < 3 + max_digits && !s->eof)
+			break;
+		if (end - p < 3 || (p[1] | 0x20) != 'x') {
+			p++;
+			continue;
+		}
+		p += 2;
+		digits = hex_number(p, end, max_digits, &value);
+		if (!digits)
+			continue;
+		p += digits;
+
+		if (bytes)
+			((uint8_t *)s->inst)[s->part] = value;
+		else
+			s->inst[s->part] = value;
+		if (++s->part == per_inst) {
+			s->part = 0;
+			s->pos = p - s->buf;
+			return (struct brw_instruction *)s->inst;
+		}
+	}
+	s->pos = p ? p - s->buf : s->len;
+	return NULL;
+}
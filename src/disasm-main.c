@@ -25,98 +25,268 @@
 #include <string.h>
 #include <getopt.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
 #include "gen4asm.h"
 
+long int gen_level = 40;
+
+enum {
+    OPT_ESTIMATE = 256,
+    OPT_ESTIMATE_JSON,
+    OPT_CFG_DOT,
+    OPT_CFG_JSON,
+};
+
 static const struct option longopts[] = {
+	{"gen", required_argument, 0, 'g'},
+	{"binary", no_argument, 0, 'b'},
+	{"raw", no_argument, 0, 'r'},
+	{"jobs", required_argument, 0, 'j'},
+	{"stream", no_argument, 0, 's'},
+	{"labels", no_argument, 0, 'l'},
+	{"estimate", no_argument, 0, OPT_ESTIMATE},
+	{"estimate-json", required_argument, 0, OPT_ESTIMATE_JSON},
+	{"cfg-dot", required_argument, 0, OPT_CFG_DOT},
+	{"cfg-json", required_argument, 0, OPT_CFG_JSON},
 	{ NULL, 0, NULL, 0 }
 };
 
-static struct brw_program *
-read_program (FILE *input)
+/*
+ * Instructions are kept as their 16 encoded bytes, back to back.  The
+ * disassembler and the analyses only look at that part of a struct
+ * brw_instruction, never at the relocation fields the assembler keeps
+ * after it, so they are handed pointers into this array directly.
+ */
+static struct brw_instruction *
+inst_at (uint32_t *insts, int i)
 {
-    uint32_t			    inst[4];
-    struct brw_program		    *program;
-    struct brw_program_instruction  *entry, **prev;
-    int			c;
-    int			n = 0;
-
-    program = malloc (sizeof (struct brw_program));
-    program->first = NULL;
-    prev = &program->first;
-    while ((c = getc (input)) != EOF) {
-	if (c == '0') {
-	    if (fscanf (input, "x%x", &inst[n]) == 1) {
-		++n;
-		if (n == 4) {
-		    entry = malloc (sizeof (struct brw_program_instruction));
-		    memcpy (&entry->instruction, inst, 4 * sizeof (uint32_t));
-		    entry->next = NULL;
-		    *prev = entry;
-		    prev = &entry->next;
-		    n = 0;
-		}
-	    }
-	}
+    return (struct brw_instruction *) (insts + i * INST_SIZE / 4);
+}
+
+/*
+ * Parallel disassembly.  The program is cut into chunks of CHUNK_SIZE
+ * instructions that worker threads disassemble into buffers of their
+ * own, while the main thread writes the buffers out in order.  Workers
+ * stay at most a few chunks per thread ahead of the writer, which bounds
+ * the memory held by finished chunks.  Every instruction ends its line,
+ * so the output is the same as disassembling serially.
+ */
+#define CHUNK_SIZE	4096
+#define CHUNKS_AHEAD	4
+
+struct chunk {
+    struct disasm_output	out;
+    int				done;
+};
+
+struct disasm_pool {
+    pthread_mutex_t	lock;
+    pthread_cond_t	cond;
+    uint32_t		*insts;
+    int			n;
+    struct chunk	*chunks;
+    int			nchunks;
+    const struct disasm_labels	*labels;
+    int			next;		/* first chunk not yet taken */
+    int			written;	/* chunks written out */
+    int			window;
+};
+
+static void *
+disasm_worker (void *arg)
+{
+    struct disasm_pool	*pool = arg;
+    int			c, i, end;
+
+    for (;;) {
+	pthread_mutex_lock (&pool->lock);
+	while (pool->next < pool->nchunks &&
+	       pool->next >= pool->written + pool->window)
+	    pthread_cond_wait (&pool->cond, &pool->lock);
+	c = pool->next++;
+	pthread_mutex_unlock (&pool->lock);
+	if (c >= pool->nchunks)
+	    return NULL;
+
+	end = (c + 1) * CHUNK_SIZE < pool->n ? (c + 1) * CHUNK_SIZE : pool->n;
+	for (i = c * CHUNK_SIZE; i < end; i++)
+	    disasm_at (&pool->chunks[c].out, inst_at (pool->insts, i), i,
+		       pool->labels);
+
+	pthread_mutex_lock (&pool->lock);
+	pool->chunks[c].done = 1;
+	pthread_cond_broadcast (&pool->cond);
+	pthread_mutex_unlock (&pool->lock);
     }
-    return program;
 }
 
-static struct brw_program *
-read_program_binary (FILE *input)
+static void
+disasm_parallel (FILE *output, uint32_t *insts, int n, int jobs,
+		 const struct disasm_labels *labels)
 {
-    uint32_t			    temp;
-    uint8_t			    inst[16];
-    struct brw_program		    *program;
-    struct brw_program_instruction  *entry, **prev;
-    int			c;
-    int			n = 0;
-
-    program = malloc (sizeof (struct brw_program));
-    program->first = NULL;
-    prev = &program->first;
-    while ((c = getc (input)) != EOF) {
-	if (c == '0') {
-	    if (fscanf (input, "x%2x", &temp) == 1) {
-		inst[n++] = (uint8_t)temp;
-		if (n == 16) {
-		    entry = malloc (sizeof (struct brw_program_instruction));
-		    memcpy (&entry->instruction, inst, 16 * sizeof (uint8_t));
-		    entry->next = NULL;
-		    *prev = entry;
-		    prev = &entry->next;
-		    n = 0;
-		}
-	    }
+    struct disasm_pool	pool;
+    pthread_t		*threads;
+    int			c, t;
+
+    pool.insts = insts;
+    pool.n = n;
+    pool.labels = labels;
+    pool.nchunks = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    pool.chunks = calloc (pool.nchunks, sizeof (*pool.chunks));
+    pool.next = 0;
+    pool.written = 0;
+    pool.window = jobs * CHUNKS_AHEAD;
+    pthread_mutex_init (&pool.lock, NULL);
+    pthread_cond_init (&pool.cond, NULL);
+    for (c = 0; c < pool.nchunks; c++)
+	disasm_output_init (&pool.chunks[c].out, NULL);
+
+    threads = calloc (jobs, sizeof (*threads));
+    for (t = 0; t < jobs; t++) {
+	if (pthread_create (&threads[t], NULL, disasm_worker, &pool) != 0) {
+	    perror ("Couldn't start disassembly thread");
+	    exit (1);
 	}
     }
-    return program;
+
+    for (c = 0; c < pool.nchunks; c++) {
+	struct disasm_output *out = &pool.chunks[c].out;
+
+	pthread_mutex_lock (&pool.lock);
+	while (!pool.chunks[c].done)
+	    pthread_cond_wait (&pool.cond, &pool.lock);
+	pthread_mutex_unlock (&pool.lock);
+
+	fwrite (out->buf, 1, out->len, output);
+	disasm_output_fini (out);
+
+	pthread_mutex_lock (&pool.lock);
+	pool.written++;
+	pthread_cond_broadcast (&pool.cond);
+	pthread_mutex_unlock (&pool.lock);
+    }
+
+    for (t = 0; t < jobs; t++)
+	pthread_join (threads[t], NULL);
+    pthread_cond_destroy (&pool.cond);
+    pthread_mutex_destroy (&pool.lock);
+    free (threads);
+    free (pool.chunks);
+}
+
+/*
+ * Streaming disassembly.  Each instruction is printed as soon as it has
+ * been read, and the output is flushed whenever the input runs dry, so
+ * that a pipe can be watched live.
+ */
+static void
+disasm_stream (FILE *output, int input, enum input_format format)
+{
+    struct input_stream		*in = malloc (sizeof (*in));
+    struct disasm_output	out;
+    struct brw_instruction	*inst;
+
+    if (in == NULL) {
+	perror ("Couldn't allocate input buffer");
+	exit (1);
+    }
+    input_stream_init (in, input, format);
+    disasm_output_init (&out, output);
+    do {
+	while ((inst = input_stream_next (in)) != NULL)
+	    disasm_to (&out, inst);
+	disasm_output_flush (&out);
+	fflush (output);
+    } while (input_stream_fill (in));
+    disasm_output_fini (&out);
+    free (in);
 }
 
 static void usage(void)
 {
-    fprintf(stderr, "usage: intel-gen4disasm [-o outputfile] [-b] inputfile\n");
+    fprintf(stderr, "usage: intel-gen4disasm [-o outputfile] [-b | -r] [-j n | -s] [-l] [-g <4|5|6|7>] inputfile\n");
+    fprintf(stderr, "\t-b, --binary                         Read the byte array written by intel-gen4asm -b\n");
+    fprintf(stderr, "\t-r, --raw                            Read raw little-endian instructions\n");
+    fprintf(stderr, "\t    The input format is detected when neither is given\n");
+    fprintf(stderr, "\t-j, --jobs {n}                       Disassemble on n threads, 0 for one per CPU\n");
+    fprintf(stderr, "\t-s, --stream                         Print each instruction as soon as it is read\n");
+    fprintf(stderr, "\t-l, --labels                         Write branch targets as labels, for reassembly\n");
+    fprintf(stderr, "\t    --estimate                       Print estimated cycles per block to stderr\n");
+    fprintf(stderr, "\t    --estimate-json {file}           Write the cycle estimate as JSON\n");
+    fprintf(stderr, "\t    --cfg-dot {file}                 Write the control flow graph as DOT\n");
+    fprintf(stderr, "\t    --cfg-json {file}                Write the control flow graph as JSON\n");
 }
 
 int main(int argc, char **argv)
 {
-    struct brw_program	*program;
-    FILE		*input = stdin;
+    uint32_t		*insts = NULL;
+    struct disasm_output	out;
+    int			n = 0, i;
+    int			input = STDIN_FILENO;
     FILE		*output = stdout;
+    char		*data;
+    size_t		size;
+    int			mapped;
     char		*input_filename = NULL;
     char		*output_file = NULL;
-    int			byte_array_input = 0;
+    enum input_format	format = INPUT_AUTO;
     int			o;
-    struct brw_program_instruction  *inst;
+    int			jobs = 1;
+    int			stream = 0;
+    int			labeled = 0;
+    struct disasm_labels	labels;
+    struct brw_instruction	**list = NULL;
+    int			estimate = 0;
+    char		*estimate_json = NULL;
+    char		*cfg_dot = NULL;
+    char		*cfg_json = NULL;
 
-    while ((o = getopt_long(argc, argv, "o:b", longopts, NULL)) != -1) {
+    while ((o = getopt_long(argc, argv, "o:brj:slg:", longopts, NULL)) != -1) {
 	switch (o) {
 	case 'o':
 	    if (strcmp(optarg, "-") != 0)
 		output_file = optarg;
 	    break;
 	case 'b':
-	    byte_array_input = 1;
+	    format = INPUT_BYTES;
+	    break;
+	case 'r':
+	    format = INPUT_RAW;
+	    break;
+	case 'j':
+	    jobs = atoi(optarg);
+	    if (jobs <= 0)
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	    if (jobs <= 0)
+		jobs = 1;
+	    break;
+	case 's':
+	    stream = 1;
+	    break;
+	case 'l':
+	    labeled = 1;
+	    break;
+	case 'g':
+	    gen_level = parse_gen_level(optarg);
+	    if (gen_level < 0) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case OPT_ESTIMATE:
+	    estimate = 1;
+	    break;
+	case OPT_ESTIMATE_JSON:
+	    estimate_json = optarg;
+	    break;
+	case OPT_CFG_DOT:
+	    cfg_dot = optarg;
+	    break;
+	case OPT_CFG_JSON:
+	    cfg_json = optarg;
 	    break;
 	default:
 	    usage();
@@ -132,18 +302,18 @@ int main(int argc, char **argv)
 
     if (strcmp(argv[0], "-") != 0) {
 	input_filename = argv[0];
-	input = fopen(input_filename, "r");
-	if (input == NULL) {
+	input = open(input_filename, O_RDONLY);
+	if (input < 0) {
 	    perror("Couldn't open input file");
 	    exit(1);
 	}
     }
-    if (byte_array_input)
-	program = read_program_binary (input);
-    else
-	program = read_program (input);
-    if (!program)
-	exit (1);
+    if (stream && (jobs > 1 || labeled || estimate || estimate_json ||
+		   cfg_dot || cfg_json)) {
+	fprintf(stderr, "--stream can't be used with -j, --labels or the "
+		"reports, which need the whole program\n");
+	exit(1);
+    }
     if (output_file) {
 	output = fopen (output_file, "w");
 	if (output == NULL) {
@@ -151,8 +321,74 @@ int main(int argc, char **argv)
 	    exit(1);
 	}
     }
-	    
-    for (inst = program->first; inst; inst = inst->next)
-	disasm (output, &inst->instruction);
+    /* Builds the decode table for gen_level before any thread uses it. */
+    opcode_desc (BRW_OPCODE_NOP);
+    if (stream) {
+	disasm_stream (output, input, format);
+	exit (0);
+    }
+
+    data = load_input (input, &size, &mapped);
+    if (format == INPUT_AUTO)
+	format = detect_input_format (data, size);
+    if (format == INPUT_RAW)
+	insts = raw_instructions (data, size, &n);
+    else
+	insts = parse_hex_text (data, size, format == INPUT_BYTES, &n);
+
+    if (labeled || estimate || estimate_json || cfg_dot || cfg_json) {
+	list = malloc((n + 1) * sizeof(*list));
+	for (i = 0; i < n; i++)
+	    list[i] = inst_at (insts, i);
+    }
+    if (labeled)
+	disasm_find_labels (&labels, list, n);
+
+    if (jobs > 1 && n > CHUNK_SIZE) {
+	disasm_parallel (output, insts, n, jobs, labeled ? &labels : NULL);
+	if (labeled) {
+	    disasm_output_init (&out, output);
+	    disasm_label (&out, n, &labels);
+	    disasm_output_fini (&out);
+	}
+    } else {
+	disasm_output_init (&out, output);
+	for (i = 0; i < n; i++)
+	    disasm_at (&out, inst_at (insts, i), i, labeled ? &labels : NULL);
+	if (labeled)
+	    disasm_label (&out, n, &labels);
+	disasm_output_fini (&out);
+    }
+
+    if (estimate)
+	estimate_cycles(stderr, list, n, 0);
+    if (estimate_json) {
+	FILE *f = open_report(estimate_json);
+
+	estimate_cycles(f, list, n, 1);
+	close_report(f);
+    }
+    if (cfg_dot) {
+	FILE *f = open_report(cfg_dot);
+
+	write_cfg(f, list, n, 0);
+	close_report(f);
+    }
+    if (cfg_json) {
+	FILE *f = open_report(cfg_json);
+
+	write_cfg(f, list, n, 1);
+	close_report(f);
+    }
+    if (labeled)
+	disasm_labels_fini (&labels);
+    free(list);
+
+    if (format != INPUT_RAW || (char *) insts != data)
+	free (insts);
+    if (mapped)
+	munmap (data, size);
+    else
+	free (data);
     exit (0);
 }
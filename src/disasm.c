@@ -30,64 +30,6 @@
 #include "gen4asm.h"
 #include "brw_defines.h"
 
-struct {
-    char    *name;
-    int	    nsrc;
-    int	    ndst;
-} opcode[128] = {
-    [BRW_OPCODE_MOV] = { .name = "mov", .nsrc = 1, .ndst = 1 },
-    [BRW_OPCODE_FRC] = { .name = "frc", .nsrc = 1, .ndst = 1 },
-    [BRW_OPCODE_RNDU] = { .name = "rndu", .nsrc = 1, .ndst = 1 },
-    [BRW_OPCODE_RNDD] = { .name = "rndd", .nsrc = 1, .ndst = 1 },
-    [BRW_OPCODE_RNDE] = { .name = "rnde", .nsrc = 1, .ndst = 1 },
-    [BRW_OPCODE_RNDZ] = { .name = "rndz", .nsrc = 1, .ndst = 1 },
-    [BRW_OPCODE_NOT] = { .name = "not", .nsrc = 1, .ndst = 1 },
-    [BRW_OPCODE_LZD] = { .name = "lzd", .nsrc = 1, .ndst = 1 },
-
-    [BRW_OPCODE_MUL] = { .name = "mul", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_MAC] = { .name = "mac", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_MACH] = { .name = "mach", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_LINE] = { .name = "line", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_SAD2] = { .name = "sad2", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_SADA2] = { .name = "sada2", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_DP4] = { .name = "dp4", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_DPH] = { .name = "dph", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_DP3] = { .name = "dp3", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_DP2] = { .name = "dp2", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_PLN] = { .name = "pln", .nsrc = 2, .ndst = 1},
-
-    [BRW_OPCODE_AVG] = { .name = "avg", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_ADD] = { .name = "add", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_SEL] = { .name = "sel", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_AND] = { .name = "and", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_OR] = { .name = "or", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_XOR] = { .name = "xor", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_SHR] = { .name = "shr", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_SHL] = { .name = "shl", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_ASR] = { .name = "asr", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_CMP] = { .name = "cmp", .nsrc = 2, .ndst = 1 },
-    [BRW_OPCODE_CMPN] = { .name = "cmpn", .nsrc = 2, .ndst = 1 },
-
-    [BRW_OPCODE_SEND] = { .name = "send", .nsrc = 1, .ndst = 1 },
-    [BRW_OPCODE_SENDC] = { .name = "sendc", .nsrc = 1, .ndst = 1 },
-    [BRW_OPCODE_NOP] = { .name = "nop", .nsrc = 0, .ndst = 0 },
-    [BRW_OPCODE_JMPI] = { .name = "jmpi", .nsrc = 1, .ndst = 0 },
-    [BRW_OPCODE_IF] = { .name = "if", .nsrc = 2, .ndst = 0 },
-    [BRW_OPCODE_IFF] = { .name = "iff", .nsrc = 1, .ndst = 01 },
-    [BRW_OPCODE_WHILE] = { .name = "while", .nsrc = 1, .ndst = 0 },
-    [BRW_OPCODE_ELSE] = { .name = "else", .nsrc = 2, .ndst = 0 },
-    [BRW_OPCODE_BREAK] = { .name = "break", .nsrc = 1, .ndst = 0 },
-    [BRW_OPCODE_CONTINUE] = { .name = "cont", .nsrc = 1, .ndst = 0 },
-    [BRW_OPCODE_HALT] = { .name = "halt", .nsrc = 1, .ndst = 0 },
-    [BRW_OPCODE_MSAVE] = { .name = "msave", .nsrc = 1, .ndst = 1 },
-    [BRW_OPCODE_PUSH] = { .name = "push", .nsrc = 1, .ndst = 1 },
-    [BRW_OPCODE_MRESTORE] = { .name = "mrest", .nsrc = 1, .ndst = 1 },
-    [BRW_OPCODE_POP] = { .name = "pop", .nsrc = 2, .ndst = 0 },
-    [BRW_OPCODE_WAIT] = { .name = "wait", .nsrc = 1, .ndst = 0 },
-    [BRW_OPCODE_DO] = { .name = "do", .nsrc = 0, .ndst = 0 },
-    [BRW_OPCODE_ENDIF] = { .name = "endif", .nsrc = 2, .ndst = 0 },
-};
-
 char *conditional_modifier[16] = {
     [BRW_CONDITIONAL_NONE] = "",
     [BRW_CONDITIONAL_Z] = ".e",
@@ -197,6 +139,7 @@ char *pred_ctrl_align1[16] = {
 
 char *thread_ctrl[4] = {
     [0] = "",
+    [1] = "atomic",
     [2] = "switch"
 };
 
@@ -274,17 +217,6 @@ char *end_of_thread[2] = {
     [1] = "EOT"
 };
 
-char *target_function[16] = {
-    [BRW_MESSAGE_TARGET_NULL] = "null",
-    [BRW_MESSAGE_TARGET_MATH] = "math",
-    [BRW_MESSAGE_TARGET_SAMPLER] = "sampler",
-    [BRW_MESSAGE_TARGET_GATEWAY] = "gateway",
-    [BRW_MESSAGE_TARGET_DATAPORT_READ] = "read",
-    [BRW_MESSAGE_TARGET_DATAPORT_WRITE] = "write",
-    [BRW_MESSAGE_TARGET_URB] = "urb",
-    [BRW_MESSAGE_TARGET_THREAD_SPAWNER] = "thread_spawner"
-};
-
 char *math_function[16] = {
     [BRW_MATH_FUNCTION_INV] = "inv",
     [BRW_MATH_FUNCTION_LOG] = "log",
@@ -297,8 +229,8 @@ char *math_function[16] = {
     [BRW_MATH_FUNCTION_TAN] = "tan",
     [BRW_MATH_FUNCTION_POW] = "pow",
     [BRW_MATH_FUNCTION_INT_DIV_QUOTIENT_AND_REMAINDER] = "intdivmod",
-    [BRW_MATH_FUNCTION_INT_DIV_QUOTIENT] = "intmod",
-    [BRW_MATH_FUNCTION_INT_DIV_REMAINDER] = "intdiv",
+    [BRW_MATH_FUNCTION_INT_DIV_QUOTIENT] = "intdiv",
+    [BRW_MATH_FUNCTION_INT_DIV_REMAINDER] = "intmod",
 };
 
 char *math_saturate[2] = {
@@ -348,115 +280,361 @@ char *sampler_target_format[4] = {
     [3] = "D"
 };
 
+char *sampler_simd_mode[4] = {
+    [BRW_SAMPLER_SIMD_MODE_SIMD4X2] = "simd4x2",
+    [BRW_SAMPLER_SIMD_MODE_SIMD8] = "simd8",
+    [BRW_SAMPLER_SIMD_MODE_SIMD16] = "simd16",
+    [BRW_SAMPLER_SIMD_MODE_SIMD32_64] = "simd32"
+};
+
+
+/*
+ * Output is built in a struct disasm_output.  One with a file is written
+ * out a block at a time; one without keeps growing, for the caller to
+ * write out itself.  The column it tracks is only used for padding
+ * between operands.
+ */
+#define DISASM_OUTPUT_BLOCK	65536
+
+void disasm_output_init (struct disasm_output *out, FILE *file)
+{
+    out->file = file;
+    out->buf = NULL;
+    out->size = 0;
+    out->len = 0;
+    out->column = 0;
+}
+
+void disasm_output_flush (struct disasm_output *out)
+{
+    if (out->len && out->file)
+	fwrite (out->buf, 1, out->len, out->file);
+    out->len = 0;
+}
 
-static int column;
+void disasm_output_fini (struct disasm_output *out)
+{
+    disasm_output_flush (out);
+    free (out->buf);
+    out->buf = NULL;
+    out->size = 0;
+}
+
+/* Makes room for n more bytes. */
+static char *reserve (struct disasm_output *out, int n)
+{
+    if (out->len + n > out->size && out->file)
+	disasm_output_flush (out);
+    if (out->len + n > out->size) {
+	out->size = out->size ? out->size * 2 : DISASM_OUTPUT_BLOCK;
+	if (out->size < out->len + n)
+	    out->size = out->len + n;
+	out->buf = realloc (out->buf, out->size);
+	if (out->buf == NULL) {
+	    perror ("Couldn't allocate disassembly");
+	    exit (1);
+	}
+    }
+    return out->buf + out->len;
+}
 
-static int string (FILE *file, char *string)
+static void append (struct disasm_output *out, const char *s, int n)
 {
-    fputs (string, file);
-    column += strlen (string);
+    memcpy (reserve (out, n), s, n);
+    out->len += n;
+    out->column += n;
+}
+
+static int string (struct disasm_output *out, char *string)
+{
+    append (out, string, strlen (string));
     return 0;
 }
 
-static int format (FILE *f, char *format, ...)
+static void decimal (struct disasm_output *out, int value)
 {
-    char    buf[1024];
-    va_list	args;
+    char	digits[12], *p = digits + sizeof (digits);
+    unsigned	v = value < 0 ? -(unsigned) value : (unsigned) value;
+
+    do
+	*--p = '0' + v % 10;
+    while (v /= 10);
+    if (value < 0)
+	*--p = '-';
+    append (out, p, digits + sizeof (digits) - p);
+}
+
+static void hex (struct disasm_output *out, unsigned value, int width)
+{
+    static const char	xdigit[] = "0123456789abcdef";
+    char		digits[8], *p = digits + sizeof (digits);
+
+    do {
+	*--p = xdigit[value & 0xf];
+	value >>= 4;
+	width--;
+    } while (value || width > 0);
+    append (out, p, digits + sizeof (digits) - p);
+}
+
+/*
+ * Handles the %d, %s and %0Nx conversions used here directly, and the
+ * rest through vsnprintf.  Room for the whole result is made first, so
+ * that a vsnprintf fallback can start over at the same place.
+ */
+static int format (struct disasm_output *out, char *format, ...)
+{
+    va_list	args, copy;
+    int		len, column = out->column;
+    char	*f;
+
+    reserve (out, 1024);
+    len = out->len;
     va_start (args, format);
+    va_copy (copy, args);
+    for (f = format; *f; f++) {
+	int width = 0;
+
+	if (*f != '%') {
+	    int n = strcspn (f, "%");
+
+	    append (out, f, n);
+	    f += n - 1;
+	    continue;
+	}
+	if (f[1] == '0' && f[2] >= '1' && f[2] <= '8' && f[3] == 'x') {
+	    width = f[2] - '0';
+	    f += 2;
+	}
+	switch (*++f) {
+	case 'd':
+	    decimal (out, va_arg (args, int));
+	    continue;
+	case 's':
+	    string (out, va_arg (args, char *));
+	    continue;
+	case 'x':
+	    hex (out, va_arg (args, unsigned), width);
+	    continue;
+	}
 
-    vsnprintf (buf, sizeof (buf) - 1, format, args);
-    string (f, buf);
+	out->len = len;
+	out->column = column;
+	len = vsnprintf (out->buf + out->len, 1023, format, copy);
+	if (len > 1022)
+	    len = 1022;
+	out->len += len;
+	out->column += len;
+	break;
+    }
+    va_end (copy);
+    va_end (args);
     return 0;
 }
 
-static int newline (FILE *f)
+static int newline (struct disasm_output *out)
 {
-    putc ('\n', f);
-    column = 0;
+    append (out, "\n", 1);
+    out->column = 0;
     return 0;
 }
 
-static int pad (FILE *f, int c)
+static int pad (struct disasm_output *out, int c)
 {
-    do
-	string (f, " ");
-    while (column < c);
+    int n = out->column < c ? c - out->column : 1;
+
+    memset (reserve (out, n), ' ', n);
+    out->len += n;
+    out->column += n;
     return 0;
 }
 
-static int control (FILE *file, char *name, char *ctrl[], GLuint id, int *space)
+static int control (struct disasm_output *out, char *name, char *ctrl[], GLuint id, int *space)
 {
     if (!ctrl[id]) {
-	fprintf (file, "*** invalid %s value %d ",
-		 name, id);
+	int column = out->column;
+
+	/* Not counted, so that the next operand is padded to where it
+	 * would have been. */
+	format (out, "*** invalid %s value %d ",
+		name, id);
+	out->column = column;
 	return 1;
     }
     if (ctrl[id][0])
     {
 	if (space && *space)
-	    string (file, " ");
-	string (file, ctrl[id]);
+	    string (out, " ");
+	string (out, ctrl[id]);
 	if (space)
 	    *space = 1;
     }
     return 0;
 }
 
-static int print_opcode (FILE *file, int id)
+static int print_opcode (struct disasm_output *out,
+			 const struct opcode_desc *desc, int id)
 {
-    if (!opcode[id].name) {
-	format (file, "*** invalid opcode value %d ", id);
+    if (!desc) {
+	format (out, "*** invalid opcode value %d ", id);
 	return 1;
     }
-    string (file, opcode[id].name);
+    string (out, (char *) desc->name);
     return 0;
 }
 
-static int reg (FILE *file, GLuint _reg_file, GLuint _reg_nr)
+static int print_target (struct disasm_output *out, GLuint target)
+{
+    const char *name = send_target_name (target);
+    int column = out->column;
+
+    if (!name) {
+	/* Not counted, as for control (). */
+	format (out, "*** invalid target function value %d ", target);
+	out->column = column;
+	return 1;
+    }
+    string (out, (char *) name);
+    return 0;
+}
+
+/*
+ * Labels.  disasm_find_labels () numbers the instructions that branches
+ * land on in program order, and disasm_at () prints them as "L<n>:"
+ * lines and in place of the distances of the branches that reach them,
+ * which the assembler turns back into the same distances.  Without a
+ * label table, the distances are still written the way the assembler
+ * takes them, so that a single instruction can be reassembled.
+ */
+void disasm_find_labels (struct disasm_labels *labels,
+			 struct brw_instruction **insts, int n)
+{
+    int targets[INST_MAX_TARGETS];
+    int i, j, count, next = 0;
+
+    labels->n = n;
+    labels->label = calloc (n + 1, sizeof (*labels->label));
+    for (i = 0; i < n; i++) {
+	count = instruction_branch_targets (insts[i], i, targets);
+	for (j = 0; j < count; j++)
+	    if (targets[j] >= 0 && targets[j] <= n)
+		labels->label[targets[j]] = 1;
+    }
+    for (i = 0; i <= n; i++)
+	labels->label[i] = labels->label[i] ? next++ : -1;
+}
+
+void disasm_labels_fini (struct disasm_labels *labels)
+{
+    free (labels->label);
+    labels->label = NULL;
+}
+
+void disasm_label (struct disasm_output *out, int ip,
+		   const struct disasm_labels *labels)
+{
+    if (labels && labels->label && labels->label[ip] >= 0) {
+	format (out, "L%d:", labels->label[ip]);
+	newline (out);
+    }
+}
+
+/* A branch distance, written as the label ip + distance has if any. */
+static void location (struct disasm_output *out, int ip, int distance,
+		      const struct disasm_labels *labels)
+{
+    int target = ip + distance;
+
+    if (labels && labels->label && target >= 0 && target <= labels->n &&
+	labels->label[target] >= 0)
+	format (out, "L%d", labels->label[target]);
+    else
+	format (out, "%d", distance);
+}
+
+/* Gen6+ branches: the JIP and, for some, the UIP, in instructions. */
+static int branch_offsets (struct disasm_output *out,
+			   const struct opcode_desc *desc,
+			   struct brw_instruction *inst, int ip,
+			   const struct disasm_labels *labels)
+{
+    int jip, uip, column = desc->ndst ? 32 : 16;
+
+    instruction_branch_offsets (inst, &jip, &uip);
+    pad (out, column);
+    location (out, ip, jip, labels);
+    if (desc->noffsets > 1) {
+	pad (out, column + 16);
+	location (out, ip, uip, labels);
+    }
+    return 0;
+}
+
+/*
+ * JMPI, and IF, ELSE and WHILE before Gen6, keep their distance in src1,
+ * with the IP for the other operands.  The assembler only takes the
+ * distance, which for JMPI it counts from the JMPI rather than from the
+ * next instruction.
+ */
+static int offset_in_src1 (struct brw_instruction *inst)
+{
+    switch (inst->header.opcode) {
+    case BRW_OPCODE_JMPI:
+	return inst->bits1.da1.src1_reg_file == BRW_IMMEDIATE_VALUE;
+    case BRW_OPCODE_IF:
+    case BRW_OPCODE_ELSE:
+    case BRW_OPCODE_WHILE:
+	return !IS_GENp(6);
+    default:
+	return 0;
+    }
+}
+
+static int reg (struct disasm_output *out, GLuint _reg_file, GLuint _reg_nr)
 {
     int	err = 0;
     if (_reg_file == BRW_ARCHITECTURE_REGISTER_FILE) {
 	switch (_reg_nr & 0xf0) {
 	case BRW_ARF_NULL:
-	    string (file, "null");
+	    string (out, "null");
 	    return -1;
 	case BRW_ARF_ADDRESS:
-	    format (file, "a%d", _reg_nr & 0x0f);
+	    format (out, "a%d", _reg_nr & 0x0f);
 	    break;
 	case BRW_ARF_ACCUMULATOR:
-	    format (file, "acc%d", _reg_nr & 0x0f);
+	    format (out, "acc%d", _reg_nr & 0x0f);
 	    break;
 	case BRW_ARF_MASK:
-	    format (file, "mask%d", _reg_nr & 0x0f);
+	    format (out, "mask%d", _reg_nr & 0x0f);
 	    break;
 	case BRW_ARF_MASK_STACK:
-	    format (file, "msd%d", _reg_nr & 0x0f);
+	    format (out, "msd%d", _reg_nr & 0x0f);
 	    break;
 	case BRW_ARF_STATE:
-	    format (file, "sr%d", _reg_nr & 0x0f);
+	    format (out, "sr%d", _reg_nr & 0x0f);
 	    break;
 	case BRW_ARF_CONTROL:
-	    format (file, "cr%d", _reg_nr & 0x0f);
+	    format (out, "cr%d", _reg_nr & 0x0f);
 	    break;
 	case BRW_ARF_NOTIFICATION_COUNT:
-	    format (file, "n%d", _reg_nr & 0x0f);
+	    format (out, "n%d", _reg_nr & 0x0f);
 	    break;
 	case BRW_ARF_IP:
-	    string (file, "ip");
+	    string (out, "ip");
 	    return -1;
 	    break;
 	default:
-	    format (file, "ARF%d", _reg_nr);
+	    format (out, "ARF%d", _reg_nr);
 	    break;
 	}
     } else {
-	err  |= control (file, "src reg file", reg_file, _reg_file, NULL);
-	format (file, "%d", _reg_nr);
+	err  |= control (out, "src reg file", reg_file, _reg_file, NULL);
+	format (out, "%d", _reg_nr);
     }
     return err;
 }
 
-static int dest (FILE *file, struct brw_instruction *inst)
+static int dest (struct disasm_output *out, struct brw_instruction *inst)
 {
     int	err = 0;
 
@@ -464,82 +642,82 @@ static int dest (FILE *file, struct brw_instruction *inst)
     {
 	if (inst->bits1.da1.dest_address_mode == BRW_ADDRESS_DIRECT)
 	{
-	    err |= reg (file, inst->bits1.da1.dest_reg_file, inst->bits1.da1.dest_reg_nr);
+	    err |= reg (out, inst->bits1.da1.dest_reg_file, inst->bits1.da1.dest_reg_nr);
 	    if (err == -1)
 		return 0;
 	    if (inst->bits1.da1.dest_subreg_nr)
-		format (file, ".%d", inst->bits1.da1.dest_subreg_nr);
-	    format (file, "<%d>", inst->bits1.da1.dest_horiz_stride);
-	    err |= control (file, "dest reg encoding", reg_encoding, inst->bits1.da1.dest_reg_type, NULL);
+		format (out, ".%d", inst->bits1.da1.dest_subreg_nr);
+	    format (out, "<%d>", inst->bits1.da1.dest_horiz_stride);
+	    err |= control (out, "dest reg encoding", reg_encoding, inst->bits1.da1.dest_reg_type, NULL);
 	}
 	else
 	{
-	    string (file, "g[a0");
+	    string (out, "g[a0");
 	    if (inst->bits1.ia1.dest_subreg_nr)
-		format (file, ".%d", inst->bits1.ia1.dest_subreg_nr);
+		format (out, ".%d", inst->bits1.ia1.dest_subreg_nr);
 	    if (inst->bits1.ia1.dest_indirect_offset)
-		format (file, " %d", inst->bits1.ia1.dest_indirect_offset);
-	    string (file, "]");
-	    format (file, "<%d>", inst->bits1.ia1.dest_horiz_stride);
-	    err |= control (file, "dest reg encoding", reg_encoding, inst->bits1.ia1.dest_reg_type, NULL);
+		format (out, " %d", inst->bits1.ia1.dest_indirect_offset);
+	    string (out, "]");
+	    format (out, "<%d>", inst->bits1.ia1.dest_horiz_stride);
+	    err |= control (out, "dest reg encoding", reg_encoding, inst->bits1.ia1.dest_reg_type, NULL);
 	}
     }
     else
     {
 	if (inst->bits1.da16.dest_address_mode == BRW_ADDRESS_DIRECT)
 	{
-	    err |= reg (file, inst->bits1.da16.dest_reg_file, inst->bits1.da16.dest_reg_nr);
+	    err |= reg (out, inst->bits1.da16.dest_reg_file, inst->bits1.da16.dest_reg_nr);
 	    if (err == -1)
 		return 0;
 	    if (inst->bits1.da16.dest_subreg_nr)
-		format (file, ".%d", inst->bits1.da16.dest_subreg_nr);
-	    string (file, "<1>");
-	    err |= control (file, "writemask", writemask, inst->bits1.da16.dest_writemask, NULL);
-	    err |= control (file, "dest reg encoding", reg_encoding, inst->bits1.da16.dest_reg_type, NULL);
+		format (out, ".%d", inst->bits1.da16.dest_subreg_nr);
+	    string (out, "<1>");
+	    err |= control (out, "writemask", writemask, inst->bits1.da16.dest_writemask, NULL);
+	    err |= control (out, "dest reg encoding", reg_encoding, inst->bits1.da16.dest_reg_type, NULL);
 	}
 	else
 	{
 	    err = 1;
-	    string (file, "Indirect align16 address mode not supported");
+	    string (out, "Indirect align16 address mode not supported");
 	}
     }
 
     return 0;
 }
 
-static int src_align1_region (FILE *file,
+static int src_align1_region (struct disasm_output *out,
 			      GLuint _vert_stride, GLuint _width, GLuint _horiz_stride)
 {
     int err = 0;
-    string (file, "<");
-    err |= control (file, "vert stride", vert_stride, _vert_stride, NULL);
-    string (file, ",");
-    err |= control (file, "width", width, _width, NULL);
-    string (file, ",");
-    err |= control (file, "horiz_stride", horiz_stride, _horiz_stride, NULL);
-    string (file, ">");
+    string (out, "<");
+    err |= control (out, "vert stride", vert_stride, _vert_stride, NULL);
+    string (out, ",");
+    err |= control (out, "width", width, _width, NULL);
+    string (out, ",");
+    err |= control (out, "horiz_stride", horiz_stride, _horiz_stride, NULL);
+    string (out, ">");
     return err;
 }
 
-static int src_da1 (FILE *file, GLuint type, GLuint _reg_file,
+static int src_da1 (struct disasm_output *out, GLuint type, GLuint _reg_file,
 		    GLuint _vert_stride, GLuint _width, GLuint _horiz_stride,
 		    GLuint reg_num, GLuint sub_reg_num, GLuint __abs, GLuint _negate)
 {
     int err = 0;
-    err |= control (file, "negate", negate, _negate, NULL);
-    err |= control (file, "abs", _abs, __abs, NULL);
+    err |= control (out, "negate", negate, _negate, NULL);
+    err |= control (out, "abs", _abs, __abs, NULL);
 
-    err |= reg (file, _reg_file, reg_num);
+    err |= reg (out, _reg_file, reg_num);
     if (err == -1)
 	return 0;
     if (sub_reg_num)
-	format (file, ".%d", sub_reg_num);
-    src_align1_region (file, _vert_stride, _width, _horiz_stride);
-    err |= control (file, "src reg encoding", reg_encoding, type, NULL);
+	format (out, ".%d", sub_reg_num);
+    src_align1_region (out, _vert_stride, _width, _horiz_stride);
+    err |= control (out, "src reg encoding", reg_encoding, type, NULL);
     return err;
 }
 
-static int src_ia1 (FILE *file,
+static int src_ia1 (struct disasm_output *out,
 		    GLuint type,
 		    GLuint _reg_file,
 		    GLint _addr_imm,
@@ -552,21 +730,21 @@ static int src_ia1 (FILE *file,
 		    GLuint _vert_stride)
 {
     int err = 0;
-    err |= control (file, "negate", negate, _negate, NULL);
-    err |= control (file, "abs", _abs, __abs, NULL);
+    err |= control (out, "negate", negate, _negate, NULL);
+    err |= control (out, "abs", _abs, __abs, NULL);
 
-    string (file, "g[a0");
+    string (out, "g[a0");
     if (_addr_subreg_nr)
-	format (file, ".%d", _addr_subreg_nr);
+	format (out, ".%d", _addr_subreg_nr);
     if (_addr_imm)
-	format (file, " %d", _addr_imm);
-    string (file, "]");
-    src_align1_region (file, _vert_stride, _width, _horiz_stride);
-    err |= control (file, "src reg encoding", reg_encoding, type, NULL);
+	format (out, " %d", _addr_imm);
+    string (out, "]");
+    src_align1_region (out, _vert_stride, _width, _horiz_stride);
+    err |= control (out, "src reg encoding", reg_encoding, type, NULL);
     return err;
 }
 
-static int src_da16 (FILE *file,
+static int src_da16 (struct disasm_output *out,
 		     GLuint _reg_type,
 		     GLuint _reg_file,
 		     GLuint _vert_stride,
@@ -580,18 +758,18 @@ static int src_da16 (FILE *file,
 		     GLuint swz_w)
 {
     int err = 0;
-    err |= control (file, "negate", negate, _negate, NULL);
-    err |= control (file, "abs", _abs, __abs, NULL);
+    err |= control (out, "negate", negate, _negate, NULL);
+    err |= control (out, "abs", _abs, __abs, NULL);
 
-    err |= reg (file, _reg_file, _reg_nr);
+    err |= reg (out, _reg_file, _reg_nr);
     if (err == -1)
 	return 0;
     if (_subreg_nr)
-	format (file, ".%d", _subreg_nr);
-    string (file, "<");
-    err |= control (file, "vert stride", vert_stride, _vert_stride, NULL);
-    string (file, ",1,1>");
-    err |= control (file, "src da16 reg type", reg_encoding, _reg_type, NULL);
+	format (out, ".%d", _subreg_nr);
+    string (out, "<");
+    err |= control (out, "vert stride", vert_stride, _vert_stride, NULL);
+    string (out, ",1,1>");
+    err |= control (out, "src da16 reg type", reg_encoding, _reg_type, NULL);
     /*
      * Three kinds of swizzle display:
      *  identity - nothing printed
@@ -607,60 +785,86 @@ static int src_da16 (FILE *file,
     }
     else if (swz_x == swz_y && swz_x == swz_z && swz_x == swz_w)
     {
-	string (file, ".");
-	err |= control (file, "channel select", chan_sel, swz_x, NULL);
+	string (out, ".");
+	err |= control (out, "channel select", chan_sel, swz_x, NULL);
     }
     else
     {
-	string (file, ".");
-	err |= control (file, "channel select", chan_sel, swz_x, NULL);
-	err |= control (file, "channel select", chan_sel, swz_y, NULL);
-	err |= control (file, "channel select", chan_sel, swz_z, NULL);
-	err |= control (file, "channel select", chan_sel, swz_w, NULL);
+	string (out, ".");
+	err |= control (out, "channel select", chan_sel, swz_x, NULL);
+	err |= control (out, "channel select", chan_sel, swz_y, NULL);
+	err |= control (out, "channel select", chan_sel, swz_z, NULL);
+	err |= control (out, "channel select", chan_sel, swz_w, NULL);
     }
     return err;
 }
 
 
-static int imm (FILE *file, GLuint type, struct brw_instruction *inst) {
+static float vf_to_float (GLuint vf)
+{
+    union {
+	float f;
+	uint32_t u;
+    } fu;
+
+    if ((vf & 0x7f) == 0)
+	fu.u = 0;
+    else
+	fu.u = (((vf >> 4) & 0x7) + (127 - 3)) << 23 | (vf & 0xf) << 19;
+    fu.u |= (vf >> 7) << 31;
+    return fu.f;
+}
+
+static int imm (struct disasm_output *out, GLuint type, struct brw_instruction *inst) {
     switch (type) {
     case BRW_REGISTER_TYPE_UD:
-	format (file, "0x%08xUD", inst->bits3.ud);
+	format (out, "0x%08xUD", inst->bits3.ud);
 	break;
     case BRW_REGISTER_TYPE_D:
-	format (file, "%dD", inst->bits3.id);
+	format (out, "%dD", inst->bits3.id);
 	break;
     case BRW_REGISTER_TYPE_UW:
-	format (file, "0x%04xUW", (uint16_t) inst->bits3.ud);
+	format (out, "0x%04xUW", (uint16_t) inst->bits3.ud);
 	break;
     case BRW_REGISTER_TYPE_W:
-	format (file, "%dW", (int16_t) inst->bits3.id);
+	format (out, "%dW", (int16_t) inst->bits3.id);
 	break;
     case BRW_REGISTER_TYPE_UB:
-	format (file, "0x%02xUB", (int8_t) inst->bits3.ud);
+	if (IS_GENp(6))
+	    format (out, "0x%08xUV", inst->bits3.ud);
+	else
+	    format (out, "0x%02xUB", (int8_t) inst->bits3.ud);
 	break;
     case BRW_REGISTER_TYPE_VF:
-	format (file, "Vector Float");
+	format (out, "[%-g, %-g, %-g, %-g]VF",
+		vf_to_float (inst->bits3.ud & 0xff),
+		vf_to_float ((inst->bits3.ud >> 8) & 0xff),
+		vf_to_float ((inst->bits3.ud >> 16) & 0xff),
+		vf_to_float (inst->bits3.ud >> 24));
 	break;
     case BRW_REGISTER_TYPE_V:
-	format (file, "0x%08xV", inst->bits3.ud);
+	format (out, "0x%08xV", inst->bits3.ud);
 	break;
     case BRW_REGISTER_TYPE_F:
-	format (file, "%-gF", inst->bits3.fd);
+	/* "-0F" would read back as the integer 0. */
+	if (inst->bits3.ud == 0x80000000)
+	    string (out, "-0.0F");
+	else
+	    format (out, "%-gF", inst->bits3.fd);
     }
     return 0;
 }
 
-static int src0 (FILE *file, struct brw_instruction *inst)
+static int src0 (struct disasm_output *out, struct brw_instruction *inst)
 {
     if (inst->bits1.da1.src0_reg_file == BRW_IMMEDIATE_VALUE)
-	return imm (file, inst->bits1.da1.src0_reg_type,
+	return imm (out, inst->bits1.da1.src0_reg_type,
 		    inst);
     else if (inst->header.access_mode == BRW_ALIGN_1)
     {
 	if (inst->bits2.da1.src0_address_mode == BRW_ADDRESS_DIRECT)
 	{
-	    return src_da1 (file,
+	    return src_da1 (out,
 			    inst->bits1.da1.src0_reg_type,
 			    inst->bits1.da1.src0_reg_file,
 			    inst->bits2.da1.src0_vert_stride,
@@ -673,7 +877,7 @@ static int src0 (FILE *file, struct brw_instruction *inst)
 	}
 	else
 	{
-	    return src_ia1 (file,
+	    return src_ia1 (out,
 			    inst->bits1.ia1.src0_reg_type,
 			    inst->bits1.ia1.src0_reg_file,
 			    inst->bits2.ia1.src0_indirect_offset,
@@ -690,7 +894,7 @@ static int src0 (FILE *file, struct brw_instruction *inst)
     {
 	if (inst->bits2.da16.src0_address_mode == BRW_ADDRESS_DIRECT)
 	{
-	    return src_da16 (file,
+	    return src_da16 (out,
 			     inst->bits1.da16.src0_reg_type,
 			     inst->bits1.da16.src0_reg_file,
 			     inst->bits2.da16.src0_vert_stride,
@@ -705,22 +909,22 @@ static int src0 (FILE *file, struct brw_instruction *inst)
 	}
 	else
 	{
-	    string (file, "Indirect align16 address mode not supported");
+	    string (out, "Indirect align16 address mode not supported");
 	    return 1;
 	}
     }
 }
 
-static int src1 (FILE *file, struct brw_instruction *inst)
+static int src1 (struct disasm_output *out, struct brw_instruction *inst)
 {
     if (inst->bits1.da1.src1_reg_file == BRW_IMMEDIATE_VALUE)
-	return imm (file, inst->bits1.da1.src1_reg_type,
+	return imm (out, inst->bits1.da1.src1_reg_type,
 		    inst);
     else if (inst->header.access_mode == BRW_ALIGN_1)
     {
 	if (inst->bits3.da1.src1_address_mode == BRW_ADDRESS_DIRECT)
 	{
-	    return src_da1 (file,
+	    return src_da1 (out,
 			    inst->bits1.da1.src1_reg_type,
 			    inst->bits1.da1.src1_reg_file,
 			    inst->bits3.da1.src1_vert_stride,
@@ -733,7 +937,7 @@ static int src1 (FILE *file, struct brw_instruction *inst)
 	}
 	else
 	{
-	    return src_ia1 (file,
+	    return src_ia1 (out,
 			    inst->bits1.ia1.src1_reg_type,
 			    inst->bits1.ia1.src1_reg_file,
 			    inst->bits3.ia1.src1_indirect_offset,
@@ -750,7 +954,7 @@ static int src1 (FILE *file, struct brw_instruction *inst)
     {
 	if (inst->bits3.da16.src1_address_mode == BRW_ADDRESS_DIRECT)
 	{
-	    return src_da16 (file,
+	    return src_da16 (out,
 			     inst->bits1.da16.src1_reg_type,
 			     inst->bits1.da16.src1_reg_file,
 			     inst->bits3.da16.src1_vert_stride,
@@ -765,142 +969,391 @@ static int src1 (FILE *file, struct brw_instruction *inst)
 	}
 	else
 	{
-	    string (file, "Indirect align16 address mode not supported");
+	    string (out, "Indirect align16 address mode not supported");
 	    return 1;
 	}
     }
 }
 
-int disasm (FILE *file, struct brw_instruction *inst)
+char *three_src_reg_encoding[4] = {
+    [0] = "F",
+    [1] = "D",
+    [2] = "UD",
+    [3] = "DF",
+};
+
+static int three_src_dest (struct disasm_output *out, struct brw_instruction *inst)
 {
     int	err = 0;
+
+    if (IS_GENx(6) && inst->bits1.three_src_gen6.dest_reg_file)
+	format (out, "m%d", inst->bits1.three_src_gen6.dest_reg_nr);
+    else
+	format (out, "g%d", inst->bits1.three_src_gen6.dest_reg_nr);
+    if (inst->bits1.three_src_gen6.dest_subreg_nr)
+	format (out, ".%d", inst->bits1.three_src_gen6.dest_subreg_nr * 4);
+    string (out, "<1>");
+    err |= control (out, "writemask", writemask,
+		    inst->bits1.three_src_gen6.dest_writemask, NULL);
+    err |= control (out, "dest reg encoding", three_src_reg_encoding,
+		    inst->bits1.three_src_gen6.dest_reg_type, NULL);
+    return err;
+}
+
+/* Three-source operands are GRFs with a dword subregister; a replicated
+ * scalar is shown with a <0,1,0> region, as the assembler takes it.
+ */
+static int three_src_src (struct disasm_output *out, struct brw_instruction *inst,
+			  GLuint modifier, GLuint rep_ctrl, GLuint swizzle,
+			  GLuint _reg_nr, GLuint _subreg_nr)
+{
+    int err = 0;
+    GLuint swz_x = swizzle & 3;
+    GLuint swz_y = (swizzle >> 2) & 3;
+    GLuint swz_z = (swizzle >> 4) & 3;
+    GLuint swz_w = (swizzle >> 6) & 3;
+
+    err |= control (out, "negate", negate, (modifier & BRW_3SRC_MODIFIER_NEGATE) != 0, NULL);
+    err |= control (out, "abs", _abs, modifier & BRW_3SRC_MODIFIER_ABS, NULL);
+    format (out, "g%d", _reg_nr);
+    /* subregisters are encoded in dwords but written in bytes */
+    if (_subreg_nr)
+	format (out, ".%d", _subreg_nr * 4);
+    string (out, rep_ctrl ? "<0,1,0>" : "<4,4,1>");
+    err |= control (out, "src reg encoding", three_src_reg_encoding,
+		    inst->bits1.three_src_gen6.src_reg_type, NULL);
+    if (rep_ctrl || swizzle == BRW_SWIZZLE_NOOP)
+	return err;
+    string (out, ".");
+    if (swz_x == swz_y && swz_x == swz_z && swz_x == swz_w) {
+	err |= control (out, "channel select", chan_sel, swz_x, NULL);
+    } else {
+	err |= control (out, "channel select", chan_sel, swz_x, NULL);
+	err |= control (out, "channel select", chan_sel, swz_y, NULL);
+	err |= control (out, "channel select", chan_sel, swz_z, NULL);
+	err |= control (out, "channel select", chan_sel, swz_w, NULL);
+    }
+    return err;
+}
+
+/*
+ * Prints a data port send in the named message syntax of dataport.c.
+ * Returns -1 if the descriptor isn't a known data port message.
+ */
+static int dataport_message (struct disasm_output *out, struct brw_instruction *inst,
+			     GLuint target)
+{
+    const struct dataport_message_desc *desc;
+    int cache, write = 0, control, bti, header = 1;
+
+    if (IS_GENp(6)) {
+	cache = dataport_sfid_cache (target);
+	if (cache < 0)
+	    return -1;
+	if (IS_GENp(7)) {
+	    control = inst->bits3.dp_gen7.msg_control;
+	    desc = dataport_message_decode (cache, 0, inst->bits3.dp_gen7.msg_type);
+	} else {
+	    control = inst->bits3.dp_gen6.msg_control;
+	    desc = dataport_message_decode (cache, 0, inst->bits3.dp_gen6.msg_type);
+	}
+	bti = inst->bits3.dp_gen6.binding_table_index;
+    } else if (target == BRW_MESSAGE_TARGET_DATAPORT_READ) {
+	switch (inst->bits3.dp_read.target_cache) {
+	case BRW_DATAPORT_READ_TARGET_RENDER_CACHE:
+	    cache = DP_RENDER_CACHE;
+	    break;
+	case BRW_DATAPORT_READ_TARGET_SAMPLER_CACHE:
+	    cache = DP_SAMPLER_CACHE;
+	    break;
+	default:
+	    cache = DP_DATA_CACHE;
+	    break;
+	}
+	control = inst->bits3.dp_read.msg_control;
+	bti = inst->bits3.dp_read.binding_table_index;
+	desc = dataport_message_decode (cache, 0, inst->bits3.dp_read.msg_type);
+    } else if (target == BRW_MESSAGE_TARGET_DATAPORT_WRITE) {
+	cache = DP_RENDER_CACHE;
+	write = 1;
+	control = inst->bits3.dp_write.pixel_scoreboard_clear << 3 |
+	    inst->bits3.dp_write.msg_control;
+	bti = inst->bits3.dp_write.binding_table_index;
+	desc = dataport_message_decode (cache, write, inst->bits3.dp_write.msg_type);
+    } else {
+	return -1;
+    }
+    /* Gen4/5 writes carry a commit bit the named syntax can't express */
+    if (!desc || (write && inst->bits3.dp_write.send_commit_msg))
+	return -1;
+
+    if (IS_GENp(5))
+	header = inst->bits3.generic_gen5.header_present;
+    format (out, "%s %s (%d, %d, %d)", dataport_cache_names[cache],
+	    dataport_message_names[desc->message], bti, control, header);
+    return 0;
+}
+
+static int three_src (struct disasm_output *out, struct brw_instruction *inst)
+{
+    int err = 0;
+
+    pad (out, 16);
+    err |= three_src_dest (out, inst);
+    pad (out, 32);
+    err |= three_src_src (out, inst,
+			  inst->bits1.three_src_gen6.src0_modifier,
+			  inst->bits2.three_src_gen6.src0_rep_ctrl,
+			  inst->bits2.three_src_gen6.src0_swizzle,
+			  inst->bits2.three_src_gen6.src0_reg_nr,
+			  inst->bits2.three_src_gen6.src0_subreg_nr);
+    pad (out, 48);
+    err |= three_src_src (out, inst,
+			  inst->bits1.three_src_gen6.src1_modifier,
+			  inst->bits2.three_src_gen6.src1_rep_ctrl,
+			  inst->bits2.three_src_gen6.src1_swizzle,
+			  inst->bits3.three_src_gen6.src1_reg_nr,
+			  inst->bits2.three_src_gen6.src1_subreg_nr_low |
+			  inst->bits3.three_src_gen6.src1_subreg_nr_high << 2);
+    pad (out, 64);
+    err |= three_src_src (out, inst,
+			  inst->bits1.three_src_gen6.src2_modifier,
+			  inst->bits3.three_src_gen6.src2_rep_ctrl,
+			  inst->bits3.three_src_gen6.src2_swizzle,
+			  inst->bits3.three_src_gen6.src2_reg_nr,
+			  inst->bits3.three_src_gen6.src2_subreg_nr);
+    return err;
+}
+
+static int disasm_instruction (struct disasm_output *out,
+			       struct brw_instruction *inst, int ip,
+			       const struct disasm_labels *labels)
+{
+    const struct opcode_desc *desc = opcode_desc (inst->header.opcode);
+    int	err = 0;
     int space = 0;
+    int ndst = desc ? desc->ndst : 0;
+    int nsrc = desc ? desc->nsrc : 0;
+
+    /* Everything else about a Gen4/5 ENDIF is fixed, and the assembler
+     * takes nothing more.
+     */
+    if (labels && inst->header.opcode == BRW_OPCODE_ENDIF && !IS_GENp(6)) {
+	string (out, "endif;");
+	newline (out);
+	return 0;
+    }
 
     if (inst->header.predicate_control) {
-	string (file, "(");
-	err |= control (file, "predicate inverse", pred_inv, inst->header.predicate_inverse, NULL);
-	format (file, "f%d", inst->bits2.da1.flag_reg_nr);
+	string (out, "(");
+	err |= control (out, "predicate inverse", pred_inv, inst->header.predicate_inverse, NULL);
+	format (out, "f%d", inst->bits2.da1.flag_reg_nr);
 	if (inst->bits2.da1.flag_subreg_nr)
-	    format (file, ".%d", inst->bits2.da1.flag_subreg_nr);
+	    format (out, ".%d", inst->bits2.da1.flag_subreg_nr);
 	if (inst->header.access_mode == BRW_ALIGN_1)
-	    err |= control (file, "predicate control align1", pred_ctrl_align1,
+	    err |= control (out, "predicate control align1", pred_ctrl_align1,
 			    inst->header.predicate_control, NULL);
 	else
-	    err |= control (file, "predicate control align16", pred_ctrl_align16,
+	    err |= control (out, "predicate control align16", pred_ctrl_align16,
 			    inst->header.predicate_control, NULL);
-	string (file, ") ");
+	string (out, ") ");
     }
 
-    err |= print_opcode (file, inst->header.opcode);
-    err |= control (file, "saturate", saturate, inst->header.saturate, NULL);
-    err |= control (file, "debug control", debug_ctrl, inst->header.debug_control, NULL);
+    err |= print_opcode (out, desc, inst->header.opcode);
+    err |= control (out, "saturate", saturate, inst->header.saturate, NULL);
+    err |= control (out, "debug control", debug_ctrl, inst->header.debug_control, NULL);
 
-    if (inst->header.opcode != BRW_OPCODE_SEND &&
-	inst->header.opcode != BRW_OPCODE_SENDC)
-	err |= control (file, "conditional modifier", conditional_modifier,
+    /* Sends and math keep something else in the condition field. */
+    if (!desc || (desc->format != OPCODE_SEND &&
+		  desc->format != OPCODE_MATH))
+	err |= control (out, "conditional modifier", conditional_modifier,
 			inst->header.sfid_destreg__conditionalmod, NULL);
 
     if (inst->header.opcode != BRW_OPCODE_NOP) {
-	string (file, "(");
-	err |= control (file, "execution size", exec_size, inst->header.execution_size, NULL);
-	string (file, ")");
+	string (out, "(");
+	err |= control (out, "execution size", exec_size, inst->header.execution_size, NULL);
+	string (out, ")");
     }
 
+    /* The message register, which Gen6+ moves to src0 to make room for
+     * the target in the header.
+     */
     if (inst->header.opcode == BRW_OPCODE_SEND ||
 	inst->header.opcode == BRW_OPCODE_SENDC)
-	format (file, " %d", inst->header.sfid_destreg__conditionalmod);
-
-    if (opcode[inst->header.opcode].ndst > 0) {
-	pad (file, 16);
-	err |= dest (file, inst);
-    }
-    if (opcode[inst->header.opcode].nsrc > 0) {
-	pad (file, 32);
-	err |= src0 (file, inst);
-    }
-    if (opcode[inst->header.opcode].nsrc > 1) {
-	pad (file, 48);
-	err |= src1 (file, inst);
+	format (out, " %d", IS_GENp(6) ? inst->bits2.da1.src0_reg_nr :
+		inst->header.sfid_destreg__conditionalmod);
+
+    if (desc && desc->format == OPCODE_THREE_SRC) {
+	err |= three_src (out, inst);
+    } else if (labels && offset_in_src1 (inst)) {
+	int jip, uip;
+
+	instruction_branch_offsets (inst, &jip, &uip);
+	pad (out, 16);
+	location (out, ip, inst->header.opcode == BRW_OPCODE_JMPI ? jip + 1 : jip,
+		  labels);
+    } else {
+	if (ndst > 0) {
+	    pad (out, 16);
+	    err |= dest (out, inst);
+	}
+	if (desc && desc->format == OPCODE_BRANCH)
+	    err |= branch_offsets (out, desc, inst, ip, labels);
+	if (nsrc > 0) {
+	    pad (out, 32);
+	    err |= src0 (out, inst);
+	}
+	if (nsrc > 1) {
+	    pad (out, 48);
+	    err |= src1 (out, inst);
+	}
+	if (desc && desc->format == OPCODE_MATH) {
+	    string (out, " ");
+	    err |= control (out, "math function", math_function,
+			    inst->header.sfid_destreg__conditionalmod, NULL);
+	}
     }
 
     if (inst->header.opcode == BRW_OPCODE_SEND ||
 	inst->header.opcode == BRW_OPCODE_SENDC) {
-	newline (file);
-	pad (file, 16);
+	GLuint target = send_target (inst);
+	int named;
+
+	newline (out);
+	pad (out, 16);
 	space = 0;
-	err |= control (file, "target function", target_function,
-			inst->header.sfid_destreg__conditionalmod, &space);
-	switch (inst->header.sfid_destreg__conditionalmod) {
-	case BRW_MESSAGE_TARGET_MATH:
-	    err |= control (file, "math function", math_function,
-			    inst->bits3.math.function, &space);
-	    err |= control (file, "math saturate", math_saturate,
-			    inst->bits3.math.saturate, &space);
-	    err |= control (file, "math signed", math_signed,
-			    inst->bits3.math.int_type, &space);
-	    err |= control (file, "math scalar", math_scalar,
-			    inst->bits3.math.data_type, &space);
-	    err |= control (file, "math precision", math_precision,
-			    inst->bits3.math.precision, &space);
-	    break;
-	case BRW_MESSAGE_TARGET_SAMPLER:
-	    format (file, " (%d, %d, ",
-		    inst->bits3.sampler.binding_table_index,
-		    inst->bits3.sampler.sampler);
-	    err |= control (file, "sampler target format", sampler_target_format,
-			    inst->bits3.sampler.return_format, NULL);
-	    string (file, ")");
-	    break;
-	case BRW_MESSAGE_TARGET_DATAPORT_WRITE:
-	    format (file, " (%d, %d, %d, %d)",
-		    inst->bits3.dp_write.binding_table_index,
-		    (inst->bits3.dp_write.pixel_scoreboard_clear << 3) |
-		    inst->bits3.dp_write.msg_control,
-		    inst->bits3.dp_write.msg_type,
-		    inst->bits3.dp_write.send_commit_msg);
-	    break;
-	case BRW_MESSAGE_TARGET_URB:
-	    format (file, " %d", inst->bits3.urb.offset);
+	named = dataport_message (out, inst, target);
+	if (named >= 0) {
+	    err |= named;
 	    space = 1;
-	    err |= control (file, "urb swizzle", urb_swizzle,
-			    inst->bits3.urb.swizzle_control, &space);
-	    err |= control (file, "urb allocate", urb_allocate,
-			    inst->bits3.urb.allocate, &space);
-	    err |= control (file, "urb used", urb_used,
-			    inst->bits3.urb.used, &space);
-	    err |= control (file, "urb complete", urb_complete,
-			    inst->bits3.urb.complete, &space);
-	    break;
-	case BRW_MESSAGE_TARGET_THREAD_SPAWNER:
-	    break;
-	default:
-	    format (file, "unsupported target %d", inst->bits3.generic.msg_target);
-	    break;
+	} else if (print_target (out, target)) {
+	    err = 1;
+	} else {
+	    space = 1;
+	    switch (target) {
+	    case BRW_MESSAGE_TARGET_MATH:
+		err |= control (out, "math function", math_function,
+				inst->bits3.math.function, &space);
+		err |= control (out, "math saturate", math_saturate,
+				inst->bits3.math.saturate, &space);
+		err |= control (out, "math signed", math_signed,
+				inst->bits3.math.int_type, &space);
+		err |= control (out, "math scalar", math_scalar,
+				inst->bits3.math.data_type, &space);
+		err |= control (out, "math precision", math_precision,
+				inst->bits3.math.precision, &space);
+		break;
+	    case BRW_MESSAGE_TARGET_SAMPLER:
+		if (IS_GENp(7)) {
+		    format (out, " (%d, %d, F, %d, ",
+			    inst->bits3.sampler_gen7.binding_table_index,
+			    inst->bits3.sampler_gen7.sampler,
+			    inst->bits3.sampler_gen7.msg_type);
+		    err |= control (out, "sampler simd mode", sampler_simd_mode,
+				    inst->bits3.sampler_gen7.simd_mode, NULL);
+		    format (out, ", %d)", inst->bits3.generic_gen5.header_present);
+		} else if (IS_GENp(5)) {
+		    format (out, " (%d, %d, F, %d, ",
+			    inst->bits3.sampler_gen5.binding_table_index,
+			    inst->bits3.sampler_gen5.sampler,
+			    inst->bits3.sampler_gen5.msg_type);
+		    err |= control (out, "sampler simd mode", sampler_simd_mode,
+				    inst->bits3.sampler_gen5.simd_mode, NULL);
+		    format (out, ", %d)", inst->bits3.generic_gen5.header_present);
+		} else {
+		    format (out, " (%d, %d, ",
+			    inst->bits3.sampler.binding_table_index,
+			    inst->bits3.sampler.sampler);
+		    err |= control (out, "sampler target format", sampler_target_format,
+				    inst->bits3.sampler.return_format, NULL);
+		    string (out, ")");
+		}
+		break;
+	    case BRW_MESSAGE_TARGET_DATAPORT_WRITE:
+		format (out, " (%d, %d, %d, %d)",
+			inst->bits3.dp_write.binding_table_index,
+			(inst->bits3.dp_write.pixel_scoreboard_clear << 3) |
+			inst->bits3.dp_write.msg_control,
+			inst->bits3.dp_write.msg_type,
+			inst->bits3.dp_write.send_commit_msg);
+		break;
+	    case BRW_MESSAGE_TARGET_URB:
+		format (out, " %d", inst->bits3.urb.offset);
+		space = 1;
+		err |= control (out, "urb swizzle", urb_swizzle,
+				inst->bits3.urb.swizzle_control, &space);
+		err |= control (out, "urb allocate", urb_allocate,
+				inst->bits3.urb.allocate, &space);
+		err |= control (out, "urb used", urb_used,
+				inst->bits3.urb.used, &space);
+		err |= control (out, "urb complete", urb_complete,
+				inst->bits3.urb.complete, &space);
+		break;
+	    case BRW_MESSAGE_TARGET_THREAD_SPAWNER:
+		break;
+	    default:
+		format (out, "unsupported target %d", inst->bits3.generic.msg_target);
+		break;
+	    }
 	}
 	if (space)
-	    string (file, " ");
-	format (file, "mlen %d",
-		inst->bits3.generic.msg_length);
-	format (file, " rlen %d",
-		inst->bits3.generic.response_length);
+	    string (out, " ");
+	if (IS_GENp(5)) {
+	    format (out, "mlen %d",
+		    inst->bits3.generic_gen5.msg_length);
+	    format (out, " rlen %d",
+		    inst->bits3.generic_gen5.response_length);
+	} else {
+	    format (out, "mlen %d",
+		    inst->bits3.generic.msg_length);
+	    format (out, " rlen %d",
+		    inst->bits3.generic.response_length);
+	}
     }
-    pad (file, 64);
+    pad (out, instruction_is_three_src(inst) ? 80 : 64);
     if (inst->header.opcode != BRW_OPCODE_NOP) {
-	string (file, "{");
+	string (out, "{");
 	space = 1;
-	err |= control(file, "access mode", access_mode, inst->header.access_mode, &space);
-	err |= control (file, "mask control", mask_ctrl, inst->header.mask_control, &space);
-	err |= control (file, "dependency control", dep_ctrl, inst->header.dependency_control, &space);
-	err |= control (file, "compression control", compr_ctrl, inst->header.compression_control, &space);
-	err |= control (file, "thread control", thread_ctrl, inst->header.thread_control, &space);
+	err |= control(out, "access mode", access_mode, inst->header.access_mode, &space);
+	err |= control (out, "mask control", mask_ctrl, inst->header.mask_control, &space);
+	err |= control (out, "dependency control", dep_ctrl, inst->header.dependency_control, &space);
+	err |= control (out, "compression control", compr_ctrl, inst->header.compression_control, &space);
+	err |= control (out, "thread control", thread_ctrl, inst->header.thread_control, &space);
 	if (inst->header.opcode == BRW_OPCODE_SEND)
-	    err |= control (file, "end of thread", end_of_thread,
+	    err |= control (out, "end of thread", end_of_thread,
 			    inst->bits3.generic.end_of_thread, &space);
 	if (space)
-	    string (file, " ");
-	string (file, "}");
+	    string (out, " ");
+	string (out, "}");
     }
-    string (file, ";");
-    newline (file);
+    string (out, ";");
+    newline (out);
+    return err;
+}
+
+int disasm_to (struct disasm_output *out, struct brw_instruction *inst)
+{
+    return disasm_instruction (out, inst, 0, NULL);
+}
+
+/**
+ * Disassembles instruction ip of a program, with its branches and any
+ * label in front of it written with labels.
+ */
+int disasm_at (struct disasm_output *out, struct brw_instruction *inst,
+	       int ip, const struct disasm_labels *labels)
+{
+    disasm_label (out, ip, labels);
+    return disasm_instruction (out, inst, ip, labels);
+}
+
+int disasm (FILE *file, struct brw_instruction *inst)
+{
+    struct disasm_output	out;
+    int				err;
+
+    disasm_output_init (&out, file);
+    err = disasm_to (&out, inst);
+    disasm_output_fini (&out);
     return err;
 }
@@ -0,0 +1,485 @@
+/* -*- c-basic-offset: 8 -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Static cycle estimate of a program, for comparing versions of a kernel
+ * without running it.
+ *
+ * The model is a single thread issuing in order: an instruction issues
+ * once the registers it reads are ready, occupies the EU for a time set by
+ * its execution size and type, and its results become ready after a fixed
+ * latency, or after the shared function's latency for a send.  Basic
+ * blocks are estimated on their own, each run once, so loops and latency
+ * hidden by other threads are not accounted for.  The issue cycles alone
+ * give the throughput bound when enough threads hide every latency.
+ *
+ * The critical path of a block is its longest chain of RAW, WAR and WAW
+ * dependencies under the same latencies, the bound on the block when
+ * latency rather than issue limits it.
+ *
+ * The numbers are rough and meant for relative comparisons only.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gen4asm.h"
+
+#define BRANCH_COST	4
+
+struct inst_cost {
+	int issue;	/* cycles the EU is busy issuing it */
+	int stall;	/* cycles waited for its operands */
+};
+
+static int alu_latency(void)
+{
+	return IS_GENp(6) ? 14 : 10;
+}
+
+static int send_latency(struct brw_instruction *inst)
+{
+	switch (send_target(inst)) {
+	case BRW_MESSAGE_TARGET_NULL:
+		return 2;
+	case BRW_MESSAGE_TARGET_MATH:
+		return 40;
+	case BRW_MESSAGE_TARGET_SAMPLER:
+		return 250;
+	case BRW_MESSAGE_TARGET_GATEWAY:
+		return 40;
+	case BRW_MESSAGE_TARGET_DATAPORT_READ:
+		return 150;
+	case BRW_MESSAGE_TARGET_DATAPORT_WRITE:
+		return 60;
+	case BRW_MESSAGE_TARGET_URB:
+		return 60;
+	case BRW_MESSAGE_TARGET_THREAD_SPAWNER:
+		return 20;
+	case BRW_MESSAGE_TARGET_DP_CC:
+		return 120;
+	case BRW_MESSAGE_TARGET_VME:
+	case BRW_MESSAGE_TARGET_CRE:
+		return 400;
+	default:
+		return 150;
+	}
+}
+
+/* The Gen6+ math unit works on one channel per cycle. */
+static int math_latency(struct brw_instruction *inst)
+{
+	switch (inst->header.sfid_destreg__conditionalmod) {
+	case BRW_MATH_FUNCTION_SIN:
+	case BRW_MATH_FUNCTION_COS:
+		return 32;
+	case BRW_MATH_FUNCTION_POW:
+	case BRW_MATH_FUNCTION_SINCOS:
+		return 44;
+	case BRW_MATH_FUNCTION_INT_DIV_QUOTIENT_AND_REMAINDER:
+	case BRW_MATH_FUNCTION_INT_DIV_QUOTIENT:
+	case BRW_MATH_FUNCTION_INT_DIV_REMAINDER:
+		return 80;
+	default:
+		return 22;
+	}
+}
+
+/* Cycles the EU is busy issuing an instruction.  The datapath handles 4
+ * dword or 8 word channels per cycle.
+ */
+int instruction_issue_cycles(struct brw_instruction *inst)
+{
+	int exec_size = instruction_exec_size(inst);
+	int type_size = 4, lanes, cycles;
+
+	switch (inst->header.opcode) {
+	case BRW_OPCODE_SEND:
+	case BRW_OPCODE_SENDC:
+	case BRW_OPCODE_NOP:
+		return 1;
+	case BRW_OPCODE_MATH:
+		return exec_size < 2 ? 2 : exec_size;
+	}
+
+	if (instruction_is_control_flow(inst))
+		return 1 + BRANCH_COST;
+
+	if (!instruction_is_three_src(inst))
+		type_size = reg_type_size(inst->bits1.da1.dest_reg_type);
+	lanes = type_size <= 2 ? 8 : 4;
+	cycles = exec_size / lanes;
+	return cycles ? cycles : 1;
+}
+
+/* Cycles from the issue of an instruction until its result can be read. */
+int instruction_latency(struct brw_instruction *inst)
+{
+	switch (inst->header.opcode) {
+	case BRW_OPCODE_SEND:
+	case BRW_OPCODE_SENDC:
+		return send_latency(inst);
+	case BRW_OPCODE_MATH:
+		return math_latency(inst);
+	default:
+		return alu_latency();
+	}
+}
+
+/* Time at which each 32-byte register of the ARF, GRF and MRF holds the
+ * result of the last instruction writing it.
+ */
+struct reg_ready {
+	int reg[3][256];
+};
+
+static int range_ready(struct reg_ready *ready, struct reg_range *r)
+{
+	int i, t = 0;
+
+	if (r->file > BRW_MESSAGE_REGISTER_FILE)
+		return 0;
+	for (i = r->start / 32; i <= (r->end - 1) / 32 && i < 256; i++)
+		if (ready->reg[r->file][i] > t)
+			t = ready->reg[r->file][i];
+	return t;
+}
+
+static void set_range_ready(struct reg_ready *ready, struct reg_range *r,
+			    int t)
+{
+	int i;
+
+	if (r->file > BRW_MESSAGE_REGISTER_FILE)
+		return;
+	for (i = r->start / 32; i <= (r->end - 1) / 32 && i < 256; i++)
+		ready->reg[r->file][i] = t;
+}
+
+static void estimate_block(struct brw_instruction **insts,
+			   struct basic_block *block, struct inst_cost *costs)
+{
+	struct reg_ready *ready = calloc(1, sizeof(*ready));
+	struct inst_regs regs;
+	int i, j, now = 0, t;
+
+	for (i = block->start; i < block->end; i++) {
+		struct brw_instruction *inst = insts[i];
+
+		instruction_regs(inst, &regs);
+
+		t = now;
+		for (j = 0; j < regs.nuses; j++)
+			if (range_ready(ready, &regs.uses[j]) > t)
+				t = range_ready(ready, &regs.uses[j]);
+
+		costs[i].stall = t - now;
+		costs[i].issue = instruction_issue_cycles(inst);
+		now = t + costs[i].issue;
+
+		for (j = 0; j < regs.ndefs; j++)
+			set_range_ready(ready, &regs.defs[j],
+					now + instruction_latency(inst));
+	}
+	free(ready);
+}
+
+/* Estimated cycles to run a basic block once. */
+int estimate_block_cycles(struct brw_instruction **insts,
+			  struct basic_block *block)
+{
+	struct inst_cost *costs = calloc(block->end, sizeof(*costs));
+	int i, cycles = 0;
+
+	estimate_block(insts, block, costs);
+	for (i = block->start; i < block->end; i++)
+		cycles += costs[i].issue + costs[i].stall;
+	free(costs);
+	return cycles;
+}
+
+/**
+ * Estimates the cycles spent in each basic block of the n instructions
+ * and in the whole program, and writes the report to out, as text or
+ * JSON.
+ */
+void estimate_cycles(FILE *out, struct brw_instruction **insts, int n,
+		     int json)
+{
+	struct inst_cost *costs = calloc(n + 1, sizeof(*costs));
+	struct basic_block *blocks;
+	int nblocks, b, i;
+	int total_issue = 0, total_stall = 0;
+
+	nblocks = program_basic_blocks(insts, n, &blocks);
+	for (b = 0; b < nblocks; b++)
+		estimate_block(insts, &blocks[b], costs);
+	for (i = 0; i < n; i++) {
+		total_issue += costs[i].issue;
+		total_stall += costs[i].stall;
+	}
+
+	if (json) {
+		fprintf(out, "{\n  \"gen\": %ld.%ld,\n", gen_level / 10,
+			gen_level % 10);
+		fprintf(out, "  \"instructions\": %d,\n", n);
+		fprintf(out, "  \"cycles\": %d,\n", total_issue + total_stall);
+		fprintf(out, "  \"issue_cycles\": %d,\n", total_issue);
+		fprintf(out, "  \"stall_cycles\": %d,\n", total_stall);
+		fprintf(out, "  \"blocks\": [");
+	}
+
+	for (b = 0; b < nblocks; b++) {
+		struct basic_block *block = &blocks[b];
+		int issue = 0, stall = 0;
+
+		for (i = block->start; i < block->end; i++) {
+			issue += costs[i].issue;
+			stall += costs[i].stall;
+		}
+
+		if (!json) {
+			fprintf(out, "block %d [%d-%d]: %d instructions, "
+				"%d cycles (%d issue, %d stall)\n",
+				b, block->start, block->end - 1,
+				block->end - block->start,
+				issue + stall, issue, stall);
+			continue;
+		}
+
+		fprintf(out, "%s\n    {\"block\": %d, \"start\": %d, "
+			"\"end\": %d, \"cycles\": %d, \"issue_cycles\": %d, "
+			"\"stall_cycles\": %d,\n     \"costs\": [",
+			b ? "," : "", b, block->start, block->end - 1,
+			issue + stall, issue, stall);
+		for (i = block->start; i < block->end; i++)
+			fprintf(out, "%s[%d, %d]", i > block->start ? ", " : "",
+				costs[i].issue, costs[i].stall);
+		fprintf(out, "]}");
+	}
+
+	if (json)
+		fprintf(out, "\n  ]\n}\n");
+	else
+		fprintf(out, "kernel: %d instructions in %d blocks, "
+			"%d cycles (%d issue, %d stall)\n",
+			n, nblocks, total_issue + total_stall,
+			total_issue, total_stall);
+
+	free(blocks);
+	free(costs);
+}
+
+#define DEP_RAW	0
+#define DEP_WAR	1
+#define DEP_WAW	2
+
+static const char *dep_name[] = { "RAW", "WAR", "WAW" };
+
+struct dep_node {
+	int start;	/* earliest issue time on the critical path */
+	int pred;	/* instruction it waits for, or -1 */
+	int kind;	/* DEP_* on pred */
+	struct reg_range reg;	/* register carrying the dependency */
+};
+
+static void print_reg_range(FILE *out, struct reg_range *r)
+{
+	int nr = r->start / 32;
+
+	switch (r->file) {
+	case BRW_GENERAL_REGISTER_FILE:
+		fprintf(out, "g%d", nr);
+		break;
+	case BRW_MESSAGE_REGISTER_FILE:
+		fprintf(out, "m%d", nr);
+		break;
+	default:
+		if ((nr & 0xf0) == BRW_ARF_FLAG)
+			fprintf(out, "f%d.%d", nr & 0xf, r->start % 32 / 2);
+		else if ((nr & 0xf0) == BRW_ARF_ACCUMULATOR)
+			fprintf(out, "acc%d", nr & 0xf);
+		else if ((nr & 0xf0) == BRW_ARF_ADDRESS)
+			fprintf(out, "a%d", nr & 0xf);
+		else
+			fprintf(out, "arf%d", nr);
+		break;
+	}
+}
+
+/* Delay from the issue of instruction i to that of a later instruction j
+ * depending on it: j may read i's result once it is written, overwrite a
+ * register once i has read it, and its own write has to land after i's.
+ */
+static int dep_latency(struct brw_instruction *i, struct brw_instruction *j,
+		       int kind)
+{
+	int d;
+
+	switch (kind) {
+	case DEP_RAW:
+		return instruction_issue_cycles(i) + instruction_latency(i);
+	case DEP_WAR:
+		return instruction_issue_cycles(i);
+	default:
+		d = instruction_issue_cycles(i) + instruction_latency(i) - instruction_latency(j) + 1;
+		return d > 1 ? d : 1;
+	}
+}
+
+/* Finds the dependency of an earlier a on b, preferring RAW over WAW
+ * over WAR.  Returns its kind and stores the register, or -1.
+ */
+static int find_dependency(struct inst_regs *a, struct inst_regs *b,
+			   struct reg_range *reg)
+{
+	int i, j;
+
+	for (i = 0; i < a->ndefs; i++)
+		for (j = 0; j < b->nuses; j++)
+			if (reg_ranges_overlap(&a->defs[i], &b->uses[j])) {
+				*reg = b->uses[j];
+				return DEP_RAW;
+			}
+	for (i = 0; i < a->ndefs; i++)
+		for (j = 0; j < b->ndefs; j++)
+			if (reg_ranges_overlap(&a->defs[i], &b->defs[j])) {
+				*reg = b->defs[j];
+				return DEP_WAW;
+			}
+	for (i = 0; i < a->nuses; i++)
+		for (j = 0; j < b->ndefs; j++)
+			if (reg_ranges_overlap(&a->uses[i], &b->defs[j])) {
+				*reg = b->defs[j];
+				return DEP_WAR;
+			}
+	return -1;
+}
+
+/* Longest chain of dependent instructions in the block; returns its
+ * length in cycles and stores the index of its last instruction.
+ */
+static int block_critical_path(struct brw_instruction **insts,
+			       struct inst_regs *regs,
+			       struct basic_block *block,
+			       struct dep_node *nodes, int *last)
+{
+	int i, j, kind, t, end, length = 0;
+	struct reg_range reg;
+
+	*last = block->start;
+	for (j = block->start; j < block->end; j++) {
+		nodes[j].start = 0;
+		nodes[j].pred = -1;
+		for (i = block->start; i < j; i++) {
+			kind = find_dependency(&regs[i], &regs[j], &reg);
+			if (kind < 0)
+				continue;
+			t = nodes[i].start +
+				dep_latency(insts[i], insts[j], kind);
+			if (t > nodes[j].start || nodes[j].pred < 0) {
+				nodes[j].start = t;
+				nodes[j].pred = i;
+				nodes[j].kind = kind;
+				nodes[j].reg = reg;
+			}
+		}
+		end = nodes[j].start + instruction_issue_cycles(insts[j]);
+		if (regs[j].ndefs)
+			end += instruction_latency(insts[j]);
+		if (end > length) {
+			length = end;
+			*last = j;
+		}
+	}
+	return length;
+}
+
+static void print_chain(FILE *out, struct brw_program_instruction **entries,
+			struct dep_node *nodes, int j)
+{
+	if (nodes[j].pred >= 0)
+		print_chain(out, entries, nodes, nodes[j].pred);
+
+	fprintf(out, "  %s:%d: %d: at %d", entries[j]->filename,
+		entries[j]->line, j, nodes[j].start);
+	if (nodes[j].pred >= 0) {
+		fprintf(out, ", %s on ", dep_name[nodes[j].kind]);
+		print_reg_range(out, &nodes[j].reg);
+	}
+	fprintf(out, "\n");
+}
+
+/**
+ * Finds the dependency chain of GRF, MRF, accumulator and flag accesses
+ * that bounds the latency of every basic block of the program, and
+ * writes each with the source lines of its instructions to out.
+ *
+ * Returns the longest critical path in cycles.
+ */
+int report_critical_paths(FILE *out, struct brw_program *p)
+{
+	struct brw_program_instruction *entry, **entries;
+	struct brw_instruction **insts;
+	struct basic_block *blocks;
+	struct inst_regs *regs;
+	struct dep_node *nodes;
+	int n, nblocks, b, i, last, length, longest = 0, longest_block = 0;
+
+	n = program_instructions(p, &insts);
+	entries = calloc(n + 1, sizeof(*entries));
+	for (i = 0, entry = p->first; entry; entry = entry->next)
+		if (!entry->islabel)
+			entries[i++] = entry;
+
+	regs = calloc(n + 1, sizeof(*regs));
+	nodes = calloc(n + 1, sizeof(*nodes));
+	for (i = 0; i < n; i++)
+		instruction_regs(insts[i], &regs[i]);
+
+	nblocks = program_basic_blocks(insts, n, &blocks);
+	for (b = 0; b < nblocks; b++) {
+		length = block_critical_path(insts, regs, &blocks[b], nodes,
+					     &last);
+		fprintf(out, "block %d [%d-%d]: critical path %d cycles\n",
+			b, blocks[b].start, blocks[b].end - 1, length);
+		print_chain(out, entries, nodes, last);
+		if (length > longest) {
+			longest = length;
+			longest_block = b;
+		}
+	}
+	if (nblocks)
+		fprintf(out, "longest critical path: %d cycles in block %d\n",
+			longest, longest_block);
+
+	free(blocks);
+	free(nodes);
+	free(regs);
+	free(entries);
+	free(insts);
+	return longest;
+}
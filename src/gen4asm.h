@@ -133,6 +133,12 @@ typedef struct {
     } u;
 } imm32_t;
 
+/* The elements of a bracketed V, UV or VF immediate, before packing. */
+typedef struct {
+    int count;
+    imm32_t elem[8];
+} imm_vector_t;
+
 /**
  * This structure is just the list container for instructions accumulated by
  * the parser and labels.
@@ -143,6 +149,8 @@ struct brw_program_instruction {
 	GLuint islabel;
 	GLuint inst_offset;
 	char   *string;
+	int    line;		/* source line the instruction was parsed from */
+	char   *filename;	/* source file, following #line directives */
 };
 
 /**
@@ -175,6 +183,8 @@ struct program_defaults {
     struct region source_region_type[TOTAL_TYPES];
     struct region dest_region;
     struct region dest_region_type[TOTAL_TYPES];
+    int reg_count_total;	/* .reg_count_total, 0 if not given */
+    int reg_count_payload;	/* .reg_count_payload, 0 if not given */
 };
 extern struct program_defaults program_defaults;
 
@@ -190,6 +200,7 @@ struct declared_register *find_register(char *name);
 void insert_register(struct declared_register *reg);
 void add_label(char *name, int addr);
 int label_to_addr(char *name, int start_addr);
+void encode_branches(struct brw_program *p);
 
 int yyparse(void);
 int yylex(void);
@@ -198,5 +209,281 @@ int yylex_destroy(void);
 char *
 lex_text(void);
 
+/* disasm.c */
+struct disasm_output {
+	FILE *file;		/* NULL to keep everything in buf */
+	char *buf;
+	int size;
+	int len;
+	int column;
+};
+
+void disasm_output_init(struct disasm_output *out, FILE *file);
+void disasm_output_flush(struct disasm_output *out);
+void disasm_output_fini(struct disasm_output *out);
+int disasm_to(struct disasm_output *out, struct brw_instruction *inst);
+
+/* Label numbers of the instructions branches go to, for disasm_at(). */
+struct disasm_labels {
+	int n;		/* instructions in the program */
+	int *label;	/* per instruction and for the end, or -1; if NULL,
+			 * distances are written as numbers */
+};
+
+void disasm_find_labels(struct disasm_labels *labels,
+			struct brw_instruction **insts, int n);
+void disasm_labels_fini(struct disasm_labels *labels);
+void disasm_label(struct disasm_output *out, int ip,
+		  const struct disasm_labels *labels);
+int disasm_at(struct disasm_output *out, struct brw_instruction *inst,
+	      int ip, const struct disasm_labels *labels);
 int
 disasm (FILE *output, struct brw_instruction *inst);
+
+/* analysis.c */
+struct reg_range {
+	int file;	/* BRW_*_REGISTER_FILE */
+	int start;	/* byte offset of the first byte touched */
+	int end;	/* byte offset past the last byte touched */
+};
+
+#define GRF_COUNT	128
+
+#define INST_MAX_DEFS	4
+#define INST_MAX_USES	6
+
+struct inst_regs {
+	int ndefs, nuses;
+	struct reg_range defs[INST_MAX_DEFS];
+	struct reg_range uses[INST_MAX_USES];
+	int indirect;	/* some operand is addressed through a0 */
+};
+
+#define INST_MAX_TARGETS	2
+
+struct basic_block {
+	int start, end;	/* instruction indices, end exclusive */
+	int loop_depth;	/* number of loops around it, set by program_cfg */
+};
+
+#define CFG_EDGE_FALLTHROUGH	0
+#define CFG_EDGE_BRANCH		1
+#define CFG_EDGE_RETURN		2
+
+struct cfg_edge {
+	int from, to;	/* block indices */
+	int kind;	/* CFG_EDGE_* */
+};
+
+struct cfg {
+	int nblocks, nedges;
+	struct basic_block *blocks;
+	struct cfg_edge *edges;
+};
+
+int instruction_exec_size(struct brw_instruction *inst);
+int instruction_is_three_src(struct brw_instruction *inst);
+int instruction_is_control_flow(struct brw_instruction *inst);
+int instruction_ends_thread(struct brw_instruction *inst);
+int send_target(struct brw_instruction *inst);
+void instruction_branch_offsets(struct brw_instruction *inst, int *jip,
+				int *uip);
+void instruction_clear_branch_offsets(struct brw_instruction *inst);
+int instruction_branch_targets(struct brw_instruction *inst, int ip,
+			       int *targets);
+int instruction_successors(struct brw_instruction **insts, int n, int i,
+			   int *succ, int *kinds);
+int program_basic_blocks(struct brw_instruction **insts, int n,
+			 struct basic_block **blocks);
+void program_cfg(struct brw_instruction **insts, int n, struct cfg *cfg);
+void free_cfg(struct cfg *cfg);
+int program_instructions(struct brw_program *p,
+			 struct brw_instruction ***insts);
+FILE *open_report(const char *filename);
+void close_report(FILE *f);
+int reg_type_size(int reg_type);
+int grf_bank(int reg_nr);
+int three_src_bank_conflict(struct brw_instruction *inst);
+int reg_ranges_overlap(struct reg_range *a, struct reg_range *b);
+int reg_range_covers(struct reg_range *a, struct reg_range *b);
+void instruction_regs(struct brw_instruction *inst, struct inst_regs *regs);
+
+/* estimate.c */
+int instruction_issue_cycles(struct brw_instruction *inst);
+int instruction_latency(struct brw_instruction *inst);
+void estimate_cycles(FILE *out, struct brw_instruction **insts, int n,
+		     int json);
+int estimate_block_cycles(struct brw_instruction **insts,
+			  struct basic_block *block);
+int report_critical_paths(FILE *out, struct brw_program *p);
+
+/* cfg.c */
+void write_cfg(FILE *out, struct brw_instruction **insts, int n, int json);
+
+/* pressure.c */
+int report_register_pressure(FILE *out, struct brw_program *p);
+int program_payload_grfs(struct brw_instruction **insts, int n,
+			 char *payload);
+
+/* lint.c */
+int perf_warn_configure(const char *names);
+int check_performance(struct brw_program *p);
+
+/* dataport.c */
+enum dataport_cache {
+	DP_DATA_CACHE,
+	DP_DATA_CACHE1,
+	DP_RENDER_CACHE,
+	DP_SAMPLER_CACHE,
+	DP_CONSTANT_CACHE,
+	DP_CACHE_COUNT
+};
+
+enum dataport_message {
+	DP_OWORD_BLOCK_READ,
+	DP_UNALIGNED_OWORD_BLOCK_READ,
+	DP_OWORD_DUAL_BLOCK_READ,
+	DP_DWORD_BLOCK_READ,
+	DP_DWORD_SCATTERED_READ,
+	DP_BYTE_SCATTERED_READ,
+	DP_MEDIA_BLOCK_READ,
+	DP_UNTYPED_SURFACE_READ,
+	DP_TYPED_SURFACE_READ,
+	DP_OWORD_BLOCK_WRITE,
+	DP_OWORD_DUAL_BLOCK_WRITE,
+	DP_DWORD_BLOCK_WRITE,
+	DP_DWORD_SCATTERED_WRITE,
+	DP_BYTE_SCATTERED_WRITE,
+	DP_MEDIA_BLOCK_WRITE,
+	DP_UNTYPED_SURFACE_WRITE,
+	DP_TYPED_SURFACE_WRITE,
+	DP_RENDER_TARGET_WRITE,
+	DP_RENDER_TARGET_UNORM_WRITE,
+	DP_STREAMED_VB_WRITE,
+	DP_FLUSH_RENDER_CACHE,
+	DP_DWORD_ATOMIC_WRITE,
+	DP_UNTYPED_ATOMIC_OP,
+	DP_UNTYPED_ATOMIC_OP_SIMD4X2,
+	DP_TYPED_ATOMIC_OP,
+	DP_TYPED_ATOMIC_OP_SIMD4X2,
+	DP_ATOMIC_COUNTER_OP,
+	DP_ATOMIC_COUNTER_OP_SIMD4X2,
+	DP_MEMORY_FENCE,
+	DP_MESSAGE_COUNT
+};
+
+struct dataport_message_desc {
+	int message;		/* enum dataport_message */
+	int gen_min, gen_max;	/* gen_level range */
+	int caches;		/* 1 << enum dataport_cache it may go to */
+	int msg_type;
+	int write;		/* a Gen4/5 DATAPORT_WRITE message */
+};
+
+extern const char *dataport_cache_names[DP_CACHE_COUNT];
+extern const char *dataport_message_names[DP_MESSAGE_COUNT];
+
+const struct dataport_message_desc *dataport_message_lookup(int message,
+							    int *cache);
+const struct dataport_message_desc *dataport_message_decode(int cache,
+							    int write,
+							    int msg_type);
+int dataport_cache_sfid(int cache);
+int dataport_sfid_cache(int sfid);
+
+/* opcodes.c */
+enum opcode_format {
+	OPCODE_ALU,		/* destination and up to two sources */
+	OPCODE_MATH,		/* ALU, with the function in the condition field */
+	OPCODE_THREE_SRC,	/* align16 three-source layout */
+	OPCODE_SEND,		/* message register and descriptor */
+	OPCODE_BRANCH,		/* Gen6+ JIP and UIP */
+	OPCODE_NOP,
+};
+
+#define OPCODE_FLOW	(1 << 0)	/* may not fall through, or joins */
+
+struct opcode_desc {
+	const char *name;
+	int opcode;
+	int gen_min, gen_max;	/* gen_level range */
+	int nsrc, ndst;
+	enum opcode_format format;
+	unsigned int flags;
+	int noffsets;		/* jump distances written, for OPCODE_BRANCH */
+};
+
+const struct opcode_desc *opcode_desc(int opcode);
+const char *send_target_name(int target);
+int parse_gen_level(const char *arg);
+
+/* disasm-input.c */
+#define INST_SIZE	16	/* bytes of an encoded instruction */
+
+enum input_format {
+	INPUT_AUTO,
+	INPUT_RAW,	/* little-endian instruction words, as dumped by the GPU */
+	INPUT_WORDS,	/* { 0x..., 0x..., 0x..., 0x... }, from intel-gen4asm */
+	INPUT_BYTES,	/* 0x.., 0x.., ..., from intel-gen4asm -b */
+};
+
+char *load_input(int fd, size_t *size, int *mapped);
+enum input_format detect_input_format(const char *data, size_t size);
+uint32_t *parse_hex_text(const char *data, size_t size, int bytes, int *count);
+uint32_t *raw_instructions(char *data, size_t size, int *count);
+int lowest_bit(uint64_t v);
+
+/* Reads instructions as they arrive, keeping only STREAM_BUFFER bytes. */
+#define STREAM_BUFFER	65536
+
+struct input_stream {
+	int fd;
+	enum input_format format;
+	int eof;
+	size_t pos, len;
+	int part;		/* words or bytes of inst read so far */
+	uint32_t inst[INST_SIZE / 4];
+	char buf[STREAM_BUFFER];
+};
+
+void input_stream_init(struct input_stream *s, int fd, enum input_format format);
+struct brw_instruction *input_stream_next(struct input_stream *s);
+int input_stream_fill(struct input_stream *s);
+
+/* diff.c */
+void diff_align(const uint32_t *a, int na, const uint32_t *b, int nb,
+		int *a2b, int *b2a);
+
+/* search.c */
+#define SEARCH_BLOCK	64	/* instructions search_block() looks at */
+
+struct search_mask {
+	uint64_t mask[2];	/* the instruction's two halves, as in memory */
+	uint64_t value[2];
+};
+
+struct search_query {
+	int nmasks;		/* an instruction must match one of these */
+	struct search_mask *masks;
+	int nterms;		/* and all of these */
+	struct search_term *terms;
+};
+
+int search_compile(struct search_query *q, const char *text);
+void search_free(struct search_query *q);
+int search_block(const struct search_query *q, const uint32_t *insts,
+		 int n, int start, int *matches);
+
+/* verify.c */
+int verify_program(FILE *report, struct brw_program *p);
+
+/* optimize.c */
+#define IF_CONVERT_DEFAULT_LENGTH	4
+
+int is_internal_label(const char *name);
+int program_symbolize_branches(struct brw_program *p);
+int if_convert(struct brw_program *p, int max_arm_length);
+int simplify_arithmetic(struct brw_program *p);
+int propagate_payload_copies(struct brw_program *p);
+int fix_bank_conflicts(struct brw_program *p);
+int place_switch_hints(struct brw_program *p);
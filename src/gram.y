@@ -40,6 +40,7 @@ extern long int gen_level;
 extern int advanced_flag;
 extern int yylineno;
 extern int need_export;
+extern char *input_filename;
 static struct src_operand src_null_reg =
 {
     .reg_file = BRW_ARCHITECTURE_REGISTER_FILE,
@@ -91,10 +92,20 @@ void set_instruction_options(struct brw_instruction *instr,
 			     struct brw_instruction *options);
 void set_instruction_predicate(struct brw_instruction *instr,
 			       struct brw_instruction *predicate);
+static void set_wait_instruction(struct brw_instruction *instr,
+				 struct direct_reg *notify);
+static int lower_send_to_math(struct brw_instruction *instr,
+			      struct brw_instruction *msgtarget,
+			      struct dst_operand *dest,
+			      struct src_operand *payload, int mlen);
 void set_direct_dst_operand(struct dst_operand *dst, struct direct_reg *reg,
 			    int type);
 void set_direct_src_operand(struct src_operand *src, struct direct_reg *reg,
 			    int type);
+static int pack_immediate_vector(imm_vector_t *vec, int type, uint32_t *d);
+static int check_sampler_message(struct brw_instruction *instr);
+static int set_dataport_message(struct brw_instruction *msg, int cache,
+				int message, int bti, int control, int header);
 
 %}
 
@@ -113,6 +124,7 @@ void set_direct_src_operand(struct src_operand *src, struct direct_reg *reg,
 	struct condition condition;
 	struct declared_register symbol_reg;
 	imm32_t imm32;
+	imm_vector_t imm_vector;
 
 	struct dst_operand dst_operand;
 	struct src_operand src_operand;
@@ -129,7 +141,7 @@ void set_direct_src_operand(struct src_operand *src, struct direct_reg *reg,
 %token PLUS MINUS MULTIPLY DIVIDE
 
 %token <integer> TYPE_UD TYPE_D TYPE_UW TYPE_W TYPE_UB TYPE_B
-%token <integer> TYPE_VF TYPE_HF TYPE_V TYPE_F
+%token <integer> TYPE_VF TYPE_HF TYPE_V TYPE_UV TYPE_F
 
 %token ALIGN1 ALIGN16 SECHALF COMPR SWITCH ATOMIC NODDCHK NODDCLR
 %token MASK_DISABLE BREAKPOINT ACCWRCTRL EOT
@@ -158,6 +170,7 @@ void set_direct_src_operand(struct src_operand *src, struct direct_reg *reg,
 
 %token MSGLEN RETURNLEN
 %token <integer> ALLOCATE USED COMPLETE TRANSPOSE INTERLEAVE
+%token <integer> SIMD_MODE DP_CACHE DP_MESSAGE
 %token SATURATE
 
 %token <integer> INTEGER
@@ -206,7 +219,7 @@ void set_direct_src_operand(struct src_operand *src, struct direct_reg *reg,
 %type <integer> condition saturate negate abs chansel
 %type <integer> writemask_x writemask_y writemask_z writemask_w
 %type <integer> srcimmtype execsize dstregion immaddroffset
-%type <integer> subregnum sampler_datatype
+%type <integer> subregnum sampler_datatype dp_cache dp_header
 %type <integer> urb_swizzle urb_allocate urb_used urb_complete
 %type <integer> math_function math_signed math_scalar
 %type <integer> predctrl predstate
@@ -224,6 +237,7 @@ void set_direct_src_operand(struct src_operand *src, struct direct_reg *reg,
 /* %type <intger> maskstackdepth_subreg */
 %type <symbol_reg> symbol_reg symbol_reg_p;
 %type <imm32> imm32
+%type <imm_vector> immvector
 %type <dst_operand> dst dstoperand dstoperandex dstreg post_dst writemask
 %type <dst_operand> declare_base
 %type <src_operand> directsrcoperand srcarchoperandex directsrcaccoperand
@@ -317,8 +331,14 @@ declare_pragma:	DECLARE_PRAGMA STRING declare_base declare_elementsize declare_s
 ;
 
 reg_count_total_pragma: 	REG_COUNT_TOTAL_PRAGMA exp
+				{
+				    program_defaults.reg_count_total = $2;
+				}
 ;
 reg_count_payload_pragma: 	REG_COUNT_PAYLOAD_PRAGMA exp
+				{
+				    program_defaults.reg_count_payload = $2;
+				}
 ;
 
 default_exec_size_pragma:	DEFAULT_EXEC_SIZE_PRAGMA exp
@@ -347,6 +367,8 @@ instrseq:	instrseq pragma
 		  struct brw_program_instruction *list_entry =
 		    calloc(sizeof(struct brw_program_instruction), 1);
 		  list_entry->instruction = $2;
+		  list_entry->line = yylineno;
+		  list_entry->filename = input_filename;
 		  list_entry->next = NULL;
 		  if ($1.last) {
 			$1.last->next = list_entry;
@@ -361,6 +383,8 @@ instrseq:	instrseq pragma
 		  struct brw_program_instruction *list_entry =
 		    calloc(sizeof(struct brw_program_instruction), 1);
 		  list_entry->instruction = $1;
+		  list_entry->line = yylineno;
+		  list_entry->filename = input_filename;
 
 		  list_entry->next = NULL;
 
@@ -483,7 +507,7 @@ ifelseinstruction: ENDIF
 		    YYERROR;
 		  }
 		}
-		| predicate IF execsize relativelocation
+		| predicate IF execsize relativelocation instoptions
 		{
 		  /* for Gen4, Gen5 */
 		  /* The branch instructions require that the IP register
@@ -498,6 +522,7 @@ ifelseinstruction: ENDIF
 		    YYERROR;
 		  }
 		  memset(&$$, 0, sizeof($$));
+		  set_instruction_options(&$$, &$5);
 		  set_instruction_predicate(&$$, &$1);
 		  $$.header.opcode = $2;
 		  $$.header.execution_size = $3;
@@ -510,7 +535,7 @@ ifelseinstruction: ENDIF
 		  $$.first_reloc_target = $4.reloc_target;
 		  $$.first_reloc_offset = $4.imm32;
 		}
-		| predicate IF execsize relativelocation relativelocation
+		| predicate IF execsize relativelocation relativelocation instoptions
 		{
 		  /* for Gen7+ */
 		  if(!IS_GENp(7)) {
@@ -518,6 +543,7 @@ ifelseinstruction: ENDIF
 		    YYERROR;
 		  }
 		  memset(&$$, 0, sizeof($$));
+		  set_instruction_options(&$$, &$6);
 		  set_instruction_predicate(&$$, &$1);
 		  $$.header.opcode = $2;
 		  $$.header.execution_size = $3;
@@ -881,6 +907,10 @@ sendinstruction: predicate SEND execsize exp post_dst payload msgtarget
                       $$.bits3.generic_gen5.response_length = $11;
                       $$.bits3.generic_gen5.end_of_thread =
                           $12.bits3.generic_gen5.end_of_thread;
+
+                      if ($7.bits2.send_gen5.sfid == BRW_MESSAGE_TARGET_SAMPLER &&
+                          check_sampler_message(&$$) != 0)
+                          YYERROR;
 		  } else {
                       $$.header.sfid_destreg__conditionalmod = $4; /* msg reg index */
                       $$.bits3.generic = $7.bits3.generic;
@@ -889,6 +919,13 @@ sendinstruction: predicate SEND execsize exp post_dst payload msgtarget
                       $$.bits3.generic.end_of_thread =
                           $12.bits3.generic.end_of_thread;
 		  }
+
+		  if (IS_GENp(6) &&
+		      $7.bits2.send_gen5.sfid == BRW_MESSAGE_TARGET_MATH) {
+		    if (lower_send_to_math(&$$, &$7, &$5, &$6, $9) != 0)
+		      YYERROR;
+		    set_instruction_options(&$$, &$12);
+		  }
 		}
 		| predicate SEND execsize dst sendleadreg payload directsrcoperand instoptions
 		{
@@ -1075,7 +1112,7 @@ sndopr: exp %prec SNDOPR
 		}
 ;
 
-jumpinstruction: predicate JMPI execsize relativelocation2
+jumpinstruction: predicate JMPI execsize relativelocation2 instoptions
 		{
 		  /* The jump instruction requires that the IP register
 		   * be the destination and first source operand, while the
@@ -1083,6 +1120,7 @@ jumpinstruction: predicate JMPI execsize relativelocation2
 		   * is the post-incremented IP plus the offset.
 		   */
 		  memset(&$$, 0, sizeof($$));
+		  set_instruction_options(&$$, &$5);
 		  $$.header.opcode = $2;
 		  $$.header.execution_size = ffs(1) - 1;
 		  if(advanced_flag)
@@ -1137,19 +1175,24 @@ maskpushop:	MSAVE | PUSH
 
 syncinstruction: predicate WAIT notifyreg
 		{
-		  struct dst_operand notify_dst;
-		  struct src_operand notify_src;
-
 		  memset(&$$, 0, sizeof($$));
 		  $$.header.opcode = $2;
-		  $$.header.execution_size = ffs(1) - 1;
-		  set_direct_dst_operand(&notify_dst, &$3, BRW_REGISTER_TYPE_D);
-		  set_instruction_dest(&$$, &notify_dst);
-		  set_direct_src_operand(&notify_src, &$3, BRW_REGISTER_TYPE_D);
-		  set_instruction_src0(&$$, &notify_src);
-		  set_instruction_src1(&$$, &src_null_reg);
+		  set_wait_instruction(&$$, &$3);
+		}
+		/* As the disassembler prints it: wait(1) n0<0,1,0>D */
+		| predicate WAIT LPAREN exp RPAREN notifyreg
+		  LANGLE exp COMMA exp COMMA exp RANGLE regtype instoptions
+		{
+		  if ($4 != 1 || $8 != 0 || $10 != 1 || $12 != 0) {
+		    fprintf(stderr, "%d: wait takes a (1) n<0,1,0> operand\n",
+			    yylineno);
+		    YYERROR;
+		  }
+		  memset(&$$, 0, sizeof($$));
+		  $$.header.opcode = $2;
+		  set_wait_instruction(&$$, &$6);
+		  set_instruction_options(&$$, &$15);
 		}
-		
 ;
 
 nopinstruction: NOP
@@ -1159,7 +1202,18 @@ nopinstruction: NOP
 		};
 
 /* XXX! */
+/* Gen6 sends read the message from the MRF, and the disassembler
+ * prints it as such.
+ */
 payload: directsrcoperand
+		| directmsgreg region regtype
+		{
+		  set_direct_src_operand(&$$, &$1, $3.type);
+		  $$.vert_stride = $2.vert_stride;
+		  $$.width = $2.width;
+		  $$.horiz_stride = $2.horiz_stride;
+		  $$.default_region = $2.is_default;
+		}
 ;
 
 post_dst:	dst
@@ -1182,13 +1236,13 @@ msgtarget:	NULL_TOKEN
                       $$.bits3.generic_gen5.header_present = 1;   /* ??? */
                       $$.bits3.sampler_gen7.binding_table_index = $3;
                       $$.bits3.sampler_gen7.sampler = $5;
-                      $$.bits3.sampler_gen7.simd_mode = 2; /* SIMD16, maybe we should add a new parameter */
+                      $$.bits3.sampler_gen7.simd_mode = BRW_SAMPLER_SIMD_MODE_SIMD16;
 		  } else if (IS_GENp(5)) {
                       $$.bits2.send_gen5.sfid = BRW_MESSAGE_TARGET_SAMPLER;
                       $$.bits3.generic_gen5.header_present = 1;   /* ??? */
                       $$.bits3.sampler_gen5.binding_table_index = $3;
                       $$.bits3.sampler_gen5.sampler = $5;
-                      $$.bits3.sampler_gen5.simd_mode = 2; /* SIMD16, maybe we should add a new parameter */
+                      $$.bits3.sampler_gen5.simd_mode = BRW_SAMPLER_SIMD_MODE_SIMD16;
 		  } else {
                       $$.bits3.generic.msg_target = BRW_MESSAGE_TARGET_SAMPLER;	
                       $$.bits3.sampler.binding_table_index = $3;
@@ -1209,6 +1263,41 @@ msgtarget:	NULL_TOKEN
                       }
 		  }
 		}
+		| SAMPLER LPAREN INTEGER COMMA INTEGER COMMA
+		sampler_datatype COMMA INTEGER COMMA SIMD_MODE COMMA INTEGER RPAREN
+		{
+		  /* The message type, SIMD mode and header are explicit
+		   * here; the short form above always asks for a SIMD16
+		   * sample with a header.  Gen5+ samplers return 32-bit
+		   * data whatever the datatype says.
+		   */
+		  if (!IS_GENp(5)) {
+                      fprintf (stderr, "%d: sampler message type, SIMD mode and header need gen5 or later\n", yylineno);
+                      YYERROR;
+		  }
+		  if ($9 >= (IS_GENp(7) ? 32 : 16)) {
+                      fprintf (stderr, "%d: invalid sampler message type %d\n", yylineno, $9);
+                      YYERROR;
+		  }
+		  if ($13 != 0 && $13 != 1) {
+                      fprintf (stderr, "%d: sampler header present must be 0 or 1\n", yylineno);
+                      YYERROR;
+		  }
+		  memset(&$$, 0, sizeof($$));
+		  $$.bits2.send_gen5.sfid = BRW_MESSAGE_TARGET_SAMPLER;
+		  $$.bits3.generic_gen5.header_present = $13;
+		  if (IS_GENp(7)) {
+                      $$.bits3.sampler_gen7.binding_table_index = $3;
+                      $$.bits3.sampler_gen7.sampler = $5;
+                      $$.bits3.sampler_gen7.msg_type = $9;
+                      $$.bits3.sampler_gen7.simd_mode = $11;
+		  } else {
+                      $$.bits3.sampler_gen5.binding_table_index = $3;
+                      $$.bits3.sampler_gen5.sampler = $5;
+                      $$.bits3.sampler_gen5.msg_type = $9;
+                      $$.bits3.sampler_gen5.simd_mode = $11;
+		  }
+		}
 		| MATH math_function saturate math_signed math_scalar
 		{
 		  if (IS_GENp(6)) {
@@ -1237,6 +1326,19 @@ msgtarget:	NULL_TOKEN
                       $$.bits3.math.data_type = $5;
 		  }
 		}
+		| MATH_INST math_function saturate math_signed math_scalar
+		{
+		  /* Gen6+ lexes "math" as the native instruction.  The send
+		   * is turned into one by lower_send_to_math().
+		   */
+		  memset(&$$, 0, sizeof($$));
+		  $$.bits2.send_gen5.sfid = BRW_MESSAGE_TARGET_MATH;
+		  $$.bits3.math_gen5.function = $2;
+		  if ($3 == BRW_INSTRUCTION_SATURATE)
+		      $$.bits3.math_gen5.saturate = 1;
+		  $$.bits3.math_gen5.int_type = $4;
+		  $$.bits3.math_gen5.data_type = $5;
+		}
 		| GATEWAY
 		{
 		  if (IS_GENp(5)) {
@@ -1366,6 +1468,12 @@ msgtarget:	NULL_TOKEN
                       $$.bits3.dp_write.send_commit_msg = $9;
 		  }
 		}
+		| dp_cache DP_MESSAGE LPAREN INTEGER COMMA INTEGER dp_header RPAREN
+		{
+		  memset(&$$, 0, sizeof($$));
+		  if (set_dataport_message(&$$, $1, $2, $4, $6, $7) != 0)
+		    YYERROR;
+		}
 		| URB INTEGER urb_swizzle urb_allocate urb_used urb_complete
 		{
 		  $$.bits3.generic.msg_target = BRW_MESSAGE_TARGET_URB;
@@ -1499,6 +1607,14 @@ urb_swizzle:	TRANSPOSE { $$ = BRW_URB_SWIZZLE_TRANSPOSE; }
 		| /* empty */ { $$ = BRW_URB_SWIZZLE_NONE; }
 ;
 
+dp_cache:	/* empty */ { $$ = -1; }
+		| DP_CACHE
+;
+
+dp_header:	/* empty */ { $$ = 1; }
+		| COMMA INTEGER { $$ = $2; }
+;
+
 sampler_datatype:
 		TYPE_F
 		| TYPE_UD
@@ -1719,13 +1835,14 @@ imm32reg:	imm32 srcimmtype
 		  case BRW_REGISTER_TYPE_UD:
 		  case BRW_REGISTER_TYPE_D:
 		  case BRW_REGISTER_TYPE_V:
+		  case BRW_REGISTER_TYPE_UV:
 		  case BRW_REGISTER_TYPE_VF:
 		    switch ($1.r) {
 		    case imm32_d:
 		      d = $1.u.d;
 		      break;
 		    default:
-		      fprintf (stderr, "%d: non-int D/UD/V/VF representation: %d,type=%d\n", yylineno, $1.r, $2);
+		      fprintf (stderr, "%d: non-int D/UD/V/UV/VF representation: %d,type=%d\n", yylineno, $1.r, $2);
 		      YYERROR;
 		    }
 		    break;
@@ -1770,6 +1887,33 @@ imm32reg:	imm32 srcimmtype
 		  $$.reg_type = $2;
 		  $$.imm32 = d;
 		}
+		| LSQUARE immvector RSQUARE srcimmtype
+		{
+		  uint32_t d;
+
+		  if (pack_immediate_vector(&$2, $4, &d))
+		    YYERROR;
+		  memset (&$$, '\0', sizeof ($$));
+		  $$.reg_file = BRW_IMMEDIATE_VALUE;
+		  $$.reg_type = $4;
+		  $$.imm32 = d;
+		}
+;
+
+immvector:	imm32
+		{
+		  $$.count = 1;
+		  $$.elem[0] = $1;
+		}
+		| immvector COMMA imm32
+		{
+		  if ($1.count == 8) {
+		    fprintf (stderr, "%d: too many elements in immediate vector\n", yylineno);
+		    YYERROR;
+		  }
+		  $$ = $1;
+		  $$.elem[$$.count++] = $3;
+		}
 ;
 
 directsrcaccoperand:	directsrcoperand
@@ -2396,6 +2540,14 @@ srcimmtype:	/* empty */
 		| TYPE_UW { $$ = BRW_REGISTER_TYPE_UW; }
 		| TYPE_W { $$ = BRW_REGISTER_TYPE_W; }
 		| TYPE_V { $$ = BRW_REGISTER_TYPE_V; }
+		| TYPE_UV
+		{
+		  if (!IS_GENp(6)) {
+		    fprintf (stderr, "%d: UV immediates need gen6 or later\n", yylineno);
+		    YYERROR;
+		  }
+		  $$ = BRW_REGISTER_TYPE_UV;
+		}
 		| TYPE_VF { $$ = BRW_REGISTER_TYPE_VF; }
 ;
 
@@ -3064,7 +3216,11 @@ static int reg_type_2_to_3(int reg_type)
 int set_instruction_dest_three_src(struct brw_instruction *instr,
                                    struct dst_operand *dest)
 {
-	instr->bits1.three_src_gen6.dest_reg_file = dest->reg_file;
+	/* Gen6 picks between the GRF (0) and the MRF (1); Gen7 only
+	 * writes the GRF and leaves the bit reserved.
+	 */
+	instr->bits1.three_src_gen6.dest_reg_file = IS_GENx(6) &&
+		dest->reg_file == BRW_MESSAGE_REGISTER_FILE;
 	instr->bits1.three_src_gen6.dest_reg_nr = dest->reg_nr;
 	instr->bits1.three_src_gen6.dest_subreg_nr = get_subreg_address(dest->reg_file, dest->reg_type, dest->subreg_nr, dest->address_mode) / 4; // in DWORD
 	instr->bits1.three_src_gen6.dest_writemask = dest->writemask;
@@ -3072,14 +3228,52 @@ int set_instruction_dest_three_src(struct brw_instruction *instr,
 	return 0;
 }
 
+/* Three-source operands are direct GRFs addressed in dwords, with a
+ * 2-bit source modifier, an align16 swizzle and a replicate control that
+ * broadcasts the scalar at subreg_nr to every channel, asked for with a
+ * <0,1,0> region.
+ */
+static int check_three_src_operand(struct src_operand *src)
+{
+	if (src->reg_file != BRW_GENERAL_REGISTER_FILE ||
+	    src->address_mode != BRW_ADDRESS_DIRECT) {
+		fprintf(stderr, "error: three-source operands must be "
+			"direct GRF registers\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int three_src_modifier(struct src_operand *src)
+{
+	return (src->negate ? BRW_3SRC_MODIFIER_NEGATE : 0) |
+		(src->abs ? BRW_3SRC_MODIFIER_ABS : 0);
+}
+
+static int three_src_swizzle(struct src_operand *src)
+{
+	return src->swizzle_x | src->swizzle_y << 2 |
+		src->swizzle_z << 4 | src->swizzle_w << 6;
+}
+
+static int three_src_rep_ctrl(struct src_operand *src)
+{
+	return !src->default_region &&
+		src->vert_stride == BRW_VERTICAL_STRIDE_0;
+}
+
 int set_instruction_src0_three_src(struct brw_instruction *instr,
                                    struct src_operand *src)
 {
 	if (advanced_flag) {
 		reset_instruction_src_region(instr, src);
 	}
-	// TODO: supporting src0 swizzle, src0 modifier, src0 rep_ctrl
+	if (check_three_src_operand(src))
+		return 1;
 	instr->bits1.three_src_gen6.src_reg_type = reg_type_2_to_3(src->reg_type);
+	instr->bits1.three_src_gen6.src0_modifier = three_src_modifier(src);
+	instr->bits2.three_src_gen6.src0_rep_ctrl = three_src_rep_ctrl(src);
+	instr->bits2.three_src_gen6.src0_swizzle = three_src_swizzle(src);
 	instr->bits2.three_src_gen6.src0_subreg_nr = get_subreg_address(src->reg_file, src->reg_type, src->subreg_nr, src->address_mode) / 4; // in DWORD
 	instr->bits2.three_src_gen6.src0_reg_nr = src->reg_nr;
 	return 0;
@@ -3091,8 +3285,12 @@ int set_instruction_src1_three_src(struct brw_instruction *instr,
 	if (advanced_flag) {
 		reset_instruction_src_region(instr, src);
 	}
-	// TODO: supporting src1 swizzle, src1 modifier, src1 rep_ctrl
+	if (check_three_src_operand(src))
+		return 1;
 	int v = get_subreg_address(src->reg_file, src->reg_type, src->subreg_nr, src->address_mode) / 4; // in DWORD
+	instr->bits1.three_src_gen6.src1_modifier = three_src_modifier(src);
+	instr->bits2.three_src_gen6.src1_rep_ctrl = three_src_rep_ctrl(src);
+	instr->bits2.three_src_gen6.src1_swizzle = three_src_swizzle(src);
 	instr->bits2.three_src_gen6.src1_subreg_nr_low = v % 4; // lower 2 bits
 	instr->bits3.three_src_gen6.src1_subreg_nr_high = v / 4; // highest bit
 	instr->bits3.three_src_gen6.src1_reg_nr = src->reg_nr;
@@ -3105,7 +3303,11 @@ int set_instruction_src2_three_src(struct brw_instruction *instr,
 	if (advanced_flag) {
 		reset_instruction_src_region(instr, src);
 	}
-	// TODO: supporting src2 swizzle, src2 modifier, src2 rep_ctrl
+	if (check_three_src_operand(src))
+		return 1;
+	instr->bits1.three_src_gen6.src2_modifier = three_src_modifier(src);
+	instr->bits3.three_src_gen6.src2_rep_ctrl = three_src_rep_ctrl(src);
+	instr->bits3.three_src_gen6.src2_swizzle = three_src_swizzle(src);
 	instr->bits3.three_src_gen6.src2_subreg_nr = get_subreg_address(src->reg_file, src->reg_type, src->subreg_nr, src->address_mode) / 4; // in DWORD
 	instr->bits3.three_src_gen6.src2_reg_nr = src->reg_nr;
 	return 0;
@@ -3120,6 +3322,8 @@ void set_instruction_options(struct brw_instruction *instr,
 	instr->header.dependency_control = options->header.dependency_control;
 	instr->header.compression_control =
 		options->header.compression_control;
+	/* Branches already ask for a switch themselves. */
+	instr->header.thread_control |= options->header.thread_control;
 }
 
 void set_instruction_predicate(struct brw_instruction *instr,
@@ -3131,6 +3335,205 @@ void set_instruction_predicate(struct brw_instruction *instr,
 	instr->bits2.da1.flag_subreg_nr = predicate->bits2.da1.flag_subreg_nr;
 }
 
+/* Gen5+ sampler messages return up to four channels of 32-bit data, one
+ * register per channel for every eight pixels.  Returns 0 if mlen and
+ * rlen fit the SIMD mode.
+ */
+static int check_sampler_message(struct brw_instruction *instr)
+{
+	static const struct {
+		const char *name;
+		int max_rlen;
+	} modes[] = {
+		[BRW_SAMPLER_SIMD_MODE_SIMD4X2] = { "SIMD4x2", 1 },
+		[BRW_SAMPLER_SIMD_MODE_SIMD8] = { "SIMD8", 4 },
+		[BRW_SAMPLER_SIMD_MODE_SIMD16] = { "SIMD16", 8 },
+		[BRW_SAMPLER_SIMD_MODE_SIMD32_64] = { "SIMD32/64", 16 },
+	};
+	int simd_mode, mlen, rlen;
+
+	if (IS_GENp(7))
+		simd_mode = instr->bits3.sampler_gen7.simd_mode;
+	else
+		simd_mode = instr->bits3.sampler_gen5.simd_mode;
+	mlen = instr->bits3.generic_gen5.msg_length;
+	rlen = instr->bits3.generic_gen5.response_length;
+
+	if (rlen > modes[simd_mode].max_rlen) {
+		fprintf(stderr, "%d: a %s sampler message returns at most %d "
+			"registers, not rlen %d\n", yylineno,
+			modes[simd_mode].name, modes[simd_mode].max_rlen, rlen);
+		return 1;
+	}
+	if (mlen == 0) {
+		fprintf(stderr, "%d: sampler message needs a header or a "
+			"payload, not mlen 0\n", yylineno);
+		return 1;
+	}
+	return 0;
+}
+
+/* Encodes a named data port message: cache is the enum dataport_cache the
+ * message goes to, or -1 for its default one, and control the message
+ * specific bits, such as the block size.  Returns 0 on success.
+ */
+static int set_dataport_message(struct brw_instruction *msg, int cache,
+				int message, int bti, int control, int header)
+{
+	const struct dataport_message_desc *desc;
+	int max_control = IS_GENp(7) ? 63 : IS_GENp(6) ? 31 : 15;
+
+	desc = dataport_message_lookup(message, &cache);
+	if (!desc) {
+		if (cache < 0)
+			fprintf(stderr, "%d: %s isn't a data port message on "
+				"this generation\n", yylineno,
+				dataport_message_names[message]);
+		else
+			fprintf(stderr, "%d: %s can't go to the %s on this "
+				"generation\n", yylineno,
+				dataport_message_names[message],
+				dataport_cache_names[cache]);
+		return 1;
+	}
+	if (bti > 255) {
+		fprintf(stderr, "%d: invalid binding table index %d\n",
+			yylineno, bti);
+		return 1;
+	}
+	if (control > max_control) {
+		fprintf(stderr, "%d: data port message control %d doesn't "
+			"fit in %d bits\n", yylineno, control,
+			IS_GENp(7) ? 6 : IS_GENp(6) ? 5 : 4);
+		return 1;
+	}
+	if (header != 0 && header != 1) {
+		fprintf(stderr, "%d: data port header present must be 0 or 1\n",
+			yylineno);
+		return 1;
+	}
+	if (!header && !IS_GENp(5)) {
+		fprintf(stderr, "%d: headerless data port messages need gen5 "
+			"or later\n", yylineno);
+		return 1;
+	}
+
+	if (IS_GENp(7)) {
+		msg->bits2.send_gen5.sfid = dataport_cache_sfid(cache);
+		msg->bits3.generic_gen5.header_present = header;
+		msg->bits3.dp_gen7.binding_table_index = bti;
+		msg->bits3.dp_gen7.msg_control = control;
+		msg->bits3.dp_gen7.msg_type = desc->msg_type;
+	} else if (IS_GENp(6)) {
+		msg->bits2.send_gen5.sfid = dataport_cache_sfid(cache);
+		msg->bits3.generic_gen5.header_present = header;
+		msg->bits3.dp_gen6.binding_table_index = bti;
+		msg->bits3.dp_gen6.msg_control = control;
+		msg->bits3.dp_gen6.msg_type = desc->msg_type;
+	} else if (desc->write) {
+		/* As with "write (...)", the top control bit is the pixel
+		 * scoreboard clear.
+		 */
+		if (IS_GENx(5)) {
+			msg->bits2.send_gen5.sfid = BRW_MESSAGE_TARGET_DATAPORT_WRITE;
+			msg->bits3.generic_gen5.header_present = header;
+		} else {
+			msg->bits3.generic.msg_target = BRW_MESSAGE_TARGET_DATAPORT_WRITE;
+		}
+		msg->bits3.dp_write.binding_table_index = bti;
+		msg->bits3.dp_write.pixel_scoreboard_clear = (control & 0x8) >> 3;
+		msg->bits3.dp_write.msg_control = control & 0x7;
+		msg->bits3.dp_write.msg_type = desc->msg_type;
+	} else {
+		if (IS_GENx(5)) {
+			msg->bits2.send_gen5.sfid = BRW_MESSAGE_TARGET_DATAPORT_READ;
+			msg->bits3.generic_gen5.header_present = header;
+		} else {
+			msg->bits3.generic.msg_target = BRW_MESSAGE_TARGET_DATAPORT_READ;
+		}
+		msg->bits3.dp_read.binding_table_index = bti;
+		msg->bits3.dp_read.target_cache =
+			cache == DP_RENDER_CACHE ? BRW_DATAPORT_READ_TARGET_RENDER_CACHE :
+			cache == DP_SAMPLER_CACHE ? BRW_DATAPORT_READ_TARGET_SAMPLER_CACHE :
+			BRW_DATAPORT_READ_TARGET_DATA_CACHE;
+		msg->bits3.dp_read.msg_control = control;
+		msg->bits3.dp_read.msg_type = desc->msg_type;
+	}
+	return 0;
+}
+
+/* Gen6+ has no math shared function, so "send ... math" from Gen4/5
+ * kernels is rewritten into the in-EU math instruction: the response
+ * register becomes the destination and the payload the first source.
+ * Returns 0 on success.
+ */
+static int lower_send_to_math(struct brw_instruction *instr,
+			      struct brw_instruction *msgtarget,
+			      struct dst_operand *dest,
+			      struct src_operand *payload, int mlen)
+{
+	struct brw_instruction send = *instr;
+	struct src_operand src1 = src_null_reg;
+	int function = msgtarget->bits3.math_gen5.function;
+
+	switch (function) {
+	case BRW_MATH_FUNCTION_INV:
+	case BRW_MATH_FUNCTION_LOG:
+	case BRW_MATH_FUNCTION_EXP:
+	case BRW_MATH_FUNCTION_SQRT:
+	case BRW_MATH_FUNCTION_RSQ:
+	case BRW_MATH_FUNCTION_SIN:
+	case BRW_MATH_FUNCTION_COS:
+		break;
+	default:
+		fprintf(stderr, "%d: send to math function %d can't be "
+			"converted to a Gen6+ math instruction\n",
+			yylineno, function);
+		return 1;
+	}
+
+	if (mlen != 1) {
+		fprintf(stderr, "%d: send to math with mlen %d can't be "
+			"converted to a Gen6+ math instruction\n",
+			yylineno, mlen);
+		return 1;
+	}
+
+	if (payload->reg_file != BRW_GENERAL_REGISTER_FILE) {
+		fprintf(stderr, "%d: send to math needs a GRF payload to be "
+			"converted to a Gen6+ math instruction\n", yylineno);
+		return 1;
+	}
+
+	memset(instr, 0, sizeof(*instr));
+	instr->header.opcode = BRW_OPCODE_MATH;
+	instr->header.execution_size = send.header.execution_size;
+	instr->header.sfid_destreg__conditionalmod = function;
+	instr->header.saturate = msgtarget->bits3.math_gen5.saturate;
+	set_instruction_predicate(instr, &send);
+	if (set_instruction_dest(instr, dest) != 0)
+		return 1;
+	if (set_instruction_src0(instr, payload) != 0)
+		return 1;
+	/* Keep the null register's own type, as "null" assembles to. */
+	return set_instruction_src1(instr, &src1);
+}
+
+/* wait reads and writes the notification register it waits on. */
+static void set_wait_instruction(struct brw_instruction *instr,
+				 struct direct_reg *notify)
+{
+	struct dst_operand notify_dst;
+	struct src_operand notify_src;
+
+	instr->header.execution_size = ffs(1) - 1;
+	set_direct_dst_operand(&notify_dst, notify, BRW_REGISTER_TYPE_D);
+	set_instruction_dest(instr, &notify_dst);
+	set_direct_src_operand(&notify_src, notify, BRW_REGISTER_TYPE_D);
+	set_instruction_src0(instr, &notify_src);
+	set_instruction_src1(instr, &src_null_reg);
+}
+
 void set_direct_dst_operand(struct dst_operand *dst, struct direct_reg *reg,
 			    int type)
 {
@@ -3165,3 +3568,92 @@ void set_direct_src_operand(struct src_operand *src, struct direct_reg *reg,
 	src->swizzle_z = BRW_CHANNEL_Z;
 	src->swizzle_w = BRW_CHANNEL_W;
 }
+
+/* Restricted 8-bit float of VF immediates: a sign bit, a 3-bit exponent
+ * biased by 3 and a 4-bit mantissa.  Returns -1 if f can't be written
+ * exactly that way.
+ */
+static int float_to_vf(float f)
+{
+	union {
+		float f;
+		uint32_t u;
+	} fu;
+	uint32_t exponent, vf;
+
+	fu.f = f;
+	if (f == 0.0f)
+		return (fu.u >> 31) << 7;
+
+	exponent = ((fu.u >> 23) & 0xff) - (127 - 3);
+	vf = (fu.u >> 31) << 7 | exponent << 4 | ((fu.u >> 19) & 0xf);
+	if (exponent > 7 || (fu.u & 0x7ffff) || (vf & 0x7f) == 0)
+		return -1;
+	return vf;
+}
+
+/* Packs eight 4-bit integers for V and UV or four restricted floats for
+ * VF into the 32 bits of an immediate.  Returns 0 on success.
+ */
+static int pack_immediate_vector(imm_vector_t *vec, int type, uint32_t *d)
+{
+	const char *name;
+	int i, count, v;
+
+	switch (type) {
+	case BRW_REGISTER_TYPE_V:
+		name = "V";
+		count = 8;
+		break;
+	case BRW_REGISTER_TYPE_UV:
+		name = "UV";
+		count = 8;
+		break;
+	case BRW_REGISTER_TYPE_VF:
+		name = "VF";
+		count = 4;
+		break;
+	default:
+		fprintf(stderr, "%d: immediate vector needs a V, UV or VF type\n",
+			yylineno);
+		return 1;
+	}
+	if (vec->count != count) {
+		fprintf(stderr, "%d: immediate vector of type %s needs %d "
+			"elements, not %d\n", yylineno, name, count,
+			vec->count);
+		return 1;
+	}
+
+	*d = 0;
+	for (i = 0; i < count; i++) {
+		imm32_t *e = &vec->elem[i];
+
+		if (type == BRW_REGISTER_TYPE_VF) {
+			float f = e->r == imm32_f ? e->u.f : e->u.signed_d;
+
+			v = float_to_vf(f);
+			if (v < 0) {
+				fprintf(stderr, "%d: %g can't be represented "
+					"in a VF immediate\n", yylineno, f);
+				return 1;
+			}
+			*d |= v << (i * 8);
+			continue;
+		}
+
+		if (e->r != imm32_d) {
+			fprintf(stderr, "%d: non-int element in %s "
+				"immediate\n", yylineno, name);
+			return 1;
+		}
+		v = e->u.signed_d;
+		if (type == BRW_REGISTER_TYPE_V ? v < -8 || v > 7 : v < 0 || v > 15) {
+			fprintf(stderr, "%d: %d doesn't fit in a %s immediate "
+				"element\n", yylineno, v, name);
+			return 1;
+		}
+		*d |= (v & 0xf) << (i * 4);
+	}
+	return 0;
+}
@@ -0,0 +1,151 @@
+/* -*- c-basic-offset: 8 -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Compares parse_hex_text() with the getc()/fscanf() readers the
+ * disassembler used to have, on the word and byte arrays intel-gen4asm
+ * writes.  Built with "make hex-bench"; not installed.
+ *
+ *	hex-bench [instructions]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gen4asm.h"
+
+long int gen_level = 40;
+
+/* The old readers, storing into an array rather than a list to be fair
+ * to them.
+ */
+static int fscanf_words(FILE *input, uint32_t *insts)
+{
+	int c, n = 0;
+
+	while ((c = getc(input)) != EOF)
+		if (c == '0' && fscanf(input, "x%x", &insts[n]) == 1)
+			n++;
+	return n / 4;
+}
+
+static int fscanf_bytes(FILE *input, uint32_t *insts)
+{
+	unsigned int temp;
+	int c, n = 0;
+
+	while ((c = getc(input)) != EOF)
+		if (c == '0' && fscanf(input, "x%2x", &temp) == 1)
+			((uint8_t *)insts)[n++] = temp;
+	return n / INST_SIZE;
+}
+
+static char *format_text(uint32_t *insts, int n, int bytes, size_t *size)
+{
+	char *text = malloc((size_t)n * 128 + 64), *p = text;
+	uint8_t *b = (uint8_t *)insts;
+	int i, j;
+
+	if (bytes) {
+		p += sprintf(p, "static const char gen_eu_bytes[] = {\n");
+		for (i = 0; i < n * INST_SIZE; i += 8) {
+			*p++ = '\t';
+			for (j = 0; j < 8; j++)
+				p += sprintf(p, "0x%02x,%s", b[i + j],
+					     j == 7 ? "\n" : " ");
+		}
+		p += sprintf(p, "};\n");
+	} else {
+		for (i = 0; i < n; i++)
+			p += sprintf(p, "   { 0x%08x, 0x%08x, 0x%08x, 0x%08x },\n",
+				     insts[i * 4], insts[i * 4 + 1],
+				     insts[i * 4 + 2], insts[i * 4 + 3]);
+	}
+	*size = p - text;
+	return text;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int bench(const char *name, uint32_t *ref, int n, int bytes)
+{
+	uint32_t *old = malloc((size_t)n * INST_SIZE), *new;
+	size_t size;
+	char *text = format_text(ref, n, bytes, &size);
+	FILE *input = fmemopen(text, size, "r");
+	double t0, t1, t2;
+	int n_old, n_new, ok;
+
+	t0 = now();
+	n_old = bytes ? fscanf_bytes(input, old) : fscanf_words(input, old);
+	t1 = now();
+	new = parse_hex_text(text, size, bytes, &n_new);
+	t2 = now();
+
+	ok = n_old == n && n_new == n &&
+		!memcmp(old, ref, (size_t)n * INST_SIZE) &&
+		!memcmp(new, ref, (size_t)n * INST_SIZE);
+	printf("%s: %.1f MB, fscanf %.3f s (%.0f MB/s), "
+	       "parse_hex_text %.3f s (%.0f MB/s), %.1fx%s\n",
+	       name, size / 1e6, t1 - t0, size / 1e6 / (t1 - t0),
+	       t2 - t1, size / 1e6 / (t2 - t1), (t1 - t0) / (t2 - t1),
+	       ok ? "" : ", MISMATCH");
+
+	fclose(input);
+	free(new);
+	free(old);
+	free(text);
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	int n = argc > 1 ? atoi(argv[1]) : 200000;
+	uint32_t *ref;
+	int i, ok;
+
+	if (n <= 0) {
+		fprintf(stderr, "usage: hex-bench [instructions]\n");
+		exit(1);
+	}
+
+	ref = malloc((size_t)n * INST_SIZE);
+	srand(1);
+	for (i = 0; i < n * INST_SIZE / 4; i++)
+		ref[i] = (uint32_t)rand() << 16 ^ rand();
+
+	ok = bench("words", ref, n, 0);
+	ok &= bench("bytes", ref, n, 1);
+	free(ref);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,324 @@
+/* -*- c-basic-offset: 8 -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+/*
+ * Performance lint: encodings that assemble fine but that the hardware
+ * splits into several instructions or executes at reduced rate.
+ *
+ * Each rule checks one instruction as the parser encoded it, and warns
+ * with its source location.  Rules are enabled together by --perf-warn
+ * and can be picked or suppressed one by one by name.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "gen4asm.h"
+
+#define REG_SIZE	32
+
+struct perf_rule {
+	const char *name;
+	const char *description;
+	void (*check)(struct perf_rule *rule,
+		      struct brw_program_instruction *entry);
+	int enabled;
+};
+
+static int perf_warnings;
+
+static void warn(struct perf_rule *rule,
+		      struct brw_program_instruction *entry,
+		      const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s:%d: perf-warn: ", entry->filename, entry->line);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, " [%s]\n", rule->name);
+	perf_warnings++;
+}
+
+static int is_send(struct brw_instruction *inst)
+{
+	return inst->header.opcode == BRW_OPCODE_SEND ||
+		inst->header.opcode == BRW_OPCODE_SENDC;
+}
+
+static int is_null(int file, int nr)
+{
+	return file == BRW_ARCHITECTURE_REGISTER_FILE && nr == BRW_ARF_NULL;
+}
+
+/* A register region reaching into more registers than its size needs
+ * crosses a register boundary, and one spanning more than two registers
+ * can't be read in one go; either way the instruction is split.
+ */
+static void check_region_split(struct perf_rule *rule,
+			       struct brw_program_instruction *entry)
+{
+	struct brw_instruction *inst = &entry->instruction;
+	struct inst_regs regs;
+	struct reg_range *ranges[INST_MAX_DEFS + INST_MAX_USES];
+	int i, n = 0;
+
+	if (is_send(inst) || instruction_is_control_flow(inst))
+		return;
+
+	instruction_regs(inst, &regs);
+	for (i = 0; i < regs.ndefs; i++)
+		ranges[n++] = &regs.defs[i];
+	for (i = 0; i < regs.nuses; i++)
+		ranges[n++] = &regs.uses[i];
+
+	for (i = 0; i < n; i++) {
+		struct reg_range *r = ranges[i];
+		int first = r->start / REG_SIZE;
+		int spanned = (r->end - 1) / REG_SIZE - first + 1;
+		int needed = (r->end - r->start + REG_SIZE - 1) / REG_SIZE;
+		char file = r->file == BRW_MESSAGE_REGISTER_FILE ? 'm' : 'g';
+
+		if (r->file != BRW_GENERAL_REGISTER_FILE &&
+		    r->file != BRW_MESSAGE_REGISTER_FILE)
+			continue;
+
+		if (spanned > 2)
+			warn(rule, entry, "%s region at %c%d.%d spans %d "
+				  "registers", i < regs.ndefs ? "destination" :
+				  "source", file, first, r->start % REG_SIZE,
+				  spanned);
+		else if (spanned > needed)
+			warn(rule, entry, "%s region at %c%d.%d crosses "
+				  "a register boundary", i < regs.ndefs ?
+				  "destination" : "source", file, first,
+				  r->start % REG_SIZE);
+	}
+}
+
+static int is_float_type(int file, int type)
+{
+	if (type == BRW_REGISTER_TYPE_F)
+		return 1;
+	return file == BRW_IMMEDIATE_VALUE && type == BRW_REGISTER_TYPE_VF;
+}
+
+/* Operations on float and integer operands together pay for a
+ * conversion.  mov is exempt, being how conversions are written.
+ */
+static void check_mixed_types(struct perf_rule *rule,
+			      struct brw_program_instruction *entry)
+{
+	struct brw_instruction *inst = &entry->instruction;
+	int files[3], types[3], nr[3];
+	int i, n = 0, nfloat = 0;
+
+	switch (inst->header.opcode) {
+	case BRW_OPCODE_MOV:
+	case BRW_OPCODE_SEND:
+	case BRW_OPCODE_SENDC:
+	case BRW_OPCODE_NOP:
+		return;
+	}
+	if (instruction_is_control_flow(inst) ||
+	    instruction_is_three_src(inst))
+		return;
+
+	files[n] = inst->bits1.da1.dest_reg_file;
+	types[n] = inst->bits1.da1.dest_reg_type;
+	nr[n++] = inst->bits1.da1.dest_reg_nr;
+	files[n] = inst->bits1.da1.src0_reg_file;
+	types[n] = inst->bits1.da1.src0_reg_type;
+	nr[n++] = inst->bits2.da1.src0_reg_nr;
+	if (inst->bits1.da1.src0_reg_file != BRW_IMMEDIATE_VALUE) {
+		files[n] = inst->bits1.da1.src1_reg_file;
+		types[n] = inst->bits1.da1.src1_reg_type;
+		nr[n] = files[n] == BRW_IMMEDIATE_VALUE ? 0 :
+			inst->bits3.da1.src1_reg_nr;
+		n++;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (files[i] != BRW_IMMEDIATE_VALUE && is_null(files[i], nr[i])) {
+			files[i] = -1;
+			continue;
+		}
+		nfloat += is_float_type(files[i], types[i]);
+	}
+	for (i = 0; i < n; i++)
+		if (files[i] >= 0 &&
+		    is_float_type(files[i], types[i]) != (nfloat > 0)) {
+			warn(rule, entry, "float and integer operands "
+				  "are mixed");
+			return;
+		}
+}
+
+/* A strided destination that doesn't start a register is written in
+ * pieces.
+ */
+static void check_dst_stride(struct perf_rule *rule,
+			     struct brw_program_instruction *entry)
+{
+	struct brw_instruction *inst = &entry->instruction;
+	static const int hstride[4] = { 0, 1, 2, 4 };
+	int stride = hstride[inst->bits1.da1.dest_horiz_stride];
+
+	if (inst->header.access_mode != BRW_ALIGN_1 ||
+	    inst->bits1.da1.dest_address_mode != BRW_ADDRESS_DIRECT ||
+	    is_send(inst) || instruction_is_three_src(inst))
+		return;
+	if (is_null(inst->bits1.da1.dest_reg_file,
+		    inst->bits1.da1.dest_reg_nr))
+		return;
+
+	if (stride > 1 && inst->bits1.da1.dest_subreg_nr != 0)
+		warn(rule, entry, "destination with stride %d at "
+			  "subregister %d is not register aligned", stride,
+			  inst->bits1.da1.dest_subreg_nr);
+}
+
+/* SIMD16 instructions the hardware runs as two SIMD8 halves or more. */
+static void check_simd16_split(struct perf_rule *rule,
+			       struct brw_program_instruction *entry)
+{
+	struct brw_instruction *inst = &entry->instruction;
+
+	if (inst->header.execution_size != BRW_EXECUTE_16)
+		return;
+
+	if (inst->header.opcode == BRW_OPCODE_MATH && IS_GENp(6))
+		warn(rule, entry, "SIMD16 math runs as two SIMD8 "
+			  "halves");
+	else if (inst->header.access_mode == BRW_ALIGN_16 &&
+		 !is_send(inst) && !instruction_is_control_flow(inst))
+		warn(rule, entry, "SIMD16 align16 instruction runs as "
+			  "two SIMD8 halves");
+}
+
+/* Gen7 reads src1 and src2 of a three-source instruction in one go
+ * only from different banks.
+ */
+static void check_bank_conflict(struct perf_rule *rule,
+				struct brw_program_instruction *entry)
+{
+	struct brw_instruction *inst = &entry->instruction;
+
+	if (three_src_bank_conflict(inst))
+		warn(rule, entry, "src1 g%d and src2 g%d are in the same "
+		     "register bank", inst->bits3.three_src_gen6.src1_reg_nr,
+		     inst->bits3.three_src_gen6.src2_reg_nr);
+}
+
+static struct perf_rule perf_rules[] = {
+	{ "region-split", "register regions crossing or spanning registers",
+	  check_region_split },
+	{ "mixed-types", "float and integer operands in one operation",
+	  check_mixed_types },
+	{ "dst-stride", "unaligned strided destinations", check_dst_stride },
+	{ "simd16-split", "SIMD16 instructions executed as SIMD8 halves",
+	  check_simd16_split },
+	{ "bank-conflict", "Gen7 three-source operands in one register bank",
+	  check_bank_conflict },
+};
+
+#define NUM_PERF_RULES	(sizeof(perf_rules) / sizeof(perf_rules[0]))
+
+/**
+ * Enables the performance rules named in a comma separated list, "all"
+ * meaning every rule.  Names prefixed with "no-" suppress a rule, from
+ * all rules if the list starts with one.  NULL enables all rules.
+ *
+ * Returns -1, after listing the rules, if a name is unknown.
+ */
+int perf_warn_configure(const char *names)
+{
+	char *list, *name, *save;
+	unsigned int i;
+	int enable, err = 0;
+
+	if (names == NULL || strstr(names, "no-") == names) {
+		for (i = 0; i < NUM_PERF_RULES; i++)
+			perf_rules[i].enabled = 1;
+		if (names == NULL)
+			return 0;
+	}
+
+	list = strdup(names);
+	for (name = strtok_r(list, ",", &save); name;
+	     name = strtok_r(NULL, ",", &save)) {
+		enable = strncmp(name, "no-", 3) != 0;
+		if (!enable)
+			name += 3;
+
+		for (i = 0; i < NUM_PERF_RULES; i++)
+			if (strcmp(name, "all") == 0 ||
+			    strcmp(name, perf_rules[i].name) == 0)
+				perf_rules[i].enabled = enable;
+		if (strcmp(name, "all") == 0)
+			continue;
+
+		for (i = 0; i < NUM_PERF_RULES; i++)
+			if (strcmp(name, perf_rules[i].name) == 0)
+				break;
+		if (i == NUM_PERF_RULES) {
+			fprintf(stderr, "unknown perf-warn rule '%s'\n", name);
+			err = -1;
+		}
+	}
+	free(list);
+
+	if (err) {
+		fprintf(stderr, "rules:\n");
+		for (i = 0; i < NUM_PERF_RULES; i++)
+			fprintf(stderr, "\t%-16s %s\n", perf_rules[i].name,
+				perf_rules[i].description);
+	}
+	return err;
+}
+
+/**
+ * Runs the enabled performance rules over every instruction of the
+ * program.  Returns the number of warnings.
+ */
+int check_performance(struct brw_program *p)
+{
+	struct brw_program_instruction *entry;
+	unsigned int i;
+
+	perf_warnings = 0;
+	for (entry = p->first; entry; entry = entry->next) {
+		if (entry->islabel)
+			continue;
+		for (i = 0; i < NUM_PERF_RULES; i++)
+			if (perf_rules[i].enabled)
+				perf_rules[i].check(&perf_rules[i], entry);
+	}
+	return perf_warnings;
+}
@@ -69,6 +69,22 @@ struct label_item {
 };
 static struct label_item *label_table;
 
+enum {
+	OPT_IF_CONVERT = 256,
+	OPT_SIMPLIFY_ARITH,
+	OPT_COPY_PROP,
+	OPT_ESTIMATE,
+	OPT_ESTIMATE_JSON,
+	OPT_REG_PRESSURE,
+	OPT_CFG_DOT,
+	OPT_CFG_JSON,
+	OPT_CRITICAL_PATH,
+	OPT_PERF_WARN,
+	OPT_FIX_BANK_CONFLICTS,
+	OPT_SWITCH_HINTS,
+	OPT_VERIFY,
+};
+
 static const struct option longopts[] = {
 	{"advanced", no_argument, 0, 'a'},
 	{"binary", no_argument, 0, 'b'},
@@ -76,6 +92,19 @@ static const struct option longopts[] = {
 	{"input_list", required_argument, 0, 'l'},
 	{"output", required_argument, 0, 'o'},
 	{"gen", required_argument, 0, 'g'},
+	{"if-convert", optional_argument, 0, OPT_IF_CONVERT},
+	{"simplify-arith", no_argument, 0, OPT_SIMPLIFY_ARITH},
+	{"copy-prop", no_argument, 0, OPT_COPY_PROP},
+	{"estimate", no_argument, 0, OPT_ESTIMATE},
+	{"estimate-json", required_argument, 0, OPT_ESTIMATE_JSON},
+	{"reg-pressure", no_argument, 0, OPT_REG_PRESSURE},
+	{"cfg-dot", required_argument, 0, OPT_CFG_DOT},
+	{"cfg-json", required_argument, 0, OPT_CFG_JSON},
+	{"critical-path", no_argument, 0, OPT_CRITICAL_PATH},
+	{"perf-warn", optional_argument, 0, OPT_PERF_WARN},
+	{"fix-bank-conflicts", no_argument, 0, OPT_FIX_BANK_CONFLICTS},
+	{"switch-hints", no_argument, 0, OPT_SWITCH_HINTS},
+	{"verify", no_argument, 0, OPT_VERIFY},
 	{ NULL, 0, NULL, 0 }
 };
 
@@ -99,6 +128,19 @@ static void usage(void)
 	fprintf(stderr, "\t-l, --input_list {entrytablefile}    Input entry_table_list file\n");
 	fprintf(stderr, "\t-o, --output {outputfile}            Specify output file\n");
 	fprintf(stderr, "\t-g, --gen <4|5|6|7>                  Specify GPU generation\n");
+	fprintf(stderr, "\t    --if-convert[=<n>]               Predicate if blocks of up to n instructions per arm\n");
+	fprintf(stderr, "\t    --simplify-arith                 Fold identities, reduce strength, fuse mul+add\n");
+	fprintf(stderr, "\t    --copy-prop                      Compute send payloads in place, dropping movs\n");
+	fprintf(stderr, "\t    --estimate                       Print estimated cycles per block to stderr\n");
+	fprintf(stderr, "\t    --estimate-json {file}           Write the cycle estimate as JSON\n");
+	fprintf(stderr, "\t    --reg-pressure                   Print live GRFs and check .reg_count pragmas\n");
+	fprintf(stderr, "\t    --cfg-dot {file}                 Write the control flow graph as DOT\n");
+	fprintf(stderr, "\t    --cfg-json {file}                Write the control flow graph as JSON\n");
+	fprintf(stderr, "\t    --critical-path                  Print the dependency chain bounding each block\n");
+	fprintf(stderr, "\t    --perf-warn[=<rule,no-rule>]     Warn about encodings the hardware splits\n");
+	fprintf(stderr, "\t    --fix-bank-conflicts             Rename registers to avoid Gen7 3-src bank conflicts\n");
+	fprintf(stderr, "\t    --switch-hints                   Switch threads before stalling on a send result\n");
+	fprintf(stderr, "\t    --verify                         Check that the output disassembles and reassembles\n");
 }
 
 static int hash(char *key)
@@ -270,6 +312,69 @@ print_instruction(FILE *output, struct brw_program_instruction *entry)
 			((int *)(&entry->instruction))[3]);
 	}
 }
+/**
+ * Turns the labels and distances branches were given into the JIP and
+ * UIP fields, once every instruction has its offset.
+ */
+void encode_branches(struct brw_program *p)
+{
+	struct brw_program_instruction *entry;
+
+	for (entry = p->first; entry; entry = entry->next) {
+	    struct brw_instruction *inst = & entry->instruction;
+
+	    if (inst->first_reloc_target)
+		inst->first_reloc_offset = label_to_addr(inst->first_reloc_target, entry->inst_offset) - entry->inst_offset;
+
+	    if (inst->second_reloc_target)
+		inst->second_reloc_offset = label_to_addr(inst->second_reloc_target, entry->inst_offset) - entry->inst_offset;
+
+	    if (inst->second_reloc_offset) {
+		// this is a branch instruction with two offset arguments
+		entry->instruction.bits3.branch_2_offset.JIP = jump_distance(inst->first_reloc_offset);
+		entry->instruction.bits3.branch_2_offset.UIP = jump_distance(inst->second_reloc_offset);
+	    } else if (inst->first_reloc_offset) {
+		// this is a branch instruction with one offset argument
+		int offset = inst->first_reloc_offset;
+		/* bspec: Unlike other flow control instructions, the offset used by JMPI is relative to the incremented instruction pointer rather than the IP value for the instruction itself. */
+		
+		int is_jmpi = entry->instruction.header.opcode == BRW_OPCODE_JMPI; // target relative to the post-incremented IP, so delta == 1 if JMPI
+		if(is_jmpi)
+		    offset --;
+		offset = jump_distance(offset);
+		if (is_jmpi && (gen_level == 75))
+			offset = offset * 8;
+
+		if(!IS_GENp(6)) {
+		    /* The jump count is the low word; the high word is the
+		     * pop count, which a negative distance mustn't fill. */
+		    if(is_jmpi)
+			entry->instruction.bits3.JIP = offset;
+		    else
+			entry->instruction.bits3.branch_2_offset.JIP = offset;
+		    if(entry->instruction.header.opcode == BRW_OPCODE_ELSE)
+			entry->instruction.bits3.branch_2_offset.UIP = 1; /* Set the istack pop count, which must always be 1. */
+		} else if(IS_GENx(6)) {
+		    /* TODO: endif JIP pos is not in Gen6 spec. may be bits1 */
+		    int opcode = entry->instruction.header.opcode;
+		    if(opcode == BRW_OPCODE_CALL || opcode == BRW_OPCODE_JMPI)
+			entry->instruction.bits3.JIP = offset; // for CALL, JMPI
+		    else
+			entry->instruction.bits1.branch.JIP = offset; // for CASE,ELSE,FORK,IF,WHILE
+		} else if(IS_GENp(7)) {
+		    int opcode = entry->instruction.header.opcode;
+		    /* Gen7 JMPI Restrictions in bspec:
+		     * The JIP data type must be Signed DWord
+		     */
+		    if(opcode == BRW_OPCODE_JMPI)
+			entry->instruction.bits3.JIP = offset;
+		    else
+			entry->instruction.bits3.branch_2_offset.JIP = offset;
+		}
+	    }
+	}
+}
+
 int main(int argc, char **argv)
 {
 	char *output_file = NULL;
@@ -278,7 +383,20 @@ int main(int argc, char **argv)
 	FILE *export_file;
 	struct brw_program_instruction *entry, *entry1, *tmp_entry;
 	int err, inst_offset;
-	char o;
+	int if_convert_length = 0;
+	int simplify_arith = 0;
+	int copy_prop = 0;
+	int estimate = 0;
+	char *estimate_json = NULL;
+	int reg_pressure = 0;
+	char *cfg_dot = NULL;
+	char *cfg_json = NULL;
+	int critical_path = 0;
+	int perf_warn = 0;
+	int fix_banks = 0;
+	int switch_hints = 0;
+	int verify = 0;
+	int o;
 	while ((o = getopt_long(argc, argv, "e:l:o:g:ab", longopts, NULL)) != -1) {
 		switch (o) {
 		case 'o':
@@ -287,30 +405,13 @@ int main(int argc, char **argv)
 
 			break;
 
-		case 'g': {
-			char *dec_ptr, *end_ptr;
-			unsigned long decimal;
-
-			gen_level = strtol(optarg, &dec_ptr, 10) * 10;
-
-			if (*dec_ptr == '.') {
-				decimal = strtoul(++dec_ptr, &end_ptr, 10);
-				if (end_ptr != dec_ptr && *end_ptr == '\0') {
-					if (decimal > 10) {
-						fprintf(stderr, "Invalid Gen X decimal version\n");
-						exit(1);
-					}
-					gen_level += decimal;
-				}
-			}
-
-			if (gen_level < 40 || gen_level > 75) {
+		case 'g':
+			gen_level = parse_gen_level(optarg);
+			if (gen_level < 0) {
 				usage();
 				exit(1);
 			}
-
 			break;
-		}
 
 		case 'a':
 			advanced_flag = 1;
@@ -330,6 +431,66 @@ int main(int argc, char **argv)
 				entry_table_file = optarg;
 			break;
 
+		case OPT_SIMPLIFY_ARITH:
+			simplify_arith = 1;
+			break;
+
+		case OPT_COPY_PROP:
+			copy_prop = 1;
+			break;
+
+		case OPT_ESTIMATE:
+			estimate = 1;
+			break;
+
+		case OPT_ESTIMATE_JSON:
+			estimate_json = optarg;
+			break;
+
+		case OPT_REG_PRESSURE:
+			reg_pressure = 1;
+			break;
+
+		case OPT_CFG_DOT:
+			cfg_dot = optarg;
+			break;
+
+		case OPT_CFG_JSON:
+			cfg_json = optarg;
+			break;
+
+		case OPT_CRITICAL_PATH:
+			critical_path = 1;
+			break;
+
+		case OPT_PERF_WARN:
+			if (perf_warn_configure(optarg) != 0) {
+				usage();
+				exit(1);
+			}
+			perf_warn = 1;
+			break;
+
+		case OPT_FIX_BANK_CONFLICTS:
+			fix_banks = 1;
+			break;
+
+		case OPT_SWITCH_HINTS:
+			switch_hints = 1;
+			break;
+
+		case OPT_VERIFY:
+			verify = 1;
+			break;
+
+		case OPT_IF_CONVERT:
+			if_convert_length = optarg ? atoi(optarg) : IF_CONVERT_DEFAULT_LENGTH;
+			if (if_convert_length <= 0) {
+				usage();
+				exit(1);
+			}
+			break;
+
 		default:
 			usage();
 			exit(1);
@@ -361,6 +522,16 @@ int main(int argc, char **argv)
 	if (err || errors)
 		exit (1);
 
+	if (perf_warn)
+		check_performance(&compiled_program);
+
+	if (simplify_arith)
+		simplify_arithmetic(&compiled_program);
+	if (copy_prop)
+		propagate_payload_copies(&compiled_program);
+	if (if_convert_length)
+		if_convert(&compiled_program, if_convert_length);
+
 	if (output_file) {
 		output = fopen(output_file, "w");
 		if (output == NULL) {
@@ -406,62 +577,56 @@ int main(int argc, char **argv)
 		}
 		for (entry = compiled_program.first;
 			entry != NULL; entry = entry->next) {
-		    if (entry->islabel) 
+		    if (entry->islabel && !is_internal_label(entry->string))
 			fprintf(export_file, "#define %s_IP %d\n",
 				entry->string, (IS_GENx(5) ? 2 : 1)*(entry->inst_offset));
 		}
 		fclose(export_file);
 	}
 
-	for (entry = compiled_program.first; entry; entry = entry->next) {
-	    struct brw_instruction *inst = & entry->instruction;
+	encode_branches(&compiled_program);
 
-	    if (inst->first_reloc_target)
-		inst->first_reloc_offset = label_to_addr(inst->first_reloc_target, entry->inst_offset) - entry->inst_offset;
+	if (fix_banks)
+		fix_bank_conflicts(&compiled_program);
 
-	    if (inst->second_reloc_target)
-		inst->second_reloc_offset = label_to_addr(inst->second_reloc_target, entry->inst_offset) - entry->inst_offset;
+	if (switch_hints)
+		place_switch_hints(&compiled_program);
 
-	    if (inst->second_reloc_offset) {
-		// this is a branch instruction with two offset arguments
-		entry->instruction.bits3.branch_2_offset.JIP = jump_distance(inst->first_reloc_offset);
-		entry->instruction.bits3.branch_2_offset.UIP = jump_distance(inst->second_reloc_offset);
-	    } else if (inst->first_reloc_offset) {
-		// this is a branch instruction with one offset argument
-		int offset = inst->first_reloc_offset;
-		/* bspec: Unlike other flow control instructions, the offset used by JMPI is relative to the incremented instruction pointer rather than the IP value for the instruction itself. */
-		
-		int is_jmpi = entry->instruction.header.opcode == BRW_OPCODE_JMPI; // target relative to the post-incremented IP, so delta == 1 if JMPI
-		if(is_jmpi)
-		    offset --;
-		offset = jump_distance(offset);
-		if (is_jmpi && (gen_level == 75))
-			offset = offset * 8;
+	if (estimate || estimate_json || cfg_dot || cfg_json) {
+		struct brw_instruction **insts;
+		int n = program_instructions(&compiled_program, &insts);
 
-		if(!IS_GENp(6)) {
-		    entry->instruction.bits3.JIP = offset;
-		    if(entry->instruction.header.opcode == BRW_OPCODE_ELSE)
-			entry->instruction.bits3.branch_2_offset.UIP = 1; /* Set the istack pop count, which must always be 1. */
-		} else if(IS_GENx(6)) {
-		    /* TODO: endif JIP pos is not in Gen6 spec. may be bits1 */
-		    int opcode = entry->instruction.header.opcode;
-		    if(opcode == BRW_OPCODE_CALL || opcode == BRW_OPCODE_JMPI)
-			entry->instruction.bits3.JIP = offset; // for CALL, JMPI
-		    else
-			entry->instruction.bits1.branch.JIP = offset; // for CASE,ELSE,FORK,IF,WHILE
-		} else if(IS_GENp(7)) {
-		    int opcode = entry->instruction.header.opcode;
-		    /* Gen7 JMPI Restrictions in bspec:
-		     * The JIP data type must be Signed DWord
-		     */
-		    if(opcode == BRW_OPCODE_JMPI)
-			entry->instruction.bits3.JIP = offset;
-		    else
-			entry->instruction.bits3.branch_2_offset.JIP = offset;
+		if (estimate)
+			estimate_cycles(stderr, insts, n, 0);
+		if (estimate_json) {
+			FILE *f = open_report(estimate_json);
+
+			estimate_cycles(f, insts, n, 1);
+			close_report(f);
 		}
-	    }
+		if (cfg_dot) {
+			FILE *f = open_report(cfg_dot);
+
+			write_cfg(f, insts, n, 0);
+			close_report(f);
+		}
+		if (cfg_json) {
+			FILE *f = open_report(cfg_json);
+
+			write_cfg(f, insts, n, 1);
+			close_report(f);
+		}
+		free(insts);
 	}
 
+	if (reg_pressure)
+		report_register_pressure(stderr, &compiled_program);
+	if (critical_path)
+		report_critical_paths(stderr, &compiled_program);
+
+	if (verify && verify_program(stderr, &compiled_program))
+		err = 1;
+
 	if (binary_like_output)
 		fprintf(output, "%s", binary_prepend);
 
@@ -0,0 +1,215 @@
+/* -*- c-basic-offset: 8 -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Opcode and send target descriptions, shared by the assembler, the
+ * disassembler and the analyses.
+ *
+ * An opcode may exist only on some generations, and may change form
+ * between them: Gen6 turns the branches from instructions on the IP
+ * register into instructions carrying jump distances, and reuses the
+ * Gen4/5 msave and mrest opcodes for call and ret.  Each entry covers the
+ * generations one form is valid on, and opcode_desc() picks the one for
+ * the current gen_level.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gen4asm.h"
+
+#define ALL	40, 75
+#define GEN4_5	40, 59
+#define GEN6	60, 69
+#define GEN6_	60, 75
+#define GEN7_	70, 75
+
+static const struct opcode_desc opcodes[] = {
+	{ "mov",	BRW_OPCODE_MOV,		ALL,	1, 1, OPCODE_ALU },
+	{ "frc",	BRW_OPCODE_FRC,		ALL,	1, 1, OPCODE_ALU },
+	{ "rndu",	BRW_OPCODE_RNDU,	ALL,	1, 1, OPCODE_ALU },
+	{ "rndd",	BRW_OPCODE_RNDD,	ALL,	1, 1, OPCODE_ALU },
+	{ "rnde",	BRW_OPCODE_RNDE,	ALL,	1, 1, OPCODE_ALU },
+	{ "rndz",	BRW_OPCODE_RNDZ,	ALL,	1, 1, OPCODE_ALU },
+	{ "not",	BRW_OPCODE_NOT,		ALL,	1, 1, OPCODE_ALU },
+	{ "lzd",	BRW_OPCODE_LZD,		ALL,	1, 1, OPCODE_ALU },
+	{ "f32to16",	BRW_OPCODE_F32TO16,	GEN7_,	1, 1, OPCODE_ALU },
+	{ "f16to32",	BRW_OPCODE_F16TO32,	GEN7_,	1, 1, OPCODE_ALU },
+	{ "bfrev",	BRW_OPCODE_BFREV,	GEN7_,	1, 1, OPCODE_ALU },
+	{ "fbh",	BRW_OPCODE_FBH,		GEN7_,	1, 1, OPCODE_ALU },
+	{ "fbl",	BRW_OPCODE_FBL,		GEN7_,	1, 1, OPCODE_ALU },
+	{ "cbit",	BRW_OPCODE_CBIT,	GEN7_,	1, 1, OPCODE_ALU },
+
+	{ "mul",	BRW_OPCODE_MUL,		ALL,	2, 1, OPCODE_ALU },
+	{ "mac",	BRW_OPCODE_MAC,		ALL,	2, 1, OPCODE_ALU },
+	{ "mach",	BRW_OPCODE_MACH,	ALL,	2, 1, OPCODE_ALU },
+	{ "line",	BRW_OPCODE_LINE,	ALL,	2, 1, OPCODE_ALU },
+	{ "sad2",	BRW_OPCODE_SAD2,	ALL,	2, 1, OPCODE_ALU },
+	{ "sada2",	BRW_OPCODE_SADA2,	ALL,	2, 1, OPCODE_ALU },
+	{ "dp4",	BRW_OPCODE_DP4,		ALL,	2, 1, OPCODE_ALU },
+	{ "dph",	BRW_OPCODE_DPH,		ALL,	2, 1, OPCODE_ALU },
+	{ "dp3",	BRW_OPCODE_DP3,		ALL,	2, 1, OPCODE_ALU },
+	{ "dp2",	BRW_OPCODE_DP2,		ALL,	2, 1, OPCODE_ALU },
+	{ "pln",	BRW_OPCODE_PLN,		ALL,	2, 1, OPCODE_ALU },
+	{ "avg",	BRW_OPCODE_AVG,		ALL,	2, 1, OPCODE_ALU },
+	{ "add",	BRW_OPCODE_ADD,		ALL,	2, 1, OPCODE_ALU },
+	{ "sel",	BRW_OPCODE_SEL,		ALL,	2, 1, OPCODE_ALU },
+	{ "and",	BRW_OPCODE_AND,		ALL,	2, 1, OPCODE_ALU },
+	{ "or",		BRW_OPCODE_OR,		ALL,	2, 1, OPCODE_ALU },
+	{ "xor",	BRW_OPCODE_XOR,		ALL,	2, 1, OPCODE_ALU },
+	{ "shr",	BRW_OPCODE_SHR,		ALL,	2, 1, OPCODE_ALU },
+	{ "shl",	BRW_OPCODE_SHL,		ALL,	2, 1, OPCODE_ALU },
+	{ "asr",	BRW_OPCODE_ASR,		ALL,	2, 1, OPCODE_ALU },
+	{ "cmp",	BRW_OPCODE_CMP,		ALL,	2, 1, OPCODE_ALU },
+	{ "cmpn",	BRW_OPCODE_CMPN,	ALL,	2, 1, OPCODE_ALU },
+	{ "bfi1",	BRW_OPCODE_BFI1,	GEN7_,	2, 1, OPCODE_ALU },
+	{ "addc",	BRW_OPCODE_ADDC,	GEN7_,	2, 1, OPCODE_ALU },
+	{ "subb",	BRW_OPCODE_SUBB,	GEN7_,	2, 1, OPCODE_ALU },
+	{ "math",	BRW_OPCODE_MATH,	GEN6_,	2, 1, OPCODE_MATH },
+
+	{ "mad",	BRW_OPCODE_MAD,		GEN6_,	3, 1, OPCODE_THREE_SRC },
+	{ "lrp",	BRW_OPCODE_LRP,		GEN6_,	3, 1, OPCODE_THREE_SRC },
+	{ "bfe",	BRW_OPCODE_BFE,		GEN7_,	3, 1, OPCODE_THREE_SRC },
+	{ "bfi2",	BRW_OPCODE_BFI2,	GEN7_,	3, 1, OPCODE_THREE_SRC },
+
+	{ "send",	BRW_OPCODE_SEND,	ALL,	1, 1, OPCODE_SEND },
+	{ "sendc",	BRW_OPCODE_SENDC,	ALL,	1, 1, OPCODE_SEND },
+	{ "nop",	BRW_OPCODE_NOP,		ALL,	0, 0, OPCODE_NOP },
+	{ "wait",	BRW_OPCODE_WAIT,	ALL,	1, 0, OPCODE_ALU },
+
+	/* Gen4/5 branches take the IP as destination and first source
+	 * and the jump distance as the second.
+	 */
+	{ "jmpi",	BRW_OPCODE_JMPI,	ALL,	1, 0, OPCODE_ALU, OPCODE_FLOW },
+	{ "if",		BRW_OPCODE_IF,		GEN4_5,	2, 0, OPCODE_ALU, OPCODE_FLOW },
+	{ "iff",	BRW_OPCODE_IFF,		GEN4_5,	1, 1, OPCODE_ALU, OPCODE_FLOW },
+	{ "else",	BRW_OPCODE_ELSE,	GEN4_5,	2, 0, OPCODE_ALU, OPCODE_FLOW },
+	{ "endif",	BRW_OPCODE_ENDIF,	GEN4_5,	2, 0, OPCODE_ALU, OPCODE_FLOW },
+	{ "while",	BRW_OPCODE_WHILE,	GEN4_5,	1, 0, OPCODE_ALU, OPCODE_FLOW },
+	{ "break",	BRW_OPCODE_BREAK,	GEN4_5,	1, 0, OPCODE_ALU, OPCODE_FLOW },
+	{ "cont",	BRW_OPCODE_CONTINUE,	GEN4_5,	1, 0, OPCODE_ALU, OPCODE_FLOW },
+	{ "halt",	BRW_OPCODE_HALT,	GEN4_5,	1, 0, OPCODE_ALU, OPCODE_FLOW },
+	{ "msave",	BRW_OPCODE_MSAVE,	GEN4_5,	1, 1, OPCODE_ALU, OPCODE_FLOW },
+	{ "mrest",	BRW_OPCODE_MRESTORE,	GEN4_5,	1, 1, OPCODE_ALU, OPCODE_FLOW },
+	{ "push",	BRW_OPCODE_PUSH,	ALL,	1, 1, OPCODE_ALU, OPCODE_FLOW },
+	{ "pop",	BRW_OPCODE_POP,		ALL,	2, 0, OPCODE_ALU, OPCODE_FLOW },
+	{ "do",		BRW_OPCODE_DO,		ALL,	0, 0, OPCODE_ALU, OPCODE_FLOW },
+
+	/* Gen6+ branches carry a JIP, and some a UIP, instead. */
+	{ "if",		BRW_OPCODE_IF,		GEN6,	0, 0, OPCODE_BRANCH, OPCODE_FLOW, 1 },
+	{ "if",		BRW_OPCODE_IF,		GEN7_,	0, 0, OPCODE_BRANCH, OPCODE_FLOW, 2 },
+	{ "else",	BRW_OPCODE_ELSE,	GEN6_,	0, 0, OPCODE_BRANCH, OPCODE_FLOW, 1 },
+	{ "endif",	BRW_OPCODE_ENDIF,	GEN6_,	0, 0, OPCODE_BRANCH, OPCODE_FLOW, 1 },
+	{ "while",	BRW_OPCODE_WHILE,	GEN6_,	0, 0, OPCODE_BRANCH, OPCODE_FLOW, 1 },
+	{ "break",	BRW_OPCODE_BREAK,	GEN6_,	0, 0, OPCODE_BRANCH, OPCODE_FLOW, 2 },
+	{ "cont",	BRW_OPCODE_CONTINUE,	GEN6_,	0, 0, OPCODE_BRANCH, OPCODE_FLOW, 2 },
+	{ "halt",	BRW_OPCODE_HALT,	GEN6_,	0, 0, OPCODE_BRANCH, OPCODE_FLOW, 2 },
+	{ "call",	BRW_OPCODE_CALL,	GEN6_,	0, 1, OPCODE_BRANCH, OPCODE_FLOW, 1 },
+	{ "ret",	BRW_OPCODE_RET,		GEN6_,	1, 1, OPCODE_ALU, OPCODE_FLOW },
+	{ "brd",	BRW_OPCODE_BRD,		GEN7_,	0, 0, OPCODE_BRANCH, OPCODE_FLOW, 1 },
+	{ "brc",	BRW_OPCODE_BRC,		GEN7_,	0, 0, OPCODE_BRANCH, OPCODE_FLOW, 2 },
+};
+
+static const struct opcode_desc *opcode_table[128];
+static long int opcode_table_gen;
+
+/**
+ * Returns the description of an opcode on the current generation, or
+ * NULL if it doesn't exist there.
+ */
+const struct opcode_desc *opcode_desc(int opcode)
+{
+	unsigned int i;
+
+	if (opcode_table_gen != gen_level) {
+		for (i = 0; i < 128; i++)
+			opcode_table[i] = NULL;
+		for (i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); i++)
+			if (gen_level >= opcodes[i].gen_min &&
+			    gen_level <= opcodes[i].gen_max)
+				opcode_table[opcodes[i].opcode] = &opcodes[i];
+		opcode_table_gen = gen_level;
+	}
+	return opcode_table[opcode & 127];
+}
+
+static const struct {
+	int target;
+	int gen_min, gen_max;
+	const char *name;
+} send_targets[] = {
+	{ BRW_MESSAGE_TARGET_NULL,		ALL,	"null" },
+	{ BRW_MESSAGE_TARGET_MATH,		GEN4_5,	"math" },
+	{ BRW_MESSAGE_TARGET_SAMPLER,		ALL,	"sampler" },
+	{ BRW_MESSAGE_TARGET_GATEWAY,		ALL,	"gateway" },
+	{ BRW_MESSAGE_TARGET_DATAPORT_READ,	ALL,	"read" },
+	{ BRW_MESSAGE_TARGET_DATAPORT_WRITE,	ALL,	"write" },
+	{ BRW_MESSAGE_TARGET_URB,		ALL,	"urb" },
+	{ BRW_MESSAGE_TARGET_THREAD_SPAWNER,	ALL,	"thread_spawner" },
+};
+
+/**
+ * Returns the name of a send target on the current generation, or NULL
+ * if the target doesn't exist there or has no name of its own.
+ */
+const char *send_target_name(int target)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(send_targets) / sizeof(send_targets[0]); i++)
+		if (send_targets[i].target == target &&
+		    gen_level >= send_targets[i].gen_min &&
+		    gen_level <= send_targets[i].gen_max)
+			return send_targets[i].name;
+	return NULL;
+}
+
+/**
+ * Parses the argument of -g, a generation such as "6" or "7.5", into a
+ * gen_level.  Returns -1 if it isn't a generation the tools know.
+ */
+int parse_gen_level(const char *arg)
+{
+	char *dec_ptr, *end_ptr;
+	unsigned long decimal;
+	long level;
+
+	level = strtol(arg, &dec_ptr, 10) * 10;
+
+	if (*dec_ptr == '.') {
+		decimal = strtoul(++dec_ptr, &end_ptr, 10);
+		if (end_ptr != dec_ptr && *end_ptr == '\0') {
+			if (decimal > 10) {
+				fprintf(stderr, "Invalid Gen X decimal version\n");
+				return -1;
+			}
+			level += decimal;
+		}
+	}
+
+	if (level < 40 || level > 75)
+		return -1;
+	return level;
+}
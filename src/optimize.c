@@ -0,0 +1,1528 @@
+/* -*- c-basic-offset: 8 -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Optional transformations run on the parsed program before branch offsets
+ * are resolved.  They all work on compiled_program's instruction list, where
+ * branches still refer to their targets by label, so instructions can be
+ * removed or rewritten without fixing up JIP/UIP by hand.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gen4asm.h"
+
+/* The list entries of a program, labels included, as an array.  Passes
+ * remove an entry by freeing it and setting its slot to NULL.
+ */
+struct program_vector {
+	struct brw_program_instruction **entry;
+	int count;
+};
+
+static int internal_label_count;
+
+static void program_to_vector(struct brw_program *p, struct program_vector *v)
+{
+	struct brw_program_instruction *entry;
+	int n = 0;
+
+	for (entry = p->first; entry; entry = entry->next)
+		n++;
+	v->entry = calloc(n + 1, sizeof(*v->entry));
+	v->count = 0;
+	for (entry = p->first; entry; entry = entry->next)
+		v->entry[v->count++] = entry;
+}
+
+static void vector_to_program(struct program_vector *v, struct brw_program *p)
+{
+	int i;
+
+	p->first = p->last = NULL;
+	for (i = 0; i < v->count; i++) {
+		if (!v->entry[i])
+			continue;
+		v->entry[i]->next = NULL;
+		if (p->last)
+			p->last->next = v->entry[i];
+		else
+			p->first = v->entry[i];
+		p->last = v->entry[i];
+	}
+	free(v->entry);
+	v->entry = NULL;
+	v->count = 0;
+}
+
+/* Labels made up by the passes start with a '.', which the lexer never
+ * accepts in a label, so they can't clash with the program's own labels and
+ * are left out of the export file.
+ */
+int is_internal_label(const char *name)
+{
+	return name[0] == '.';
+}
+
+static struct brw_program_instruction *new_internal_label(void)
+{
+	struct brw_program_instruction *label = calloc(1, sizeof(*label));
+	char name[32];
+
+	snprintf(name, sizeof(name), ".L%d", internal_label_count++);
+	label->string = strdup(name);
+	label->islabel = 1;
+	return label;
+}
+
+static int symbolize_offset(char **target, GLint *offset, int ip, int count,
+			    struct brw_program_instruction **labels)
+{
+	int dest;
+
+	if (*target || *offset == 0)
+		return 0;
+
+	/* Numeric offsets are in instructions relative to the branch itself;
+	 * Gen4/5 ELSE keeps its pop count above the low 16 bits.
+	 */
+	dest = ip + (int16_t)(*offset & 0xffff);
+	if (dest < 0 || dest > count)
+		return 1;
+
+	if (!labels[dest])
+		labels[dest] = new_internal_label();
+	*target = strdup(labels[dest]->string);
+	*offset = 0;
+	return 0;
+}
+
+/**
+ * Replaces numeric branch offsets with references to internal labels placed
+ * at the branch targets, so that later passes may add and remove
+ * instructions freely.
+ *
+ * Returns the number of branches whose target can't be known statically
+ * (register-indirect jumps and offsets pointing outside the program).  The
+ * layout of such a program must not be changed.
+ */
+int program_symbolize_branches(struct brw_program *p)
+{
+	struct program_vector v;
+	struct brw_program_instruction **insts, **labels, *entry;
+	int i, n = 0, unknown = 0;
+
+	program_to_vector(p, &v);
+	insts = calloc(v.count + 1, sizeof(*insts));
+	for (i = 0; i < v.count; i++)
+		if (!v.entry[i]->islabel)
+			insts[n++] = v.entry[i];
+	labels = calloc(n + 1, sizeof(*labels));
+
+	for (i = 0; i < n; i++) {
+		struct brw_instruction *inst = &insts[i]->instruction;
+
+		if (inst->header.opcode == BRW_OPCODE_JMPI &&
+		    !inst->first_reloc_target &&
+		    inst->bits1.da1.src1_reg_file != BRW_IMMEDIATE_VALUE) {
+			unknown++;
+			continue;
+		}
+		unknown += symbolize_offset(&inst->first_reloc_target,
+					    &inst->first_reloc_offset,
+					    i, n, labels);
+		unknown += symbolize_offset(&inst->second_reloc_target,
+					    &inst->second_reloc_offset,
+					    i, n, labels);
+	}
+
+	p->first = p->last = NULL;
+	for (i = 0, n = 0; i <= v.count; i++) {
+		entry = i < v.count ? v.entry[i] : NULL;
+		if (!entry || !entry->islabel) {
+			if (labels[n]) {
+				if (p->last)
+					p->last->next = labels[n];
+				else
+					p->first = labels[n];
+				p->last = labels[n];
+			}
+			n++;
+		}
+		if (!entry)
+			break;
+		entry->next = NULL;
+		if (p->last)
+			p->last->next = entry;
+		else
+			p->first = entry;
+		p->last = entry;
+	}
+
+	free(labels);
+	free(insts);
+	free(v.entry);
+	return unknown;
+}
+
+/* Whether the instruction updates a flag register, either through its
+ * conditional modifier or by naming one as its destination.
+ */
+static int writes_flag(struct brw_instruction *inst)
+{
+	int opcode = inst->header.opcode;
+
+	/* SEND and Gen6+ MATH reuse the conditional modifier bits. */
+	if (opcode != BRW_OPCODE_SEND && opcode != BRW_OPCODE_SENDC &&
+	    !(opcode == BRW_OPCODE_MATH && IS_GENp(6)) &&
+	    inst->header.sfid_destreg__conditionalmod != BRW_CONDITIONAL_NONE)
+		return 1;
+
+	if (instruction_is_three_src(inst))
+		return 0;
+
+	return inst->bits1.da1.dest_address_mode == BRW_ADDRESS_DIRECT &&
+		inst->bits1.da1.dest_reg_file == BRW_ARCHITECTURE_REGISTER_FILE &&
+		(inst->bits1.da1.dest_reg_nr & 0xf0) == BRW_ARF_FLAG;
+}
+
+/* Whether inst may be moved out of the if block cond opens and be
+ * predicated on cond's flag instead.
+ */
+static int if_convertible(struct brw_instruction *inst,
+			  struct brw_instruction *cond)
+{
+	switch (inst->header.opcode) {
+	case BRW_OPCODE_MOV:
+	case BRW_OPCODE_SEL:
+	case BRW_OPCODE_NOT:
+	case BRW_OPCODE_AND:
+	case BRW_OPCODE_OR:
+	case BRW_OPCODE_XOR:
+	case BRW_OPCODE_SHR:
+	case BRW_OPCODE_SHL:
+	case BRW_OPCODE_ASR:
+	case BRW_OPCODE_CMP:
+	case BRW_OPCODE_CMPN:
+	case BRW_OPCODE_ADD:
+	case BRW_OPCODE_MUL:
+	case BRW_OPCODE_AVG:
+	case BRW_OPCODE_FRC:
+	case BRW_OPCODE_RNDU:
+	case BRW_OPCODE_RNDD:
+	case BRW_OPCODE_RNDE:
+	case BRW_OPCODE_RNDZ:
+	case BRW_OPCODE_MAC:
+	case BRW_OPCODE_MACH:
+	case BRW_OPCODE_LZD:
+	case BRW_OPCODE_SAD2:
+	case BRW_OPCODE_SADA2:
+	case BRW_OPCODE_DP4:
+	case BRW_OPCODE_DPH:
+	case BRW_OPCODE_DP3:
+	case BRW_OPCODE_DP2:
+	case BRW_OPCODE_LINE:
+	case BRW_OPCODE_PLN:
+		break;
+	case BRW_OPCODE_F32TO16:
+	case BRW_OPCODE_F16TO32:
+	case BRW_OPCODE_BFREV:
+	case BRW_OPCODE_BFE:
+	case BRW_OPCODE_BFI1:
+	case BRW_OPCODE_BFI2:
+	case BRW_OPCODE_FBH:
+	case BRW_OPCODE_FBL:
+	case BRW_OPCODE_CBIT:
+	case BRW_OPCODE_ADDC:
+	case BRW_OPCODE_SUBB:
+	case BRW_OPCODE_MAD:
+	case BRW_OPCODE_LRP:
+		if (!IS_GENp(6))
+			return 0;
+		break;
+	default:
+		return 0;
+	}
+
+	/* Already predicated, or executed regardless of the channel enables
+	 * the if block would have set up.
+	 */
+	if (inst->header.predicate_control != BRW_PREDICATE_NONE ||
+	    inst->header.mask_control == BRW_MASK_DISABLE)
+		return 0;
+
+	if (inst->header.execution_size > cond->header.execution_size)
+		return 0;
+
+	/* The else arm reads the flag the if tested, so neither arm may
+	 * change it.
+	 */
+	return !writes_flag(inst);
+}
+
+static void predicate_on(struct brw_instruction *inst,
+			 struct brw_instruction *cond, int invert)
+{
+	inst->header.predicate_control = cond->header.predicate_control;
+	inst->header.predicate_inverse = cond->header.predicate_inverse ^ invert;
+	if (instruction_is_three_src(inst)) {
+		inst->bits1.three_src_gen6.flag_reg_nr = cond->bits2.da1.flag_reg_nr;
+		inst->bits1.three_src_gen6.flag_subreg_nr = cond->bits2.da1.flag_subreg_nr;
+	} else {
+		inst->bits2.da1.flag_reg_nr = cond->bits2.da1.flag_reg_nr;
+		inst->bits2.da1.flag_subreg_nr = cond->bits2.da1.flag_subreg_nr;
+	}
+}
+
+/* Finds the label a branch at instruction address addr resolves name to,
+ * the same way label_to_addr() will: the first one at or after the branch,
+ * or else the first one in the program.
+ */
+static int find_label(struct program_vector *v, int *addr, char *name, int from)
+{
+	int i, r = -1;
+
+	for (i = 0; i < v->count; i++) {
+		if (!v->entry[i] || !v->entry[i]->islabel ||
+		    strcmp(v->entry[i]->string, name) != 0)
+			continue;
+		if (addr[i] >= from)
+			return i;
+		if (r == -1)
+			r = i;
+	}
+	return r;
+}
+
+static int targets_within(struct program_vector *v, int *addr, int idx,
+			  int end)
+{
+	struct brw_instruction *inst = &v->entry[idx]->instruction;
+	char *target[2] = { inst->first_reloc_target, inst->second_reloc_target };
+	int i, t;
+
+	for (i = 0; i < 2; i++) {
+		if (!target[i])
+			continue;
+		t = find_label(v, addr, target[i], addr[idx]);
+		if (t <= idx || t >= end)
+			return 0;
+	}
+	return 1;
+}
+
+static int references_label(struct brw_instruction *inst, char *name)
+{
+	return (inst->first_reloc_target &&
+		strcmp(inst->first_reloc_target, name) == 0) ||
+		(inst->second_reloc_target &&
+		 strcmp(inst->second_reloc_target, name) == 0);
+}
+
+/* Checks that the if block from if_idx to endif_idx is entered only
+ * through its IF and that its IF and ELSE don't branch out of it, so its
+ * control flow can be dropped.
+ */
+static int if_block_is_closed(struct program_vector *v, int *addr,
+			      int if_idx, int else_idx, int endif_idx)
+{
+	int end = endif_idx + 1, i, j;
+
+	while (end < v->count && v->entry[end] && v->entry[end]->islabel)
+		end++;
+
+	if (!targets_within(v, addr, if_idx, end) ||
+	    (else_idx >= 0 && !targets_within(v, addr, else_idx, end)))
+		return 0;
+
+	for (i = if_idx + 1; i < endif_idx; i++) {
+		if (!v->entry[i]->islabel)
+			continue;
+		for (j = 0; j < v->count; j++) {
+			if (j == if_idx || j == else_idx || j == endif_idx ||
+			    !v->entry[j] || v->entry[j]->islabel)
+				continue;
+			if (references_label(&v->entry[j]->instruction,
+					     v->entry[i]->string))
+				return 0;
+		}
+	}
+	return 1;
+}
+
+/* Once predicated, the then arm runs before the else arm for every
+ * channel, so the else arm must not read anything the then arm writes:
+ * a scalar or differently strided read would see the values written for
+ * the other channels.
+ */
+static int arms_independent(struct program_vector *v, int if_idx,
+			    int else_idx, int endif_idx)
+{
+	struct inst_regs then_regs, else_regs;
+	int i, j, d, u;
+
+	if (else_idx < 0)
+		return 1;
+	for (i = if_idx + 1; i < else_idx; i++) {
+		if (v->entry[i]->islabel)
+			continue;
+		instruction_regs(&v->entry[i]->instruction, &then_regs);
+		for (j = else_idx + 1; j < endif_idx; j++) {
+			if (v->entry[j]->islabel)
+				continue;
+			instruction_regs(&v->entry[j]->instruction, &else_regs);
+			for (d = 0; d < then_regs.ndefs; d++)
+				for (u = 0; u < else_regs.nuses; u++)
+					if (reg_ranges_overlap(&then_regs.defs[d],
+							       &else_regs.uses[u]))
+						return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Turns if/else blocks whose arms hold no more than max_arm_length simple
+ * ALU instructions into straight-line code predicated on the IF's flag,
+ * saving the IF/ELSE/ENDIF and their mask stack updates.
+ *
+ * Returns the number of blocks converted.  Each one is reported on stderr.
+ */
+int if_convert(struct brw_program *p, int max_arm_length)
+{
+	struct program_vector v;
+	int *addr;
+	int i, j, converted = 0;
+
+	if (program_symbolize_branches(p) != 0) {
+		fprintf(stderr, "if-convert: skipped, the program has branches "
+			"with unknown targets\n");
+		return 0;
+	}
+
+	program_to_vector(p, &v);
+	addr = calloc(v.count + 1, sizeof(*addr));
+	for (i = 0, j = 0; i < v.count; i++) {
+		addr[i] = j;
+		if (!v.entry[i]->islabel)
+			j++;
+	}
+
+	for (i = 0; i < v.count; i++) {
+		struct brw_program_instruction *entry = v.entry[i];
+		struct brw_instruction *cond;
+		int else_idx = -1, endif_idx = -1, arm = 0;
+		int length[2] = { 0, 0 };
+
+		if (!entry || entry->islabel)
+			continue;
+		cond = &entry->instruction;
+		if (cond->header.opcode != BRW_OPCODE_IF ||
+		    cond->header.predicate_control != BRW_PREDICATE_NORMAL)
+			continue;
+
+		for (j = i + 1; j < v.count; j++) {
+			struct brw_instruction *inst = &v.entry[j]->instruction;
+
+			if (v.entry[j]->islabel)
+				continue;
+			if (inst->header.opcode == BRW_OPCODE_ELSE && arm == 0) {
+				else_idx = j;
+				arm = 1;
+				continue;
+			}
+			if (inst->header.opcode == BRW_OPCODE_ENDIF) {
+				endif_idx = j;
+				break;
+			}
+			if (!if_convertible(inst, cond) ||
+			    ++length[arm] > max_arm_length)
+				break;
+		}
+
+		if (endif_idx < 0 ||
+		    !if_block_is_closed(&v, addr, i, else_idx, endif_idx) ||
+		    !arms_independent(&v, i, else_idx, endif_idx))
+			continue;
+
+		for (j = i + 1; j < endif_idx; j++) {
+			if (j == else_idx || v.entry[j]->islabel)
+				continue;
+			predicate_on(&v.entry[j]->instruction, cond,
+				     else_idx >= 0 && j > else_idx);
+		}
+
+		fprintf(stderr, "%s:%d: if-convert: predicated if block "
+			"(%d + %d instructions)\n",
+			entry->filename, entry->line, length[0], length[1]);
+		converted++;
+
+		free(v.entry[i]);
+		v.entry[i] = NULL;
+		if (else_idx >= 0) {
+			free(v.entry[else_idx]);
+			v.entry[else_idx] = NULL;
+		}
+		free(v.entry[endif_idx]);
+		v.entry[endif_idx] = NULL;
+		i = endif_idx;
+	}
+
+	free(addr);
+	vector_to_program(&v, p);
+	return converted;
+}
+
+/* An align1 source or destination operand, decoded from the instruction.
+ * Strides and width keep their encoded values; subreg_nr is in bytes.
+ */
+struct operand {
+	int file, type;
+	int reg_nr, subreg_nr;
+	int vert_stride, width, horiz_stride;
+	int abs, negate;
+	uint32_t imm;
+};
+
+static int get_src(struct brw_instruction *inst, int n, struct operand *op)
+{
+	memset(op, 0, sizeof(*op));
+	if (inst->header.access_mode != BRW_ALIGN_1)
+		return 0;
+
+	if (n == 0) {
+		op->file = inst->bits1.da1.src0_reg_file;
+		op->type = inst->bits1.da1.src0_reg_type;
+		if (op->file == BRW_IMMEDIATE_VALUE) {
+			op->imm = inst->bits3.ud;
+			return 1;
+		}
+		if (inst->bits2.da1.src0_address_mode != BRW_ADDRESS_DIRECT)
+			return 0;
+		op->reg_nr = inst->bits2.da1.src0_reg_nr;
+		op->subreg_nr = inst->bits2.da1.src0_subreg_nr;
+		op->vert_stride = inst->bits2.da1.src0_vert_stride;
+		op->width = inst->bits2.da1.src0_width;
+		op->horiz_stride = inst->bits2.da1.src0_horiz_stride;
+		op->abs = inst->bits2.da1.src0_abs;
+		op->negate = inst->bits2.da1.src0_negate;
+	} else {
+		if (inst->bits1.da1.src0_reg_file == BRW_IMMEDIATE_VALUE)
+			return 0;
+		op->file = inst->bits1.da1.src1_reg_file;
+		op->type = inst->bits1.da1.src1_reg_type;
+		if (op->file == BRW_IMMEDIATE_VALUE) {
+			op->imm = inst->bits3.ud;
+			return 1;
+		}
+		if (inst->bits3.da1.src1_address_mode != BRW_ADDRESS_DIRECT)
+			return 0;
+		op->reg_nr = inst->bits3.da1.src1_reg_nr;
+		op->subreg_nr = inst->bits3.da1.src1_subreg_nr;
+		op->vert_stride = inst->bits3.da1.src1_vert_stride;
+		op->width = inst->bits3.da1.src1_width;
+		op->horiz_stride = inst->bits3.da1.src1_horiz_stride;
+		op->abs = inst->bits3.da1.src1_abs;
+		op->negate = inst->bits3.da1.src1_negate;
+	}
+	return 1;
+}
+
+static int get_dst(struct brw_instruction *inst, struct operand *op)
+{
+	memset(op, 0, sizeof(*op));
+	if (inst->header.access_mode != BRW_ALIGN_1 ||
+	    inst->bits1.da1.dest_address_mode != BRW_ADDRESS_DIRECT)
+		return 0;
+
+	op->file = inst->bits1.da1.dest_reg_file;
+	op->type = inst->bits1.da1.dest_reg_type;
+	op->reg_nr = inst->bits1.da1.dest_reg_nr;
+	op->subreg_nr = inst->bits1.da1.dest_subreg_nr;
+	op->horiz_stride = inst->bits1.da1.dest_horiz_stride;
+	return 1;
+}
+
+static void operand_range(struct operand *op, int exec_size,
+			  struct reg_range *r)
+{
+	r->file = op->file;
+	r->start = op->reg_nr * 32 + op->subreg_nr;
+	r->end = r->start + exec_size * reg_type_size(op->type);
+}
+
+/* The bytes a direct source region reads, from its first element to
+ * just past its last one.
+ */
+static void region_range(struct operand *op, int exec_size,
+			 struct reg_range *r)
+{
+	int size = reg_type_size(op->type);
+	int width = 1 << op->width;
+	int hstride = op->horiz_stride ? 1 << (op->horiz_stride - 1) : 0;
+	int vstride = op->vert_stride ? 1 << (op->vert_stride - 1) : 0;
+	int rows = exec_size > width ? exec_size / width : 1;
+
+	r->file = op->file;
+	r->start = op->reg_nr * 32 + op->subreg_nr;
+	r->end = r->start + ((rows - 1) * vstride +
+			     ((exec_size < width ? exec_size : width) - 1) *
+			     hstride + 1) * size;
+}
+
+/* <0;1,0> */
+static int operand_is_scalar(struct operand *op)
+{
+	return op->vert_stride == BRW_VERTICAL_STRIDE_0 &&
+		op->width == BRW_WIDTH_1 &&
+		op->horiz_stride == BRW_HORIZONTAL_STRIDE_0;
+}
+
+/* Whether the region reads exec_size consecutive elements, such as
+ * <8;8,1> for SIMD8 or SIMD16.
+ */
+static int operand_is_contiguous(struct operand *op, int exec_size)
+{
+	int width = 1 << op->width;
+
+	if (op->horiz_stride != BRW_HORIZONTAL_STRIDE_1)
+		return 0;
+	return width >= exec_size ||
+		(op->vert_stride && 1 << (op->vert_stride - 1) == width);
+}
+
+/* Whether src reads back exactly what an instruction with destination dst
+ * and the same execution size wrote.
+ */
+static int operand_reads_dst(struct operand *src, struct operand *dst,
+			     int exec_size)
+{
+	return src->file == dst->file && src->type == dst->type &&
+		src->reg_nr == dst->reg_nr && src->subreg_nr == dst->subreg_nr &&
+		dst->horiz_stride == BRW_HORIZONTAL_STRIDE_1 &&
+		operand_is_contiguous(src, exec_size);
+}
+
+static int is_int_type(int type)
+{
+	return type != BRW_REGISTER_TYPE_F;
+}
+
+/* V, UV and VF immediates pack one small value per channel. */
+static int is_vector_imm(struct operand *op)
+{
+	return op->file == BRW_IMMEDIATE_VALUE &&
+		(op->type == BRW_REGISTER_TYPE_V ||
+		 op->type == BRW_REGISTER_TYPE_UV ||
+		 op->type == BRW_REGISTER_TYPE_VF);
+}
+
+static int is_dword_int_type(int type)
+{
+	return type == BRW_REGISTER_TYPE_D || type == BRW_REGISTER_TYPE_UD;
+}
+
+/* Whether the immediate holds value, read as the given type. */
+static int imm_equals(struct operand *op, int value)
+{
+	if (op->type == BRW_REGISTER_TYPE_F) {
+		union { float f; uint32_t ud; } u;
+
+		u.f = value;
+		return op->imm == u.ud;
+	}
+	if (reg_type_size(op->type) == 2)
+		return (op->imm & 0xffff) == (uint32_t)(value & 0xffff);
+	return op->imm == (uint32_t)value;
+}
+
+/* log2 of a dword power-of-two immediate, or -1. */
+static int imm_log2(struct operand *op)
+{
+	int k;
+
+	if (!is_dword_int_type(op->type) || op->imm == 0 ||
+	    (op->imm & (op->imm - 1)) != 0)
+		return -1;
+	if (op->type == BRW_REGISTER_TYPE_D && (int32_t)op->imm < 0)
+		return -1;
+	for (k = 0; (1u << k) != op->imm; k++)
+		;
+	return k;
+}
+
+/* Whether a and b run under the same execution and predicate masks. */
+static int same_execution(struct brw_instruction *a, struct brw_instruction *b)
+{
+	return a->header.access_mode == b->header.access_mode &&
+		a->header.execution_size == b->header.execution_size &&
+		a->header.compression_control == b->header.compression_control &&
+		a->header.mask_control == b->header.mask_control &&
+		a->header.predicate_control == b->header.predicate_control &&
+		a->header.predicate_inverse == b->header.predicate_inverse &&
+		(a->header.predicate_control == BRW_PREDICATE_NONE ||
+		 (a->bits2.da1.flag_reg_nr == b->bits2.da1.flag_reg_nr &&
+		  a->bits2.da1.flag_subreg_nr == b->bits2.da1.flag_subreg_nr));
+}
+
+/* Whether the bytes in r written by the instruction at idx are written
+ * again before anything reads them.  Only straight-line code is followed,
+ * up to the end of the thread; labels, branches and the end of the
+ * program count as reads, since the value may be used elsewhere.
+ */
+static int range_dead_after(struct program_vector *v, int idx,
+			    struct reg_range *r)
+{
+	struct brw_instruction *writer = &v->entry[idx]->instruction;
+	struct inst_regs regs;
+	int i, j;
+
+	for (i = idx + 1; i < v->count; i++) {
+		struct brw_instruction *inst;
+
+		if (!v->entry[i])
+			continue;
+		if (v->entry[i]->islabel)
+			return 0;
+		inst = &v->entry[i]->instruction;
+		if (instruction_is_control_flow(inst))
+			return 0;
+
+		instruction_regs(inst, &regs);
+		if (regs.indirect)
+			return 0;
+		for (j = 0; j < regs.nuses; j++)
+			if (reg_ranges_overlap(&regs.uses[j], r))
+				return 0;
+		if (instruction_ends_thread(inst))
+			return 1;
+
+		if (inst->header.predicate_control != BRW_PREDICATE_NONE ||
+		    (writer->header.mask_control == BRW_MASK_DISABLE &&
+		     inst->header.mask_control != BRW_MASK_DISABLE))
+			continue;
+		for (j = 0; j < regs.ndefs; j++)
+			if (reg_range_covers(&regs.defs[j], r))
+				return 1;
+	}
+	return 0;
+}
+
+static int next_instruction(struct program_vector *v, int idx)
+{
+	for (idx++; idx < v->count; idx++) {
+		if (!v->entry[idx])
+			continue;
+		if (v->entry[idx]->islabel)
+			return -1;
+		return idx;
+	}
+	return -1;
+}
+
+static void report(struct brw_program_instruction *entry, const char *what)
+{
+	fprintf(stderr, "%s:%d: simplify: %s\n",
+		entry->filename, entry->line, what);
+}
+
+static void drop_src1(struct brw_instruction *inst)
+{
+	inst->bits1.da1.src1_reg_file = BRW_ARCHITECTURE_REGISTER_FILE;
+	inst->bits1.da1.src1_reg_type = BRW_REGISTER_TYPE_UD;
+	inst->bits3.ud = 0;
+}
+
+/* add x, 0 and mul x, 1 become mov; integer mul by 2^k becomes shl and
+ * unsigned division by 2^k becomes shr or and.  A float add only folds
+ * for -0.0, since x + 0.0 turns -0.0 into +0.0.
+ */
+static int simplify_instruction(struct brw_program_instruction *entry)
+{
+	struct brw_instruction *inst = &entry->instruction;
+	struct operand dst, src0, src1;
+	int k;
+
+	if (inst->header.acc_wr_control ||
+	    !get_dst(inst, &dst) || !get_src(inst, 0, &src0) ||
+	    !get_src(inst, 1, &src1) ||
+	    src0.file == BRW_IMMEDIATE_VALUE ||
+	    src1.file != BRW_IMMEDIATE_VALUE || is_vector_imm(&src1) ||
+	    is_int_type(src0.type) != is_int_type(src1.type))
+		return 0;
+
+	switch (inst->header.opcode) {
+	case BRW_OPCODE_ADD:
+		if (src1.type == BRW_REGISTER_TYPE_F ? src1.imm != 0x80000000 :
+		    !imm_equals(&src1, 0))
+			return 0;
+		inst->header.opcode = BRW_OPCODE_MOV;
+		drop_src1(inst);
+		report(entry, "add of 0 replaced with mov");
+		return 1;
+
+	case BRW_OPCODE_MUL:
+		if (imm_equals(&src1, 1)) {
+			inst->header.opcode = BRW_OPCODE_MOV;
+			drop_src1(inst);
+			report(entry, "mul by 1 replaced with mov");
+			return 1;
+		}
+		/* Only the low dword of a D x D product is kept, which is
+		 * what the shift produces too.
+		 */
+		k = imm_log2(&src1);
+		if (k < 1 || inst->header.saturate ||
+		    !is_dword_int_type(dst.type) || !is_dword_int_type(src0.type))
+			return 0;
+		inst->header.opcode = BRW_OPCODE_SHL;
+		inst->bits3.ud = k;
+		report(entry, "mul by power of two replaced with shl");
+		return 1;
+
+	case BRW_OPCODE_MATH:
+		if (!IS_GENp(6) || dst.type != BRW_REGISTER_TYPE_UD ||
+		    src0.type != BRW_REGISTER_TYPE_UD ||
+		    src1.type != BRW_REGISTER_TYPE_UD)
+			return 0;
+		k = imm_log2(&src1);
+		if (k < 0)
+			return 0;
+		switch (inst->header.sfid_destreg__conditionalmod) {
+		case BRW_MATH_FUNCTION_INT_DIV_QUOTIENT:
+			inst->header.opcode = BRW_OPCODE_SHR;
+			inst->bits3.ud = k;
+			report(entry, "unsigned division by power of two "
+			       "replaced with shr");
+			break;
+		case BRW_MATH_FUNCTION_INT_DIV_REMAINDER:
+			inst->header.opcode = BRW_OPCODE_AND;
+			inst->bits3.ud = (1u << k) - 1;
+			report(entry, "unsigned remainder by power of two "
+			       "replaced with and");
+			break;
+		default:
+			return 0;
+		}
+		inst->header.sfid_destreg__conditionalmod = BRW_CONDITIONAL_NONE;
+		return 1;
+
+	default:
+		return 0;
+	}
+}
+
+/* A mad operand: contiguous and vec4 aligned, or a replicated scalar. */
+static int mad_operand_ok(struct operand *op, int exec_size)
+{
+	if (op->file != BRW_GENERAL_REGISTER_FILE ||
+	    op->type != BRW_REGISTER_TYPE_F)
+		return 0;
+	if (operand_is_scalar(op))
+		return op->subreg_nr % 4 == 0;
+	return operand_is_contiguous(op, exec_size) && op->subreg_nr % 16 == 0;
+}
+
+static void set_mad_src(struct brw_instruction *mad, int n,
+			struct operand *op, int negate)
+{
+	int rep_ctrl = operand_is_scalar(op);
+	int subreg_nr = op->subreg_nr / 4;
+	int modifier = (op->abs ? BRW_3SRC_MODIFIER_ABS : 0) |
+		(op->negate ^ negate ? BRW_3SRC_MODIFIER_NEGATE : 0);
+
+	switch (n) {
+	case 0:
+		mad->bits1.three_src_gen6.src0_modifier = modifier;
+		mad->bits2.three_src_gen6.src0_rep_ctrl = rep_ctrl;
+		mad->bits2.three_src_gen6.src0_swizzle = BRW_SWIZZLE_NOOP;
+		mad->bits2.three_src_gen6.src0_subreg_nr = subreg_nr;
+		mad->bits2.three_src_gen6.src0_reg_nr = op->reg_nr;
+		break;
+	case 1:
+		mad->bits1.three_src_gen6.src1_modifier = modifier;
+		mad->bits2.three_src_gen6.src1_rep_ctrl = rep_ctrl;
+		mad->bits2.three_src_gen6.src1_swizzle = BRW_SWIZZLE_NOOP;
+		mad->bits2.three_src_gen6.src1_subreg_nr_low = subreg_nr & 3;
+		mad->bits3.three_src_gen6.src1_subreg_nr_high = subreg_nr >> 2;
+		mad->bits3.three_src_gen6.src1_reg_nr = op->reg_nr;
+		break;
+	case 2:
+		mad->bits1.three_src_gen6.src2_modifier = modifier;
+		mad->bits3.three_src_gen6.src2_rep_ctrl = rep_ctrl;
+		mad->bits3.three_src_gen6.src2_swizzle = BRW_SWIZZLE_NOOP;
+		mad->bits3.three_src_gen6.src2_subreg_nr = subreg_nr;
+		mad->bits3.three_src_gen6.src2_reg_nr = op->reg_nr;
+		break;
+	}
+}
+
+/* The multiply and add must be adjacent, with the product only read
+ * by the add.  Neither may write the accumulator, and the mul may not
+ * saturate or set flags, since the fused instruction would do it on
+ * the sum instead.
+ */
+static int fusable(struct brw_instruction *mul, struct brw_instruction *add)
+{
+	return mul->header.opcode == BRW_OPCODE_MUL &&
+		add->header.opcode == BRW_OPCODE_ADD &&
+		same_execution(mul, add) &&
+		mul->header.access_mode == BRW_ALIGN_1 &&
+		!mul->header.saturate && !mul->header.acc_wr_control &&
+		!add->header.acc_wr_control &&
+		!mul->header.dependency_control &&
+		!add->header.dependency_control &&
+		mul->header.sfid_destreg__conditionalmod == BRW_CONDITIONAL_NONE;
+}
+
+/* Finds which source of add reads the product mul wrote, and checks the
+ * product isn't needed afterwards and isn't also read through the other
+ * source, which would see the old value once the mul is gone.  Returns
+ * the source number or -1.
+ */
+static int product_src(struct program_vector *v, int mul_idx, int add_idx)
+{
+	struct brw_instruction *mul = &v->entry[mul_idx]->instruction;
+	struct brw_instruction *add = &v->entry[add_idx]->instruction;
+	int exec_size = instruction_exec_size(mul);
+	struct operand t, d, s, o;
+	struct reg_range product, sum, other;
+	int n;
+
+	if (!get_dst(mul, &t) || !get_dst(add, &d) ||
+	    t.type != BRW_REGISTER_TYPE_F)
+		return -1;
+
+	for (n = 0; n < 2; n++) {
+		if (get_src(add, n, &s) && !s.abs &&
+		    operand_reads_dst(&s, &t, exec_size))
+			break;
+	}
+	if (n == 2)
+		return -1;
+
+	operand_range(&t, exec_size, &product);
+	if (!get_src(add, !n, &o))
+		return -1;
+	if (o.file != BRW_IMMEDIATE_VALUE) {
+		region_range(&o, exec_size, &other);
+		if (reg_ranges_overlap(&other, &product))
+			return -1;
+	}
+	operand_range(&d, exec_size, &sum);
+	if (!reg_range_covers(&sum, &product) &&
+	    !range_dead_after(v, add_idx, &product))
+		return -1;
+	return n;
+}
+
+/* mul t, a, b; add d, t, c  ->  mad d, c, a, b */
+static int fuse_mad(struct program_vector *v, int mul_idx, int add_idx)
+{
+	struct brw_instruction *mul = &v->entry[mul_idx]->instruction;
+	struct brw_instruction *add = &v->entry[add_idx]->instruction;
+	int exec_size = instruction_exec_size(mul);
+	struct brw_instruction mad;
+	struct operand a, b, c, t, d;
+	int n;
+
+	if (exec_size > (IS_GENx(6) ? 8 : 16))
+		return 0;
+
+	n = product_src(v, mul_idx, add_idx);
+	if (n < 0)
+		return 0;
+
+	get_src(add, n, &t);
+	get_dst(add, &d);
+	if (!get_src(mul, 0, &a) || !get_src(mul, 1, &b) ||
+	    !get_src(add, !n, &c) ||
+	    !mad_operand_ok(&a, exec_size) || !mad_operand_ok(&b, exec_size) ||
+	    !mad_operand_ok(&c, exec_size))
+		return 0;
+	if (d.type != BRW_REGISTER_TYPE_F ||
+	    d.horiz_stride != BRW_HORIZONTAL_STRIDE_1 || d.subreg_nr % 16 ||
+	    !(d.file == BRW_GENERAL_REGISTER_FILE ||
+	      (IS_GENx(6) && d.file == BRW_MESSAGE_REGISTER_FILE)))
+		return 0;
+
+	memset(&mad, 0, sizeof(mad));
+	mad.header = add->header;
+	mad.header.opcode = BRW_OPCODE_MAD;
+	mad.header.access_mode = BRW_ALIGN_16;
+	mad.bits1.three_src_gen6.flag_reg_nr = add->bits2.da1.flag_reg_nr;
+	mad.bits1.three_src_gen6.flag_subreg_nr = add->bits2.da1.flag_subreg_nr;
+	mad.bits1.three_src_gen6.dest_reg_file =
+		d.file == BRW_MESSAGE_REGISTER_FILE;
+	mad.bits1.three_src_gen6.dest_reg_nr = d.reg_nr;
+	mad.bits1.three_src_gen6.dest_subreg_nr = d.subreg_nr / 4;
+	mad.bits1.three_src_gen6.dest_writemask = BRW_WRITEMASK_XYZW;
+	/* 3-src types: 0 is F for both */
+	set_mad_src(&mad, 0, &c, 0);
+	set_mad_src(&mad, 1, &a, t.negate);
+	set_mad_src(&mad, 2, &b, 0);
+
+	*add = mad;
+	return 1;
+}
+
+/* mul c, x, y; mul t, a, b; add d, c, t  ->  mul acc0, x, y; mac d, a, b */
+static int fuse_mac(struct program_vector *v, int mul1_idx, int mul2_idx,
+		    int add_idx)
+{
+	struct brw_instruction *mul1 = &v->entry[mul1_idx]->instruction;
+	struct brw_instruction *mul2 = &v->entry[mul2_idx]->instruction;
+	struct brw_instruction *add = &v->entry[add_idx]->instruction;
+	int exec_size = instruction_exec_size(mul1);
+	struct operand c, cs, t, ts, d;
+	struct reg_range c_range, acc, sum;
+	struct inst_regs regs;
+	int n, i;
+
+	if (!fusable(mul1, add) || !fusable(mul2, add))
+		return 0;
+
+	n = product_src(v, mul2_idx, add_idx);
+	if (n < 0 || !get_dst(mul1, &c) || !get_dst(add, &d) ||
+	    c.type != BRW_REGISTER_TYPE_F || d.type != BRW_REGISTER_TYPE_F)
+		return 0;
+	get_src(add, n, &ts);
+	get_src(add, !n, &cs);
+	get_dst(mul2, &t);
+	if (ts.negate || cs.abs || cs.negate ||
+	    !operand_reads_dst(&cs, &c, exec_size))
+		return 0;
+
+	/* mul2 must not read the first product, which no longer lands
+	 * in c, nor the accumulator it now lands in, and both products
+	 * must be gone after the add.
+	 */
+	operand_range(&c, exec_size, &c_range);
+	acc.file = BRW_ARCHITECTURE_REGISTER_FILE;
+	acc.start = BRW_ARF_ACCUMULATOR * 32;
+	acc.end = acc.start + 64;
+	instruction_regs(mul2, &regs);
+	for (i = 0; i < regs.nuses; i++)
+		if (reg_ranges_overlap(&regs.uses[i], &c_range) ||
+		    reg_ranges_overlap(&regs.uses[i], &acc))
+			return 0;
+	for (i = 0; i < regs.ndefs; i++)
+		if (reg_ranges_overlap(&regs.defs[i], &c_range))
+			return 0;
+	operand_range(&d, exec_size, &sum);
+	if (!reg_range_covers(&sum, &c_range) &&
+	    !range_dead_after(v, add_idx, &c_range))
+		return 0;
+	if (!range_dead_after(v, add_idx, &acc))
+		return 0;
+
+	mul1->bits1.da1.dest_reg_file = BRW_ARCHITECTURE_REGISTER_FILE;
+	mul1->bits1.da1.dest_reg_nr = BRW_ARF_ACCUMULATOR;
+	mul1->bits1.da1.dest_subreg_nr = 0;
+
+	mul2->header.opcode = BRW_OPCODE_MAC;
+	mul2->header.saturate = add->header.saturate;
+	mul2->header.sfid_destreg__conditionalmod =
+		add->header.sfid_destreg__conditionalmod;
+	mul2->bits1.da1.dest_reg_file = add->bits1.da1.dest_reg_file;
+	mul2->bits1.da1.dest_reg_type = add->bits1.da1.dest_reg_type;
+	mul2->bits1.da1.dest_reg_nr = add->bits1.da1.dest_reg_nr;
+	mul2->bits1.da1.dest_subreg_nr = add->bits1.da1.dest_subreg_nr;
+	mul2->bits1.da1.dest_horiz_stride = add->bits1.da1.dest_horiz_stride;
+	return 1;
+}
+
+/**
+ * Folds add of 0 and mul by 1 into mov, turns integer multiplies and
+ * unsigned divides by powers of two into shifts, and fuses a mul whose
+ * product is only read by the following add into mad on Gen6+, or into
+ * an accumulator mac on Gen4/5.
+ *
+ * Returns the number of instructions rewritten.  Each one is reported
+ * on stderr.
+ */
+int simplify_arithmetic(struct brw_program *p)
+{
+	struct program_vector v;
+	int i, j, k, changed = 0;
+
+	if (program_symbolize_branches(p) != 0) {
+		fprintf(stderr, "simplify: skipped, the program has branches "
+			"with unknown targets\n");
+		return 0;
+	}
+
+	program_to_vector(p, &v);
+
+	for (i = 0; i < v.count; i++)
+		if (!v.entry[i]->islabel)
+			changed += simplify_instruction(v.entry[i]);
+
+	for (i = 0; i < v.count; i++) {
+		if (!v.entry[i] || v.entry[i]->islabel)
+			continue;
+		j = next_instruction(&v, i);
+		if (j < 0)
+			continue;
+
+		if (IS_GENp(6)) {
+			if (!fusable(&v.entry[i]->instruction,
+				     &v.entry[j]->instruction) ||
+			    !fuse_mad(&v, i, j))
+				continue;
+			report(v.entry[i], "mul and add fused into mad");
+			free(v.entry[i]);
+			v.entry[i] = NULL;
+			changed++;
+		} else {
+			k = next_instruction(&v, j);
+			if (k < 0 || !fuse_mac(&v, i, j, k))
+				continue;
+			report(v.entry[j], "mul and add fused into mac");
+			free(v.entry[k]);
+			v.entry[k] = NULL;
+			changed++;
+			i = k;
+		}
+	}
+
+	vector_to_program(&v, p);
+	return changed;
+}
+
+/* Whether the message payload of a send later in the same block reads r. */
+static int feeds_send(struct program_vector *v, int idx, struct reg_range *r)
+{
+	struct inst_regs regs;
+	int i, j;
+
+	for (i = idx + 1; i < v->count; i++) {
+		struct brw_instruction *inst;
+
+		if (!v->entry[i])
+			continue;
+		if (v->entry[i]->islabel)
+			return 0;
+		inst = &v->entry[i]->instruction;
+		if (instruction_is_control_flow(inst))
+			return 0;
+		if (inst->header.opcode != BRW_OPCODE_SEND &&
+		    inst->header.opcode != BRW_OPCODE_SENDC)
+			continue;
+		instruction_regs(inst, &regs);
+		for (j = 0; j < regs.nuses; j++)
+			if (reg_ranges_overlap(&regs.uses[j], r))
+				return 1;
+	}
+	return 0;
+}
+
+/* Whether the instruction's destination may be switched to the register
+ * a payload mov writes.
+ */
+static int can_retarget(struct brw_instruction *inst, struct operand *dst)
+{
+	if (inst->header.opcode == BRW_OPCODE_SEND ||
+	    inst->header.opcode == BRW_OPCODE_SENDC ||
+	    instruction_is_control_flow(inst) ||
+	    instruction_is_three_src(inst))
+		return 0;
+
+	/* Gen6 math can only write the GRF. */
+	if (inst->header.opcode == BRW_OPCODE_MATH &&
+	    dst->file == BRW_MESSAGE_REGISTER_FILE)
+		return 0;
+
+	return 1;
+}
+
+/* Looks for the instruction writing the value the mov at mov_idx copies
+ * into the message payload, and if the copy is the only reader, makes
+ * that instruction write the payload directly.  Returns the index of the
+ * rewritten producer, or -1.
+ */
+static int propagate_payload_copy(struct program_vector *v, int mov_idx)
+{
+	struct brw_instruction *mov = &v->entry[mov_idx]->instruction;
+	int exec_size = instruction_exec_size(mov);
+	struct operand md, ms, pd;
+	struct reg_range value, payload;
+	struct inst_regs regs;
+	int i, j;
+
+	if (mov->header.opcode != BRW_OPCODE_MOV || mov->header.saturate ||
+	    mov->header.acc_wr_control ||
+	    mov->header.sfid_destreg__conditionalmod != BRW_CONDITIONAL_NONE ||
+	    !get_dst(mov, &md) || !get_src(mov, 0, &ms) ||
+	    ms.file != BRW_GENERAL_REGISTER_FILE || ms.abs || ms.negate ||
+	    md.type != ms.type ||
+	    md.horiz_stride != BRW_HORIZONTAL_STRIDE_1 ||
+	    !operand_is_contiguous(&ms, exec_size))
+		return -1;
+
+	operand_range(&md, exec_size, &payload);
+	if (md.file == BRW_MESSAGE_REGISTER_FILE) {
+		if (md.reg_nr & 0x80)
+			return -1;
+	} else if (!(IS_GENp(7) && md.file == BRW_GENERAL_REGISTER_FILE &&
+		     feeds_send(v, mov_idx, &payload))) {
+		return -1;
+	}
+
+	/* Walk back to the producer.  Nothing in between may touch the
+	 * payload registers or read the value, since it will no longer be
+	 * in the GRF.
+	 */
+	operand_range(&ms, exec_size, &value);
+	for (i = mov_idx - 1; i >= 0; i--) {
+		struct brw_instruction *inst;
+		int writes_value = 0;
+
+		if (!v->entry[i])
+			continue;
+		if (v->entry[i]->islabel)
+			return -1;
+		inst = &v->entry[i]->instruction;
+		if (instruction_is_control_flow(inst))
+			return -1;
+
+		instruction_regs(inst, &regs);
+		if (regs.indirect)
+			return -1;
+		for (j = 0; j < regs.ndefs; j++) {
+			if (reg_ranges_overlap(&regs.defs[j], &payload))
+				return -1;
+			if (reg_ranges_overlap(&regs.defs[j], &value))
+				writes_value = 1;
+		}
+		for (j = 0; j < regs.nuses; j++) {
+			if (reg_ranges_overlap(&regs.uses[j], &payload))
+				return -1;
+			if (!writes_value &&
+			    reg_ranges_overlap(&regs.uses[j], &value))
+				return -1;
+		}
+		if (writes_value)
+			break;
+	}
+	if (i < 0)
+		return -1;
+
+	if (!get_dst(&v->entry[i]->instruction, &pd) ||
+	    !operand_reads_dst(&ms, &pd, exec_size) ||
+	    !same_execution(&v->entry[i]->instruction, mov) ||
+	    !can_retarget(&v->entry[i]->instruction, &md) ||
+	    !range_dead_after(v, mov_idx, &value))
+		return -1;
+
+	/* The producer itself may read the payload registers: it reads
+	 * its sources before writing.
+	 */
+	v->entry[i]->instruction.bits1.da1.dest_reg_file = md.file;
+	v->entry[i]->instruction.bits1.da1.dest_reg_nr = md.reg_nr;
+	v->entry[i]->instruction.bits1.da1.dest_subreg_nr = md.subreg_nr;
+	return i;
+}
+
+/**
+ * Removes movs that copy a freshly computed GRF value into a send's
+ * message payload, by having the instruction computing the value write
+ * the message register directly.  On Gen7, which has no MRF, payloads
+ * assembled in the GRF are handled the same way.
+ *
+ * Returns the number of movs removed.  Each one is reported on stderr.
+ */
+int propagate_payload_copies(struct brw_program *p)
+{
+	struct program_vector v;
+	int i, removed = 0;
+
+	if (program_symbolize_branches(p) != 0) {
+		fprintf(stderr, "copy-prop: skipped, the program has branches "
+			"with unknown targets\n");
+		return 0;
+	}
+
+	program_to_vector(p, &v);
+	for (i = 0; i < v.count; i++) {
+		if (v.entry[i]->islabel ||
+		    propagate_payload_copy(&v, i) < 0)
+			continue;
+		fprintf(stderr, "%s:%d: copy-prop: payload mov folded into "
+			"the instruction computing it\n",
+			v.entry[i]->filename, v.entry[i]->line);
+		free(v.entry[i]);
+		v.entry[i] = NULL;
+		removed++;
+	}
+	vector_to_program(&v, p);
+	return removed;
+}
+
+/* Points every direct GRF operand of inst at register from to register
+ * to instead.
+ */
+static void rename_grf(struct brw_instruction *inst, int from, int to)
+{
+	if (instruction_is_three_src(inst)) {
+		if (inst->bits1.three_src_gen6.dest_reg_nr == from)
+			inst->bits1.three_src_gen6.dest_reg_nr = to;
+		if (inst->bits2.three_src_gen6.src0_reg_nr == from)
+			inst->bits2.three_src_gen6.src0_reg_nr = to;
+		if (inst->bits3.three_src_gen6.src1_reg_nr == from)
+			inst->bits3.three_src_gen6.src1_reg_nr = to;
+		if (inst->bits3.three_src_gen6.src2_reg_nr == from)
+			inst->bits3.three_src_gen6.src2_reg_nr = to;
+		return;
+	}
+
+	/* The register numbers sit at the same bits in align1 and align16. */
+	if (inst->bits1.da1.dest_reg_file == BRW_GENERAL_REGISTER_FILE &&
+	    inst->bits1.da1.dest_address_mode == BRW_ADDRESS_DIRECT &&
+	    inst->bits1.da1.dest_reg_nr == from)
+		inst->bits1.da1.dest_reg_nr = to;
+	if (inst->bits1.da1.src0_reg_file == BRW_IMMEDIATE_VALUE)
+		return;
+	if (inst->bits1.da1.src0_reg_file == BRW_GENERAL_REGISTER_FILE &&
+	    inst->bits2.da1.src0_address_mode == BRW_ADDRESS_DIRECT &&
+	    inst->bits2.da1.src0_reg_nr == from)
+		inst->bits2.da1.src0_reg_nr = to;
+	if (inst->bits1.da1.src1_reg_file == BRW_GENERAL_REGISTER_FILE &&
+	    inst->bits3.da1.src1_address_mode == BRW_ADDRESS_DIRECT &&
+	    inst->bits3.da1.src1_reg_nr == from)
+		inst->bits3.da1.src1_reg_nr = to;
+}
+
+static int count_bank_conflicts(struct brw_instruction **insts, int n)
+{
+	int i, count = 0;
+
+	for (i = 0; i < n; i++)
+		count += three_src_bank_conflict(insts[i]);
+	return count;
+}
+
+/* Marks the GRFs the program touches, and those it can rename: only
+ * accessed a whole register at a time, and not by sends, whose payloads
+ * have placement rules of their own.
+ */
+static void grf_usage(struct brw_instruction **insts, int n, char *used,
+		      char *renamable)
+{
+	struct inst_regs regs;
+	struct reg_range *r;
+	int i, j, reg;
+
+	memset(used, 0, GRF_COUNT);
+	memset(renamable, 1, GRF_COUNT);
+	for (i = 0; i < n; i++) {
+		int opcode = insts[i]->header.opcode;
+
+		instruction_regs(insts[i], &regs);
+		for (j = 0; j < regs.ndefs + regs.nuses; j++) {
+			r = j < regs.ndefs ? &regs.defs[j] :
+				&regs.uses[j - regs.ndefs];
+			if (r->file != BRW_GENERAL_REGISTER_FILE)
+				continue;
+			for (reg = r->start / 32;
+			     reg <= (r->end - 1) / 32 && reg < GRF_COUNT; reg++) {
+				used[reg] = 1;
+				if (r->start < reg * 32 || r->end > reg * 32 + 32 ||
+				    opcode == BRW_OPCODE_SEND ||
+				    opcode == BRW_OPCODE_SENDC)
+					renamable[reg] = 0;
+			}
+		}
+	}
+}
+
+/**
+ * Removes Gen7 three-source register bank conflicts by renaming src1 or
+ * src2 throughout the program to an unused GRF in another bank, below
+ * the highest register already in use so the thread needs no more
+ * registers.  A rename is kept only if it lowers the number of
+ * conflicts.  Payload registers, registers read as part of wider regions
+ * or by sends, and programs with indirect addressing are left alone.
+ *
+ * Runs on the resolved program, as renaming doesn't move instructions.
+ * Returns the number of registers renamed.
+ */
+int fix_bank_conflicts(struct brw_program *p)
+{
+	struct brw_program_instruction *entry, **entries;
+	struct brw_instruction **insts;
+	char payload[GRF_COUNT], used[GRF_COUNT], renamable[GRF_COUNT];
+	int n, i, s, u, last, before, renamed = 0;
+
+	if (!IS_GENp(7))
+		return 0;
+
+	n = program_instructions(p, &insts);
+	if (count_bank_conflicts(insts, n) == 0) {
+		free(insts);
+		return 0;
+	}
+	if (program_payload_grfs(insts, n, payload)) {
+		fprintf(stderr, "bank-conflict: skipped, the program addresses "
+			"registers indirectly\n");
+		free(insts);
+		return 0;
+	}
+
+	entries = calloc(n + 1, sizeof(*entries));
+	for (i = 0, entry = p->first; entry; entry = entry->next)
+		if (!entry->islabel)
+			entries[i++] = entry;
+
+	grf_usage(insts, n, used, renamable);
+	for (last = GRF_COUNT - 1; last > 0 && !used[last]; last--)
+		;
+
+	for (i = 0; i < n; i++) {
+		if (!three_src_bank_conflict(insts[i]))
+			continue;
+
+		for (s = 2; s >= 1; s--) {
+			struct brw_instruction *inst = insts[i];
+			int reg = s == 2 ? inst->bits3.three_src_gen6.src2_reg_nr :
+				inst->bits3.three_src_gen6.src1_reg_nr;
+			int other = s == 2 ? inst->bits3.three_src_gen6.src1_reg_nr :
+				inst->bits3.three_src_gen6.src2_reg_nr;
+			int j;
+
+			if (!renamable[reg] || payload[reg])
+				continue;
+
+			for (u = 0; u < last; u++) {
+				if (used[u] || payload[u] ||
+				    grf_bank(u) == grf_bank(other))
+					continue;
+
+				before = count_bank_conflicts(insts, n);
+				for (j = 0; j < n; j++)
+					rename_grf(insts[j], reg, u);
+				if (count_bank_conflicts(insts, n) < before)
+					break;
+				for (j = 0; j < n; j++)
+					rename_grf(insts[j], u, reg);
+			}
+			if (u == last)
+				continue;
+
+			fprintf(stderr, "%s:%d: bank-conflict: renamed g%d to "
+				"g%d\n", entries[i]->filename, entries[i]->line,
+				reg, u);
+			used[u] = renamable[u] = 1;
+			used[reg] = renamable[reg] = 0;
+			renamed++;
+			break;
+		}
+	}
+
+	free(entries);
+	free(insts);
+	return renamed;
+}
+
+/* Returns the first instruction of the block after the send at i that
+ * reads one of its results, or -1 if none does.  Stores the cycles the
+ * instructions in between take to issue.
+ */
+static int first_consumer(struct brw_instruction **insts,
+			  struct basic_block *block, int i, int *cycles)
+{
+	struct inst_regs send, regs;
+	int j, k, d;
+
+	instruction_regs(insts[i], &send);
+	*cycles = 0;
+	for (j = i + 1; j < block->end; j++) {
+		instruction_regs(insts[j], &regs);
+		for (k = 0; k < regs.nuses; k++)
+			for (d = 0; d < send.ndefs; d++)
+				if (reg_ranges_overlap(&regs.uses[k],
+						       &send.defs[d]))
+					return j;
+		*cycles += instruction_issue_cycles(insts[j]);
+	}
+	return -1;
+}
+
+/**
+ * Sets the switch thread control on the last instruction before one that
+ * reads the result of a send too early for the independent work in
+ * between to cover the send's latency, so that the EU runs other threads
+ * instead of stalling on the dependency.  Sends whose results are read in
+ * another block, or late enough, are left alone, as are instructions
+ * that are already atomic.
+ *
+ * Runs on the resolved program, as it doesn't move instructions.
+ * Returns the number of hints placed.
+ */
+int place_switch_hints(struct brw_program *p)
+{
+	struct brw_program_instruction *entry, **entries;
+	struct brw_instruction **insts;
+	struct basic_block *blocks;
+	int n, nblocks, b, i, j, cycles, placed = 0;
+
+	n = program_instructions(p, &insts);
+	nblocks = program_basic_blocks(insts, n, &blocks);
+	entries = calloc(n + 1, sizeof(*entries));
+	for (i = 0, entry = p->first; entry; entry = entry->next)
+		if (!entry->islabel)
+			entries[i++] = entry;
+
+	for (b = 0; b < nblocks; b++) {
+		for (i = blocks[b].start; i < blocks[b].end; i++) {
+			struct brw_instruction *hint;
+			int opcode = insts[i]->header.opcode;
+
+			if (opcode != BRW_OPCODE_SEND &&
+			    opcode != BRW_OPCODE_SENDC)
+				continue;
+			j = first_consumer(insts, &blocks[b], i, &cycles);
+			if (j < 0 || cycles >= instruction_latency(insts[i]))
+				continue;
+
+			hint = insts[j - 1];
+			if (hint->header.thread_control != BRW_THREAD_NORMAL)
+				continue;
+			hint->header.thread_control = BRW_THREAD_SWITCH;
+			fprintf(stderr, "%s:%d: switch-hint: switching threads "
+				"here, line %d waits on the send at line %d\n",
+				entries[j - 1]->filename, entries[j - 1]->line,
+				entries[j]->line, entries[i]->line);
+			placed++;
+		}
+	}
+
+	free(entries);
+	free(blocks);
+	free(insts);
+	return placed;
+}
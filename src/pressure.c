@@ -0,0 +1,321 @@
+/* -*- c-basic-offset: 8 -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * GRF liveness and register pressure of a program, checked against its
+ * .reg_count_total and .reg_count_payload pragmas.
+ *
+ * A GRF is live between a write and the last read that may see it.  Only
+ * unpredicated writes covering the whole register end a live range; as
+ * usual for SIMD liveness, writes inside divergent control flow are
+ * still taken to kill, so a value merged from both arms of an if is live
+ * from the two writes on.  Registers read before any write are the
+ * thread payload.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gen4asm.h"
+
+extern char *input_filename;
+
+#define REG_SIZE	32
+#define SET_WORDS	(GRF_COUNT / 32)
+
+struct grf_set {
+	unsigned int w[SET_WORDS];
+};
+
+static void set_add(struct grf_set *s, int reg)
+{
+	s->w[reg / 32] |= 1u << (reg % 32);
+}
+
+static int set_has(struct grf_set *s, int reg)
+{
+	return (s->w[reg / 32] >> (reg % 32)) & 1;
+}
+
+static int set_count(struct grf_set *s)
+{
+	int i, n = 0;
+
+	for (i = 0; i < GRF_COUNT; i++)
+		n += set_has(s, i);
+	return n;
+}
+
+/* Highest register in the set, or -1 if it is empty. */
+static int set_last(struct grf_set *s)
+{
+	int i;
+
+	for (i = GRF_COUNT - 1; i >= 0; i--)
+		if (set_has(s, i))
+			return i;
+	return -1;
+}
+
+static void set_union(struct grf_set *d, struct grf_set *s)
+{
+	int i;
+
+	for (i = 0; i < SET_WORDS; i++)
+		d->w[i] |= s->w[i];
+}
+
+/* Adds the GRFs a range touches, if it is in the GRF. */
+static void set_add_range(struct grf_set *s, struct reg_range *r)
+{
+	int i;
+
+	if (r->file != BRW_GENERAL_REGISTER_FILE)
+		return;
+	for (i = r->start / REG_SIZE; i <= (r->end - 1) / REG_SIZE &&
+		     i < GRF_COUNT; i++)
+		set_add(s, i);
+}
+
+struct grf_access {
+	struct grf_set use;	/* read */
+	struct grf_set def;	/* written */
+	struct grf_set kill;	/* overwritten completely */
+};
+
+static void instruction_grfs(struct brw_instruction *inst,
+			     struct grf_access *a, int *indirect)
+{
+	struct inst_regs regs;
+	int i, j;
+
+	memset(a, 0, sizeof(*a));
+	instruction_regs(inst, &regs);
+	*indirect |= regs.indirect;
+
+	for (i = 0; i < regs.nuses; i++)
+		set_add_range(&a->use, &regs.uses[i]);
+	for (i = 0; i < regs.ndefs; i++) {
+		struct reg_range *r = &regs.defs[i];
+
+		set_add_range(&a->def, r);
+		if (r->file != BRW_GENERAL_REGISTER_FILE ||
+		    inst->header.predicate_control != BRW_PREDICATE_NONE)
+			continue;
+		for (j = (r->start + REG_SIZE - 1) / REG_SIZE;
+		     j < r->end / REG_SIZE && j < GRF_COUNT; j++)
+			set_add(&a->kill, j);
+	}
+}
+
+/* live_in = use | (live_out & ~kill), iterated backwards to a fixed
+ * point.
+ */
+static void grf_liveness(struct brw_instruction **insts, int n,
+			 struct grf_access *access, struct grf_set *live_in,
+			 struct grf_set *live_out)
+{
+	int *succ = calloc(n + 2, sizeof(*succ));
+	int i, j, ns, changed;
+
+	do {
+		changed = 0;
+		for (i = n - 1; i >= 0; i--) {
+			struct grf_set in;
+
+			ns = instruction_successors(insts, n, i, succ, NULL);
+			for (j = 0; j < ns; j++)
+				set_union(&live_out[i], &live_in[succ[j]]);
+
+			for (j = 0; j < SET_WORDS; j++)
+				in.w[j] = access[i].use.w[j] |
+					(live_out[i].w[j] & ~access[i].kill.w[j]);
+			if (memcmp(&in, &live_in[i], sizeof(in))) {
+				live_in[i] = in;
+				changed = 1;
+			}
+		}
+	} while (changed);
+	free(succ);
+}
+
+/**
+ * Marks in payload, of GRF_COUNT entries, the GRFs that some path reads
+ * before writing them, which the thread has to be dispatched with.
+ *
+ * Returns whether some register is addressed indirectly, in which case
+ * any register may be part of the payload.
+ */
+int program_payload_grfs(struct brw_instruction **insts, int n,
+			 char *payload)
+{
+	struct grf_access *access = calloc(n + 1, sizeof(*access));
+	struct grf_set *live_in = calloc(n + 1, sizeof(*live_in));
+	struct grf_set *live_out = calloc(n + 1, sizeof(*live_out));
+	int i, indirect = 0;
+
+	for (i = 0; i < n; i++)
+		instruction_grfs(insts[i], &access[i], &indirect);
+	grf_liveness(insts, n, access, live_in, live_out);
+
+	for (i = 0; i < GRF_COUNT; i++)
+		payload[i] = n && set_has(&live_in[0], i);
+
+	free(live_out);
+	free(live_in);
+	free(access);
+	return indirect;
+}
+
+static void print_grf_set(FILE *out, struct grf_set *s)
+{
+	int i, first = -1;
+
+	for (i = 0; i <= GRF_COUNT; i++) {
+		if (i < GRF_COUNT && set_has(s, i)) {
+			if (first < 0)
+				first = i;
+			continue;
+		}
+		if (first < 0)
+			continue;
+		if (first == i - 1)
+			fprintf(out, " g%d", first);
+		else
+			fprintf(out, " g%d-g%d", first, i - 1);
+		first = -1;
+	}
+}
+
+/**
+ * Computes the live GRFs at every instruction of the program and writes
+ * them, the peak pressure and the registers the kernel needs to out.
+ * Warns on stderr when the .reg_count_total or .reg_count_payload pragma
+ * disagrees with them.
+ *
+ * Returns the peak number of live GRFs.
+ */
+int report_register_pressure(FILE *out, struct brw_program *p)
+{
+	struct brw_program_instruction *entry, **entries;
+	struct brw_instruction **insts;
+	struct grf_access *access;
+	struct grf_set *live_in, *live_out, *occupied, used, payload;
+	int n, i, indirect = 0, peak = 0, last;
+
+	n = program_instructions(p, &insts);
+	entries = calloc(n + 1, sizeof(*entries));
+	for (i = 0, entry = p->first; entry; entry = entry->next)
+		if (!entry->islabel)
+			entries[i++] = entry;
+
+	access = calloc(n + 1, sizeof(*access));
+	live_in = calloc(n + 1, sizeof(*live_in));
+	live_out = calloc(n + 1, sizeof(*live_out));
+	occupied = calloc(n + 1, sizeof(*occupied));
+	memset(&used, 0, sizeof(used));
+
+	for (i = 0; i < n; i++) {
+		instruction_grfs(insts[i], &access[i], &indirect);
+		set_union(&used, &access[i].use);
+		set_union(&used, &access[i].def);
+	}
+
+	grf_liveness(insts, n, access, live_in, live_out);
+
+	/* An instruction needs the registers live across it plus those it
+	 * writes, even when nothing reads them afterwards.
+	 */
+	for (i = 0; i < n; i++) {
+		occupied[i] = live_in[i];
+		set_union(&occupied[i], &live_out[i]);
+		set_union(&occupied[i], &access[i].def);
+		if (set_count(&occupied[i]) > peak)
+			peak = set_count(&occupied[i]);
+	}
+
+	for (i = 0; i < n; i++) {
+		fprintf(out, "%s:%d: %d: %d live:", entries[i]->filename,
+			entries[i]->line, i, set_count(&occupied[i]));
+		print_grf_set(out, &occupied[i]);
+		fprintf(out, "\n");
+	}
+
+	fprintf(out, "peak pressure: %d GRFs at", peak);
+	for (i = 0; i < n; i++)
+		if (set_count(&occupied[i]) == peak)
+			fprintf(out, " %s:%d", entries[i]->filename,
+				entries[i]->line);
+	fprintf(out, "\n");
+
+	last = set_last(&used);
+	fprintf(out, "registers used: %d (g0-g%d)\n", last + 1, last);
+
+	memset(&payload, 0, sizeof(payload));
+	if (n)
+		payload = live_in[0];
+	fprintf(out, "payload read:");
+	print_grf_set(out, &payload);
+	fprintf(out, "\n");
+
+	if (indirect)
+		fprintf(stderr, "WARNING: %s: indirect register access, "
+			"register use may be underestimated\n", input_filename);
+
+	if (program_defaults.reg_count_total) {
+		int total = program_defaults.reg_count_total;
+
+		if (total < last + 1)
+			fprintf(stderr, "WARNING: %s: .reg_count_total is %d "
+				"but g%d is used\n", input_filename, total, last);
+		else if (total > last + 1)
+			fprintf(stderr, "WARNING: %s: .reg_count_total is %d "
+				"but only %d registers are used\n",
+				input_filename, total, last + 1);
+	}
+
+	if (program_defaults.reg_count_payload) {
+		int declared = program_defaults.reg_count_payload;
+		int read = set_last(&payload) + 1;
+
+		if (declared < read)
+			fprintf(stderr, "WARNING: %s: .reg_count_payload is %d "
+				"but g%d is read before being written\n",
+				input_filename, declared, read - 1);
+		else if (declared > read)
+			fprintf(stderr, "WARNING: %s: .reg_count_payload is %d "
+				"but only %d payload registers are read\n",
+				input_filename, declared, read);
+	}
+
+	free(occupied);
+	free(live_out);
+	free(live_in);
+	free(access);
+	free(entries);
+	free(insts);
+	return peak;
+}
@@ -0,0 +1,262 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * intel-gen4grep prints the instructions of kernel dumps that match a
+ * query, see search.c for the query language.  Directories are searched
+ * recursively, in name order.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gen4asm.h"
+
+long int gen_level = 40;
+
+static const struct option longopts[] = {
+	{"gen", required_argument, 0, 'g'},
+	{"binary", no_argument, 0, 'b'},
+	{"raw", no_argument, 0, 'r'},
+	{"count", no_argument, 0, 'c'},
+	{"files-with-matches", no_argument, 0, 'l'},
+	{ NULL, 0, NULL, 0 }
+};
+
+enum search_output {
+    OUTPUT_INSTRUCTIONS,
+    OUTPUT_COUNT,
+    OUTPUT_FILES,
+};
+
+struct search {
+    struct search_query		query;
+    enum input_format		format;
+    enum search_output		output;
+    int				names;		/* prefix matches with the file */
+    struct disasm_output	out;
+    long			matches;
+    int				errors;
+};
+
+static void
+print_match (struct search *s, const char *name, uint32_t *insts, int i)
+{
+    char	*line, *end;
+
+    s->out.len = 0;
+    s->out.column = 0;
+    disasm_at (&s->out, (struct brw_instruction *) (insts + i * INST_SIZE / 4),
+	       i, NULL);
+    for (line = s->out.buf; line < s->out.buf + s->out.len; line = end + 1) {
+	end = memchr (line, '\n', s->out.buf + s->out.len - line);
+	if (end == NULL)
+	    end = s->out.buf + s->out.len;
+	if (line == s->out.buf) {
+	    if (s->names)
+		printf ("%s:", name);
+	    printf ("%d:", i);
+	}
+	printf ("%.*s\n", (int) (end - line), line);
+    }
+}
+
+static void
+search_file (struct search *s, const char *name, int fd)
+{
+    enum input_format	format = s->format;
+    uint32_t		*insts;
+    char		*data;
+    size_t		size;
+    int			mapped, n, start, k, nmatches, count = 0;
+    int			matches[SEARCH_BLOCK];
+
+    data = load_input (fd, &size, &mapped);
+    if (format == INPUT_AUTO)
+	format = detect_input_format (data, size);
+    if (format == INPUT_RAW)
+	insts = raw_instructions (data, size, &n);
+    else
+	insts = parse_hex_text (data, size, format == INPUT_BYTES, &n);
+
+    for (start = 0; start < n; start += SEARCH_BLOCK) {
+	nmatches = search_block (&s->query, insts, n, start, matches);
+	count += nmatches;
+	if (s->output == OUTPUT_FILES && count)
+	    break;
+	if (s->output == OUTPUT_INSTRUCTIONS)
+	    for (k = 0; k < nmatches; k++)
+		print_match (s, name, insts, matches[k]);
+    }
+    if (s->output == OUTPUT_COUNT && s->names)
+	printf ("%s:%d\n", name, count);
+    else if (s->output == OUTPUT_COUNT)
+	printf ("%d\n", count);
+    else if (s->output == OUTPUT_FILES && count)
+	printf ("%s\n", name);
+    s->matches += count;
+
+    if ((char *) insts != data)
+	free (insts);
+    if (mapped)
+	munmap (data, size);
+    else
+	free (data);
+}
+
+static void
+search_path (struct search *s, const char *path)
+{
+    struct dirent	**entries;
+    struct stat		st;
+    char		*child;
+    int			fd, n, i;
+
+    if (strcmp (path, "-") == 0) {
+	search_file (s, "(standard input)", STDIN_FILENO);
+	return;
+    }
+    if (stat (path, &st) == 0 && S_ISDIR (st.st_mode)) {
+	n = scandir (path, &entries, NULL, alphasort);
+	if (n < 0) {
+	    fprintf (stderr, "Couldn't read directory %s: ", path);
+	    perror (NULL);
+	    s->errors++;
+	    return;
+	}
+	for (i = 0; i < n; i++) {
+	    if (strcmp (entries[i]->d_name, ".") != 0 &&
+		strcmp (entries[i]->d_name, "..") != 0) {
+		child = malloc (strlen (path) + strlen (entries[i]->d_name) + 2);
+		sprintf (child, "%s/%s", path, entries[i]->d_name);
+		search_path (s, child);
+		free (child);
+	    }
+	    free (entries[i]);
+	}
+	free (entries);
+	return;
+    }
+
+    fd = open (path, O_RDONLY);
+    if (fd < 0) {
+	fprintf (stderr, "Couldn't open %s: ", path);
+	perror (NULL);
+	s->errors++;
+	return;
+    }
+    search_file (s, path, fd);
+    close (fd);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: intel-gen4grep [-b | -r] [-c | -l] [-g <4|5|6|7>] query [file | directory]...\n");
+    fprintf(stderr, "\t-b, --binary                         Read the byte arrays written by intel-gen4asm -b\n");
+    fprintf(stderr, "\t-r, --raw                            Read raw little-endian instructions\n");
+    fprintf(stderr, "\t    The input format is detected when neither is given\n");
+    fprintf(stderr, "\t-c, --count                          Print the number of matches of each file\n");
+    fprintf(stderr, "\t-l, --files-with-matches             Print the names of the files that match\n");
+    fprintf(stderr, "\tThe query is made of terms that must all match, each one or more of\n");
+    fprintf(stderr, "\talternatives separated by '|':\n");
+    fprintf(stderr, "\t    <opcode>                         e.g. send, mad\n");
+    fprintf(stderr, "\t    simd<n>                          The execution size\n");
+    fprintf(stderr, "\t    target=<name | n>                A send to that shared function\n");
+    fprintf(stderr, "\t    sat, eot                         Saturating, a send ending the thread\n");
+    fprintf(stderr, "\t    g<n>, m<n>                       Reads or writes that register\n");
+    fprintf(stderr, "\t    dst=<reg>, src=<reg>             Writes it, reads it\n");
+    fprintf(stderr, "\t    <lo>[:<hi>]=<value>              Bits lo to hi of the encoding\n");
+    fprintf(stderr, "\tExits with 0 if something matched, 1 if nothing did and 2 on trouble\n");
+}
+
+int main(int argc, char **argv)
+{
+    struct search	s;
+    int			o, i;
+
+    memset (&s, 0, sizeof (s));
+    s.format = INPUT_AUTO;
+    s.output = OUTPUT_INSTRUCTIONS;
+
+    while ((o = getopt_long(argc, argv, "brclg:", longopts, NULL)) != -1) {
+	switch (o) {
+	case 'b':
+	    s.format = INPUT_BYTES;
+	    break;
+	case 'r':
+	    s.format = INPUT_RAW;
+	    break;
+	case 'c':
+	    s.output = OUTPUT_COUNT;
+	    break;
+	case 'l':
+	    s.output = OUTPUT_FILES;
+	    break;
+	case 'g':
+	    gen_level = parse_gen_level(optarg);
+	    if (gen_level < 0) {
+		usage();
+		exit(2);
+	    }
+	    break;
+	default:
+	    usage();
+	    exit(2);
+	}
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc < 1) {
+	usage();
+	exit(2);
+    }
+
+    if (search_compile (&s.query, argv[0]))
+	exit (2);
+    if (argc > 2) {
+	s.names = 1;
+    } else if (argc == 2) {
+	struct stat st;
+
+	s.names = stat (argv[1], &st) == 0 && S_ISDIR (st.st_mode);
+    }
+
+    disasm_output_init (&s.out, NULL);
+    if (argc == 1)
+	search_path (&s, "-");
+    for (i = 1; i < argc; i++)
+	search_path (&s, argv[i]);
+    disasm_output_fini (&s.out);
+    search_free (&s.query);
+
+    if (s.errors)
+	exit (2);
+    exit (s.matches ? 0 : 1);
+}
@@ -0,0 +1,467 @@
+/* -*- c-basic-offset: 8 -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Instruction search queries.
+ *
+ * A query is a list of terms that must all hold, each a list of
+ * alternatives separated by '|' of which one must hold:
+ *
+ *	send mad ...	the opcode
+ *	simd16		the execution size
+ *	target=urb	the shared function a send goes to, by name or number
+ *	sat, eot	saturation, a send that ends the thread
+ *	g12, m3		the instruction reads or writes that register
+ *	dst=g12		... writes it
+ *	src=g12		... reads it
+ *	96:99=0x2	bits 96 to 99 of the encoding have that value
+ *
+ * Most of these are a value some bits of the instruction must have, and
+ * the terms made only of those are multiplied out into a few masks an
+ * instruction must match one of.  Instructions are tested against the
+ * masks a block at a time, with no branches, so that the compiler can
+ * use vector instructions for it.  Register terms depend on the layout
+ * of the instruction and are checked only on the instructions that got
+ * through the masks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gen4asm.h"
+
+#define SEARCH_MAX_MASKS	64
+
+enum search_kind {
+	SEARCH_BITS,
+	SEARCH_READS,
+	SEARCH_WRITES,
+	SEARCH_TOUCHES,
+};
+
+struct search_alt {
+	enum search_kind kind;
+	struct search_mask bits;
+	struct reg_range reg;
+};
+
+struct search_term {
+	int nalts;
+	struct search_alt *alts;
+};
+
+/* Both halves of a mask, ready to be ANDed with an instruction. */
+static void mask_words(struct brw_instruction *mask,
+		       struct brw_instruction *value, struct search_mask *m)
+{
+	memcpy(m->mask, mask, INST_SIZE);
+	memcpy(m->value, value, INST_SIZE);
+	m->value[0] &= m->mask[0];
+	m->value[1] &= m->mask[1];
+}
+
+static struct search_alt *add_alt(struct search_term *t)
+{
+	struct search_alt *alt;
+
+	t->alts = realloc(t->alts, (t->nalts + 1) * sizeof(*t->alts));
+	alt = &t->alts[t->nalts++];
+	memset(alt, 0, sizeof(*alt));
+	return alt;
+}
+
+static void add_opcode(struct search_term *t, struct brw_instruction *mask,
+		       struct brw_instruction *value, int opcode)
+{
+	mask->header.opcode = 0x7f;
+	value->header.opcode = opcode;
+	mask_words(mask, value, &add_alt(t)->bits);
+}
+
+/* Adds an alternative for a send and a sendc with the fields set so far. */
+static void add_sends(struct search_term *t, struct brw_instruction *mask,
+		      struct brw_instruction *value)
+{
+	add_opcode(t, mask, value, BRW_OPCODE_SEND);
+	if (opcode_desc(BRW_OPCODE_SENDC))
+		add_opcode(t, mask, value, BRW_OPCODE_SENDC);
+}
+
+static int parse_target(const char *name)
+{
+	const char *target_name;
+	char *end;
+	int target, cache;
+
+	target = strtol(name, &end, 0);
+	if (end != name && *end == '\0')
+		return target & 15;
+	for (target = 0; target < 16; target++) {
+		target_name = send_target_name(target);
+		if (target_name && strcmp(target_name, name) == 0)
+			return target;
+	}
+	if (IS_GENp(6)) {
+		for (cache = 0; cache < DP_CACHE_COUNT; cache++) {
+			target = dataport_cache_sfid(cache);
+			if (dataport_cache_names[cache] &&
+			    dataport_sfid_cache(target) == cache &&
+			    strcmp(dataport_cache_names[cache], name) == 0)
+				return target;
+		}
+	}
+	return -1;
+}
+
+static int parse_reg(const char *name, struct reg_range *reg)
+{
+	char *end;
+	long nr;
+
+	if (name[0] == 'g')
+		reg->file = BRW_GENERAL_REGISTER_FILE;
+	else if (name[0] == 'm')
+		reg->file = BRW_MESSAGE_REGISTER_FILE;
+	else
+		return -1;
+	nr = strtol(name + 1, &end, 10);
+	if (end == name + 1 || *end != '\0' || nr < 0 || nr >= GRF_COUNT)
+		return -1;
+	reg->start = nr * 32;
+	reg->end = reg->start + 32;
+	return 0;
+}
+
+static int parse_bits(const char *text, struct brw_instruction *mask,
+		      struct brw_instruction *value)
+{
+	uint32_t *m = (uint32_t *)mask, *v = (uint32_t *)value;
+	unsigned long lo, hi, bits;
+	char *end;
+	int bit;
+
+	lo = strtoul(text, &end, 10);
+	hi = lo;
+	if (*end == ':')
+		hi = strtoul(end + 1, &end, 10);
+	if (*end != '=' || lo > hi || hi >= INST_SIZE * 8)
+		return -1;
+	bits = strtoul(end + 1, &end, 0);
+	if (*end != '\0')
+		return -1;
+	for (bit = lo; bit <= (int)hi; bit++, bits >>= 1) {
+		m[bit / 32] |= 1u << bit % 32;
+		v[bit / 32] |= (uint32_t)(bits & 1) << bit % 32;
+	}
+	return 0;
+}
+
+/* Adds the alternatives one word of a query stands for to t. */
+static int parse_alt(struct search_term *t, const char *word)
+{
+	struct brw_instruction mask, value;
+	struct search_alt *alt;
+	const struct opcode_desc *desc;
+	int i, size, target;
+
+	memset(&mask, 0, sizeof(mask));
+	memset(&value, 0, sizeof(value));
+
+	for (i = 0; i < 128; i++) {
+		desc = opcode_desc(i);
+		if (desc && strcmp(desc->name, word) == 0) {
+			add_opcode(t, &mask, &value, i);
+			return 0;
+		}
+	}
+
+	if (strncmp(word, "simd", 4) == 0) {
+		size = atoi(word + 4);
+		for (i = 0; i < 6; i++) {
+			if (size == 1 << i) {
+				mask.header.execution_size = 7;
+				value.header.execution_size = i;
+				mask_words(&mask, &value, &add_alt(t)->bits);
+				return 0;
+			}
+		}
+		return -1;
+	}
+
+	if (strncmp(word, "target=", 7) == 0) {
+		target = parse_target(word + 7);
+		if (target < 0)
+			return -1;
+		if (IS_GENp(6)) {
+			mask.header.sfid_destreg__conditionalmod = 15;
+			value.header.sfid_destreg__conditionalmod = target;
+		} else if (IS_GENx(5)) {
+			mask.bits2.send_gen5.sfid = 15;
+			value.bits2.send_gen5.sfid = target;
+		} else {
+			mask.bits3.generic.msg_target = 15;
+			value.bits3.generic.msg_target = target;
+		}
+		add_sends(t, &mask, &value);
+		return 0;
+	}
+
+	if (strcmp(word, "sat") == 0) {
+		mask.header.saturate = 1;
+		value.header.saturate = 1;
+		mask_words(&mask, &value, &add_alt(t)->bits);
+		return 0;
+	}
+
+	if (strcmp(word, "eot") == 0) {
+		if (IS_GENp(5)) {
+			mask.bits3.generic_gen5.end_of_thread = 1;
+			value.bits3.generic_gen5.end_of_thread = 1;
+		} else {
+			mask.bits3.generic.end_of_thread = 1;
+			value.bits3.generic.end_of_thread = 1;
+		}
+		add_sends(t, &mask, &value);
+		return 0;
+	}
+
+	if (word[0] >= '0' && word[0] <= '9') {
+		if (parse_bits(word, &mask, &value))
+			return -1;
+		mask_words(&mask, &value, &add_alt(t)->bits);
+		return 0;
+	}
+
+	alt = add_alt(t);
+	if (strncmp(word, "dst=", 4) == 0) {
+		alt->kind = SEARCH_WRITES;
+		word += 4;
+	} else if (strncmp(word, "src=", 4) == 0) {
+		alt->kind = SEARCH_READS;
+		word += 4;
+	} else {
+		alt->kind = SEARCH_TOUCHES;
+	}
+	if (parse_reg(word, &alt->reg)) {
+		t->nalts--;
+		return -1;
+	}
+	return 0;
+}
+
+static int term_is_bits(struct search_term *t)
+{
+	int i;
+
+	for (i = 0; i < t->nalts; i++)
+		if (t->alts[i].kind != SEARCH_BITS)
+			return 0;
+	return 1;
+}
+
+/*
+ * Replaces the masks of q with those matching both one of them and one
+ * of the alternatives of t.  Returns -1, leaving q alone, if that would
+ * take too many masks.
+ */
+static int multiply_masks(struct search_query *q, struct search_term *t)
+{
+	struct search_mask *masks, *a, *b, *m;
+	int i, j, n = 0;
+
+	if (q->nmasks * t->nalts > SEARCH_MAX_MASKS)
+		return -1;
+	masks = malloc((q->nmasks * t->nalts + 1) * sizeof(*masks));
+	for (i = 0; i < q->nmasks; i++) {
+		for (j = 0; j < t->nalts; j++) {
+			a = &q->masks[i];
+			b = &t->alts[j].bits;
+			/* Bits both care about must agree. */
+			if ((a->mask[0] & b->mask[0] & (a->value[0] ^ b->value[0])) ||
+			    (a->mask[1] & b->mask[1] & (a->value[1] ^ b->value[1])))
+				continue;
+			m = &masks[n++];
+			m->mask[0] = a->mask[0] | b->mask[0];
+			m->mask[1] = a->mask[1] | b->mask[1];
+			m->value[0] = a->value[0] | b->value[0];
+			m->value[1] = a->value[1] | b->value[1];
+		}
+	}
+	free(q->masks);
+	q->masks = masks;
+	q->nmasks = n;
+	return 0;
+}
+
+/**
+ * Compiles the query in text for the current gen_level into q.
+ *
+ * Returns 0 on success, or -1 after reporting the word it didn't
+ * understand.
+ */
+int search_compile(struct search_query *q, const char *text)
+{
+	char *copy = strdup(text), *word, *alt, *save_word, *save_alt;
+	struct search_term t;
+
+	memset(q, 0, sizeof(*q));
+	q->masks = calloc(1, sizeof(*q->masks));
+	q->nmasks = 1;
+
+	for (word = strtok_r(copy, " \t\n", &save_word); word;
+	     word = strtok_r(NULL, " \t\n", &save_word)) {
+		t.nalts = 0;
+		t.alts = NULL;
+		for (alt = strtok_r(word, "|", &save_alt); alt;
+		     alt = strtok_r(NULL, "|", &save_alt)) {
+			if (parse_alt(&t, alt)) {
+				fprintf(stderr, "Unknown search term '%s'\n",
+					alt);
+				free(t.alts);
+				free(copy);
+				search_free(q);
+				return -1;
+			}
+		}
+		if (t.nalts == 0)
+			continue;
+		if (term_is_bits(&t) && multiply_masks(q, &t) == 0) {
+			free(t.alts);
+			continue;
+		}
+		q->terms = realloc(q->terms, (q->nterms + 1) * sizeof(t));
+		q->terms[q->nterms++] = t;
+	}
+
+	free(copy);
+	return 0;
+}
+
+void search_free(struct search_query *q)
+{
+	int i;
+
+	for (i = 0; i < q->nterms; i++)
+		free(q->terms[i].alts);
+	free(q->terms);
+	free(q->masks);
+	memset(q, 0, sizeof(*q));
+}
+
+static int matches_mask(const struct search_mask *m, const uint32_t *inst)
+{
+	uint64_t w[2];
+
+	memcpy(w, inst, INST_SIZE);
+	return (((w[0] & m->mask[0]) ^ m->value[0]) |
+		((w[1] & m->mask[1]) ^ m->value[1])) == 0;
+}
+
+static int matches_reg(struct reg_range *ranges, int n, struct reg_range *reg)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (reg_ranges_overlap(&ranges[i], reg))
+			return 1;
+	return 0;
+}
+
+static int matches_term(struct search_term *t, const uint32_t *inst)
+{
+	struct brw_instruction copy;
+	struct inst_regs regs;
+	struct search_alt *alt;
+	int i, have_regs = 0;
+
+	for (i = 0; i < t->nalts; i++) {
+		alt = &t->alts[i];
+		if (alt->kind == SEARCH_BITS) {
+			if (matches_mask(&alt->bits, inst))
+				return 1;
+			continue;
+		}
+		if (!have_regs) {
+			memcpy(&copy, inst, INST_SIZE);
+			instruction_regs(&copy, &regs);
+			have_regs = 1;
+		}
+		if (alt->kind != SEARCH_READS &&
+		    matches_reg(regs.defs, regs.ndefs, &alt->reg))
+			return 1;
+		if (alt->kind != SEARCH_WRITES &&
+		    matches_reg(regs.uses, regs.nuses, &alt->reg))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Sets bit k of the result for each instruction k of the n, at most
+ * SEARCH_BLOCK, that matches one of the masks of q.
+ */
+static uint64_t match_block(const struct search_query *q,
+			    const uint32_t *insts, int n)
+{
+	uint64_t hits = 0, w[2];
+	const struct search_mask *m;
+	int i, k;
+
+	for (i = 0; i < q->nmasks; i++) {
+		m = &q->masks[i];
+		for (k = 0; k < n; k++) {
+			memcpy(w, insts + k * INST_SIZE / 4, INST_SIZE);
+			hits |= (uint64_t)((((w[0] & m->mask[0]) ^ m->value[0]) |
+					    ((w[1] & m->mask[1]) ^ m->value[1])) == 0) << k;
+		}
+	}
+	return hits;
+}
+
+/**
+ * Finds the instructions of the n in insts that match q among the
+ * SEARCH_BLOCK starting at start, storing their indices in order in
+ * matches.  Returns how many there are.
+ */
+int search_block(const struct search_query *q, const uint32_t *insts,
+		 int n, int start, int *matches)
+{
+	uint64_t hits;
+	int count = 0, i, k, t;
+
+	k = n - start < SEARCH_BLOCK ? n - start : SEARCH_BLOCK;
+	hits = match_block(q, insts + start * INST_SIZE / 4, k);
+	for (; hits; hits &= hits - 1) {
+		i = start + lowest_bit(hits);
+		for (t = 0; t < q->nterms; t++)
+			if (!matches_term(&q->terms[t],
+					  insts + i * INST_SIZE / 4))
+				break;
+		if (t == q->nterms)
+			matches[count++] = i;
+	}
+	return count;
+}
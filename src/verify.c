@@ -0,0 +1,210 @@
+/* -*- c-basic-offset: 8 -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Round-trip verification: every instruction the assembler is about to
+ * write is disassembled, and the text is run through the parser again.
+ * The instruction that comes back must have the same bits.
+ *
+ * Branch distances are disassembled as numbers rather than labels, so
+ * each instruction is parsed on its own, and an encoding that appears
+ * several times in a program is only checked once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gen4asm.h"
+
+extern FILE *yyin;
+extern int yylineno;
+extern int errors;
+extern char *input_filename;
+
+/* No label table: distances are written the way the assembler reads them. */
+static const struct disasm_labels distances = { 0, NULL };
+
+struct encoding_set {
+	uint32_t (*keys)[INST_SIZE / 4];
+	char *used;
+	unsigned int mask;
+};
+
+static void encoding_set_init(struct encoding_set *set, int n)
+{
+	unsigned int size = 64;
+
+	while (size < 2 * (unsigned int)n)
+		size *= 2;
+	set->keys = malloc(size * sizeof(*set->keys));
+	set->used = calloc(size, 1);
+	set->mask = size - 1;
+}
+
+static void encoding_set_fini(struct encoding_set *set)
+{
+	free(set->keys);
+	free(set->used);
+}
+
+/* Adds the encoding of inst, returning 0 if it was already there. */
+static int encoding_set_add(struct encoding_set *set,
+			    struct brw_instruction *inst)
+{
+	uint32_t key[INST_SIZE / 4];
+	unsigned int h, i;
+
+	memcpy(key, inst, INST_SIZE);
+	h = key[0] * 0x9e3779b1u ^ key[1] * 0x85ebca6bu ^
+		key[2] * 0xc2b2ae35u ^ key[3] * 0x27d4eb2fu;
+	for (i = (h ^ h >> 15) & set->mask; set->used[i];
+	     i = (i + 1) & set->mask)
+		if (memcmp(set->keys[i], key, INST_SIZE) == 0)
+			return 0;
+	memcpy(set->keys[i], key, INST_SIZE);
+	set->used[i] = 1;
+	return 1;
+}
+
+static void free_program(struct brw_program *p)
+{
+	struct brw_program_instruction *entry, *next;
+
+	for (entry = p->first; entry; entry = next) {
+		next = entry->next;
+		free(entry->string);
+		free(entry);
+	}
+}
+
+/**
+ * Assembles text, the disassembly of the instruction at entry, into
+ * *inst.  Parse errors are reported at entry's source line.
+ *
+ * Returns 0 on success.
+ */
+static int reassemble(char *text, int len,
+		      struct brw_program_instruction *entry,
+		      struct brw_instruction *inst)
+{
+	struct brw_program saved_program = compiled_program;
+	char *saved_filename = input_filename;
+	int saved_errors = errors;
+	struct brw_program_instruction *e;
+	FILE *f;
+	int err;
+
+	f = fmemopen(text, len, "r");
+	if (f == NULL) {
+		perror("Couldn't verify instruction");
+		exit(1);
+	}
+	memset(&compiled_program, 0, sizeof(compiled_program));
+	if (entry->filename)
+		input_filename = entry->filename;
+	yyin = f;
+	yylineno = entry->line;
+	err = yyparse() != 0 || errors != saved_errors;
+	yylex_destroy();
+	fclose(f);
+	yyin = NULL;
+
+	for (e = compiled_program.first; e && e->islabel; e = e->next)
+		;
+	if (!err && e) {
+		encode_branches(&compiled_program);
+		*inst = e->instruction;
+	} else {
+		err = 1;
+	}
+
+	free_program(&compiled_program);
+	compiled_program = saved_program;
+	input_filename = saved_filename;
+	errors = saved_errors;
+	return err;
+}
+
+static void print_words(FILE *report, const char *what,
+			struct brw_instruction *inst)
+{
+	const uint32_t *dw = (const uint32_t *)inst;
+
+	fprintf(report, "\t%-12s0x%08x 0x%08x 0x%08x 0x%08x\n",
+		what, dw[0], dw[1], dw[2], dw[3]);
+}
+
+/**
+ * Checks that every instruction of p survives a trip through the
+ * disassembler and back, reporting those that don't with their source
+ * line.
+ *
+ * Returns the number of instructions that don't.
+ */
+int verify_program(FILE *report, struct brw_program *p)
+{
+	struct brw_program_instruction *entry;
+	struct encoding_set seen;
+	struct disasm_output out;
+	struct brw_instruction again;
+	int n = 0, failed = 0;
+
+	for (entry = p->first; entry; entry = entry->next)
+		n++;
+	encoding_set_init(&seen, n);
+	disasm_output_init(&out, NULL);
+
+	for (entry = p->first; entry; entry = entry->next) {
+		struct brw_instruction *inst = &entry->instruction;
+		const char *filename = entry->filename ?
+			entry->filename : input_filename;
+
+		if (entry->islabel || !encoding_set_add(&seen, inst))
+			continue;
+
+		out.len = 0;
+		out.column = 0;
+		disasm_at(&out, inst, 0, &distances);
+
+		if (reassemble(out.buf, out.len, entry, &again)) {
+			fprintf(report, "%s:%d: verify: the disassembly doesn't "
+				"assemble:\n\t%.*s", filename, entry->line,
+				out.len, out.buf);
+			failed++;
+		} else if (memcmp(inst, &again, INST_SIZE) != 0) {
+			fprintf(report, "%s:%d: verify: the disassembly "
+				"assembles to something else:\n\t%.*s",
+				filename, entry->line, out.len, out.buf);
+			print_words(report, "assembled", inst);
+			print_words(report, "reassembled", &again);
+			failed++;
+		}
+	}
+
+	disasm_output_fini(&out);
+	encoding_set_fini(&seen);
+	return failed;
+}
@@ -4,6 +4,9 @@
 
 DIR="$( cd -P "$( dirname "$0" )" && pwd )"
 ASSEMBLER="${DIR}/../src/intel-gen4asm"
+DIFF="${DIR}/../src/intel-gen4diff"
+GREP="${DIR}/../src/intel-gen4grep"
+DISASM="${DIR}/../src/intel-gen4disasm"
 
 # Tests that are expected to success because they contain correct code.
 # $1 is the gen level, e.g., 4 or 7
@@ -41,6 +44,265 @@ function check_if_fail()
     fi
 }
 
+# Tests of assembler options.  $1 is the gen level, $2 is the test case
+# name and the rest are the options.  What the assembler prints on stderr
+# is compared with ${TEST_CASE_NAME}.stderr, and the report written to
+# ${REPORT}, if any, with ${TEST_CASE_NAME}.report.  The assembler is run
+# from the test directory so that messages name the source the same way
+# wherever the tests are run from.
+REPORT="${PWD}/temp.report"
+function check_option()
+{
+    GEN_LEVEL="$1"
+    TEST_CASE_NAME="$2"
+    shift 2
+    SOURCE="${TEST_CASE_NAME}.g${GEN_LEVEL}a"
+    EXPECTED="${TEST_CASE_NAME}.expected"
+    TEMP_OUT="${PWD}/temp.out"
+    TEMP_ERR="${PWD}/temp.err"
+    rm -f ${REPORT}
+    (cd ${DIR} && ${ASSEMBLER} -g ${GEN_LEVEL} "$@" ${SOURCE} -o ${TEMP_OUT} 2> ${TEMP_ERR})
+    if cmp ${TEMP_OUT} ${DIR}/${EXPECTED} 2> /dev/null &&
+       cmp ${TEMP_ERR} ${DIR}/${TEST_CASE_NAME}.stderr 2> /dev/null &&
+       { [ ! -f ${DIR}/${TEST_CASE_NAME}.report ] ||
+         cmp ${REPORT} ${DIR}/${TEST_CASE_NAME}.report 2> /dev/null; };
+    then
+        echo "[ OK ] ${TEST_CASE_NAME}";
+    else
+        echo "[FAIL] ${TEST_CASE_NAME}";
+        diff -u ${DIR}/${EXPECTED} ${TEMP_OUT};
+        diff -u ${DIR}/${TEST_CASE_NAME}.stderr ${TEMP_ERR};
+        [ ! -f ${DIR}/${TEST_CASE_NAME}.report ] ||
+            diff -u ${DIR}/${TEST_CASE_NAME}.report ${REPORT};
+    fi
+}
+
+# Tests of intel-gen4diff.  ${TEST_CASE_NAME}-old and -new are assembled
+# and compared, and the diff and exit status matched against
+# ${TEST_CASE_NAME}.report.
+function check_diff()
+{
+    GEN_LEVEL="$1"
+    TEST_CASE_NAME="$2"
+    shift 2
+    ${ASSEMBLER} -g ${GEN_LEVEL} ${DIR}/${TEST_CASE_NAME}-old.g${GEN_LEVEL}a -o old.out
+    ${ASSEMBLER} -g ${GEN_LEVEL} ${DIR}/${TEST_CASE_NAME}-new.g${GEN_LEVEL}a -o new.out
+    ${DIFF} -g ${GEN_LEVEL} "$@" old.out new.out > ${REPORT} 2>&1
+    echo "exit $?" >> ${REPORT}
+    if cmp ${REPORT} ${DIR}/${TEST_CASE_NAME}.report 2> /dev/null;
+    then
+        echo "[ OK ] ${TEST_CASE_NAME}";
+    else
+        echo "[FAIL] ${TEST_CASE_NAME}";
+        diff -u ${DIR}/${TEST_CASE_NAME}.report ${REPORT};
+    fi
+}
+
+# Tests of intel-gen4grep.  $3 is assembled and searched with the rest
+# of the arguments, and the output and exit status matched against
+# ${TEST_CASE_NAME}.report.
+function check_grep()
+{
+    GEN_LEVEL="$1"
+    TEST_CASE_NAME="$2"
+    SOURCE="$3.g${GEN_LEVEL}a"
+    shift 3
+    ${ASSEMBLER} -g ${GEN_LEVEL} ${DIR}/${SOURCE} -o grep.out
+    ${GREP} -g ${GEN_LEVEL} "$@" grep.out > ${REPORT} 2>&1
+    echo "exit $?" >> ${REPORT}
+    if cmp ${REPORT} ${DIR}/${TEST_CASE_NAME}.report 2> /dev/null;
+    then
+        echo "[ OK ] ${TEST_CASE_NAME}";
+    else
+        echo "[FAIL] ${TEST_CASE_NAME}";
+        diff -u ${DIR}/${TEST_CASE_NAME}.report ${REPORT};
+    fi
+}
+
+# Checks that every test source of a gen level reads back the same
+# through the disassembler, with the assembler's --verify.
+function check_verify()
+{
+    GEN_LEVEL="$1"
+    TEST_CASE_NAME="verify-gen${GEN_LEVEL}"
+    TEMP_ERR="${PWD}/temp.err"
+    FAILED=""
+    for SOURCE in ${DIR}/*.g${GEN_LEVEL}a
+    do
+        (cd ${DIR} && ${ASSEMBLER} -g ${GEN_LEVEL} --verify $(basename ${SOURCE}) -o ${PWD}/temp.out 2> ${TEMP_ERR})
+        if [ $? -ne 0 ] || [ -s ${TEMP_ERR} ];
+        then
+            FAILED="${FAILED} $(basename ${SOURCE})"
+            cat ${TEMP_ERR}
+        fi
+    done
+    if [ -z "${FAILED}" ];
+    then
+        echo "[ OK ] ${TEST_CASE_NAME}";
+    else
+        echo "[FAIL] ${TEST_CASE_NAME}:${FAILED}";
+    fi
+}
+
+# Checks that every test source of a gen level that assembles comes out
+# the same after intel-gen4disasm -l and assembling its output again.
+function check_round_trip()
+{
+    GEN_LEVEL="$1"
+    TEST_CASE_NAME="round-trip-gen${GEN_LEVEL}"
+    FAILED=""
+    for SOURCE in ${DIR}/*.g${GEN_LEVEL}a
+    do
+        ${ASSEMBLER} -g ${GEN_LEVEL} ${SOURCE} -o old.out 2> /dev/null || continue
+        ${DISASM} -g ${GEN_LEVEL} -l old.out -o labels.out
+        ${ASSEMBLER} -g ${GEN_LEVEL} labels.out -o new.out
+        if ! cmp old.out new.out > /dev/null 2>&1;
+        then
+            FAILED="${FAILED} $(basename ${SOURCE})"
+            diff -u old.out new.out
+        fi
+    done
+    if [ -z "${FAILED}" ];
+    then
+        echo "[ OK ] ${TEST_CASE_NAME}";
+    else
+        echo "[FAIL] ${TEST_CASE_NAME}:${FAILED}";
+    fi
+}
+
+# Puts every test source of gen level $1 that assembles into one program,
+# disasm.out, doubled until intel-gen4disasm cuts it into several chunks.
+function make_disasm_program()
+{
+    GEN_LEVEL="$1"
+    rm -f disasm.out
+    for SOURCE in ${DIR}/*.g${GEN_LEVEL}a
+    do
+        ${ASSEMBLER} -g ${GEN_LEVEL} ${SOURCE} -o part.out 2> /dev/null &&
+            cat part.out >> disasm.out
+    done
+    while [ $(wc -l < disasm.out) -lt 10000 ]
+    do
+        cat disasm.out disasm.out > part.out
+        mv part.out disasm.out
+    done
+}
+
+# Tests of intel-gen4disasm -j.  The program of make_disasm_program is
+# disassembled with -j 1 and -j 4, with and without labels, and compared
+# with the serial disassembly.
+function check_disasm()
+{
+    GEN_LEVEL="$1"
+    TEST_CASE_NAME="disasm-jobs-gen${GEN_LEVEL}"
+    FAILED=""
+    make_disasm_program ${GEN_LEVEL}
+    for LABELS in "" "-l"
+    do
+        ${DISASM} -g ${GEN_LEVEL} ${LABELS} disasm.out -o serial.out
+        for JOBS in 1 4
+        do
+            ${DISASM} -g ${GEN_LEVEL} ${LABELS} -j ${JOBS} disasm.out -o jobs.out
+            if ! cmp serial.out jobs.out > /dev/null 2>&1;
+            then
+                FAILED="${FAILED} -j${JOBS}${LABELS:+ ${LABELS}}"
+                diff -u serial.out jobs.out | head -20
+            fi
+        done
+    done
+    if [ -z "${FAILED}" ];
+    then
+        echo "[ OK ] ${TEST_CASE_NAME}";
+    else
+        echo "[FAIL] ${TEST_CASE_NAME}:${FAILED}";
+    fi
+}
+
+# Tests of intel-gen4disasm --stream.  The program of make_disasm_program
+# is read from a pipe and from the file itself, in pieces that end in the
+# middle of hex numbers, and once more with a pause after the first digits
+# of a number so that it is split across two reads for sure.  Each time
+# the output is compared with the disassembly of the whole file.
+function check_disasm_stream()
+{
+    GEN_LEVEL="$1"
+    TEST_CASE_NAME="disasm-stream-gen${GEN_LEVEL}"
+    FAILED=""
+    make_disasm_program ${GEN_LEVEL}
+    ${DISASM} -g ${GEN_LEVEL} disasm.out -o serial.out
+    SPLIT=$(grep -bo 0x disasm.out | awk -F: '$1 >= 256 { print $1 + 5; exit }')
+    for HOW in pipe file split
+    do
+        case ${HOW} in
+        pipe)
+            cat disasm.out | ${DISASM} -g ${GEN_LEVEL} -s /dev/stdin -o stream.out
+            ;;
+        file)
+            ${DISASM} -g ${GEN_LEVEL} -s disasm.out -o stream.out
+            ;;
+        split)
+            { head -c ${SPLIT} disasm.out; sleep 1; tail -c +$((SPLIT + 1)) disasm.out; } |
+                ${DISASM} -g ${GEN_LEVEL} -s /dev/stdin -o stream.out
+            ;;
+        esac
+        if ! cmp serial.out stream.out > /dev/null 2>&1;
+        then
+            FAILED="${FAILED} ${HOW}"
+            diff -u serial.out stream.out | head -20
+        fi
+    done
+    if [ -z "${FAILED}" ];
+    then
+        echo "[ OK ] ${TEST_CASE_NAME}";
+    else
+        echo "[FAIL] ${TEST_CASE_NAME}:${FAILED}";
+    fi
+}
+
+# Tests of the input formats of intel-gen4disasm.  $2 is assembled as
+# word text and as byte text, which are also written in upper case and
+# turned into a raw dump, and a partial instruction is added to the end
+# of each.  Every form must disassemble like the word text, whether the
+# format is detected or given.
+function check_disasm_input()
+{
+    GEN_LEVEL="$1"
+    TEST_CASE_NAME="disasm-input"
+    SOURCE="$2.g${GEN_LEVEL}a"
+    FAILED=""
+    ${ASSEMBLER} -g ${GEN_LEVEL} ${DIR}/${SOURCE} -o words.out
+    ${ASSEMBLER} -g ${GEN_LEVEL} -b ${DIR}/${SOURCE} -o bytes.out
+    ${DISASM} -g ${GEN_LEVEL} words.out -o serial.out
+    tr a-fx A-FX < words.out > upper-words.out
+    tr a-fx A-FX < bytes.out > upper-bytes.out
+    printf "$(grep -o '0x[0-9a-f]*' bytes.out | sed 's/^0x/\\x/' | tr -d '\n')" > raw.out
+    printf '0x00600001, 0x2040' >> words.out
+    printf '0X00600001, 0X2040' >> upper-words.out
+    printf '0x01, 0x00, 0x6' >> bytes.out
+    printf '0X01, 0X00, 0X6' >> upper-bytes.out
+    printf '\001\000\140' >> raw.out
+    for INPUT in words upper-words bytes:-b upper-bytes:-b raw:-r
+    do
+        FORM=${INPUT%%:*}
+        FLAG=${INPUT#${FORM}}
+        for OPTS in "" ${FLAG#:}
+        do
+            ${DISASM} -g ${GEN_LEVEL} ${OPTS} ${FORM}.out -o input.out 2> /dev/null
+            if ! cmp serial.out input.out > /dev/null 2>&1;
+            then
+                FAILED="${FAILED} ${FORM}${OPTS:+ ${OPTS}}"
+                diff -u serial.out input.out | head -20
+            fi
+        done
+    done
+    if [ -z "${FAILED}" ];
+    then
+        echo "[ OK ] ${TEST_CASE_NAME}";
+    else
+        echo "[FAIL] ${TEST_CASE_NAME}:${FAILED}";
+    fi
+}
+
 # Tests that are expected to success because they contain correct code.
 TEST_GEN4_SHOULD_WORK="\
 	mov \
@@ -71,6 +333,18 @@ TEST_GEN4_SHOULD_FAIL="\
 	rnde-intsrc \
 	"
 
+# Gen6 tests that are expected to success.
+TEST_GEN6_SHOULD_WORK="\
+	send-math \
+	mad \
+	immediate-vector \
+	sampler \
+	dataport \
+	thread-control \
+	branch \
+	labels \
+	"
+
 for T in ${TEST_GEN4_SHOULD_WORK}
 do
     check_if_work 4 ${T}
@@ -81,3 +355,33 @@ do
     check_if_fail 4 ${T}
 done
 
+for T in ${TEST_GEN6_SHOULD_WORK}
+do
+    check_if_work 6 ${T}
+done
+
+check_option 6 if-convert --if-convert
+check_option 6 simplify --simplify-arith
+check_option 4 simplify-mac --simplify-arith
+check_diff 6 diff-branch
+check_verify 6
+check_option 6 copy-prop --copy-prop
+check_option 6 estimate --estimate --estimate-json ${REPORT}
+check_option 6 reg-pressure --reg-pressure
+check_option 6 cfg-dot --cfg-dot ${REPORT}
+check_option 6 cfg-json --cfg-json ${REPORT}
+check_option 6 critical-path --critical-path
+check_option 6 perf-warn --perf-warn
+check_option 7 fix-bank-conflicts --fix-bank-conflicts
+check_option 6 switch-hints --switch-hints
+check_diff 6 diff-same
+check_grep 6 grep-src grep src=g10
+check_grep 6 grep-count grep -c 'add|mad'
+check_grep 6 grep-target grep target=constant_cache
+check_grep 6 grep-none grep mul
+check_grep 6 grep-bad grep bogus=
+check_disasm 6
+check_disasm_stream 6
+check_disasm_input 6 branch
+check_round_trip 6
+check_round_trip 7